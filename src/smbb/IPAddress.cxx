@@ -117,6 +117,10 @@ int smbb::IPAddress::GetInterfaceIndex() const {
 	// Check for empty; if empty return 0
 	if (GetFamily() == FAMILY_UNSPECIFIED || IsAny())
 		return 0;
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	else if (GetFamily() == LOCAL)
+		return 0;
+#endif
 
 	// Go through all available address
 	int result = -1;
@@ -236,6 +240,18 @@ char *smbb::IPAddress::ToURI(String buffer, bool includePort) const {
 
 		*buffer++ = ']';
 	}
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	else if (GetFamily() == LOCAL) {
+		const size_t length = GetPathLength();
+
+		if (IsAbstract())
+			*buffer++ = '@';
+
+		(void)memcpy(buffer, _local.sun_path + (_local.sun_path[0] ? 0 : 1), length);
+		buffer[length] = 0;
+		return start;
+	}
 #endif
 	else
 		return NULL;
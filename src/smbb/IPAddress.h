@@ -24,6 +24,7 @@ SOFTWARE.
 #ifndef SMBB_IPADDRESS_H
 #define SMBB_IPADDRESS_H
 
+#include <cstddef>
 #include <cstring>
 
 #if defined(_WIN32)
@@ -33,6 +34,12 @@ SOFTWARE.
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+// Unix-domain (local) sockets are not supported by all Windows SDKs
+#if defined(_WIN32) && !defined(SMBB_NO_LOCAL_SOCKETS)
+#define SMBB_NO_LOCAL_SOCKETS
 #endif
 
 #include "utilities/Inline.h"
@@ -44,6 +51,9 @@ enum IPAddressFamily {
 	IPV4 = AF_INET,
 #if !defined(SMBB_NO_IPV6)
 	IPV6 = AF_INET6,
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	LOCAL = AF_UNIX, // A Unix-domain socket (TCP selects a stream socket, and UDP selects a datagram socket)
 #endif
 	FAMILY_UNSPECIFIED = AF_UNSPEC
 };
@@ -66,9 +76,32 @@ private:
 	sockaddr_in6 _ipv6;
 #endif
 	sockaddr_in _ipv4;
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	sockaddr_un _local;
+
+	// Gets the length of the path of a local address (not including the leading null of an abstract address)
+	size_t GetPathLength() const {
+		const size_t start = _local.sun_path[0] ? 0 : 1;
+		const void *end = memchr(_local.sun_path + start, 0, sizeof(_local.sun_path) - start);
+
+		return end ? static_cast<size_t>(static_cast<const char *>(end) - (_local.sun_path + start)) : sizeof(_local.sun_path) - start;
+	}
+#endif
+
+	// Clears anything beyond the length of an address returned by the system, since the length of a local address is derived from its path
+	void Terminate(IPAddressLength length) {
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+		const IPAddressLength pathOffset = static_cast<IPAddressLength>(offsetof(sockaddr_un, sun_path));
+
+		if (GetFamily() == LOCAL && length < static_cast<IPAddressLength>(sizeof(sockaddr_un)))
+			memset(_local.sun_path + (length > pathOffset ? length - pathOffset : 0), 0, sizeof(sockaddr_un) - (length > pathOffset ? length : pathOffset));
+#else
+		(void)length;
+#endif
+	}
 
 public:
-	typedef char String[64];
+	typedef char String[128];
 
 	// Parses a set of addresses from an address (NULL => loopback, "" => all non-loopback addresses) and service (NULL => any service/port)
 	static SMBB_INLINE int Parse(IPAddress results[], int resultsSize, const char *address, const char *service = NULL, bool bindable = false, IPAddressFamily family = FAMILY_UNSPECIFIED);
@@ -90,6 +123,22 @@ public:
 		return address;
 	}
 
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	// Gets a local (Unix-domain) address for the specified path (the address is invalid if the path is too long).
+	//  An abstract address (Linux only) is not in the file system, so it never has to be deleted after the socket is closed.
+	static IPAddress Local(const char *path, bool abstract = false) {
+		IPAddress address(LOCAL);
+		const size_t start = abstract ? 1 : 0;
+		const size_t length = path ? strlen(path) : 0;
+
+		if (!path || length == 0 || length + 1 > sizeof(address._local.sun_path) - start)
+			return IPAddress();
+
+		(void)memcpy(address._local.sun_path + start, path, length);
+		return address;
+	}
+#endif
+
 	// Constructs an empty address (equivalent to "any" address)
 	IPAddress(IPAddressFamily family = FAMILY_UNSPECIFIED) {
 		memset(this, 0, sizeof(*this));
@@ -128,6 +177,10 @@ public:
 #if !defined(SMBB_NO_IPV6)
 			else if (GetFamily() == IPV6)
 				return memcmp(&_ipv6.sin6_addr, &other._ipv6.sin6_addr, sizeof(_ipv6.sin6_addr)) == 0 && _ipv6.sin6_port == other._ipv6.sin6_port;
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+			else if (GetFamily() == LOCAL)
+				return memcmp(_local.sun_path, other._local.sun_path, sizeof(_local.sun_path)) == 0;
 #endif
 		}
 
@@ -149,6 +202,10 @@ public:
 #if !defined(SMBB_NO_IPV6)
 		else if (GetFamily() == IPV6)
 			return sizeof(sockaddr_in6);
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+		else if (GetFamily() == LOCAL) // Includes the null terminator of a path, or the leading null of an abstract address
+			return static_cast<IPAddressLength>(offsetof(sockaddr_un, sun_path) + (IsAny() ? 0 : GetPathLength() + 1));
 #endif
 		return 0;
 	}
@@ -187,6 +244,12 @@ public:
 			if (includePort)
 				hash = (((hash ^ static_cast<unsigned char>(_ipv6.sin6_port)) * multiplier) ^ static_cast<unsigned char>(_ipv6.sin6_port >> 8)) * multiplier;
 		}
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+		else if (GetFamily() == LOCAL) {
+			for (size_t i = 0; i < sizeof(_local.sun_path); i++)
+				hash = (hash ^ static_cast<unsigned char>(_local.sun_path[i])) * multiplier;
+		}
 #endif
 		return hash;
 	}
@@ -203,6 +266,10 @@ public:
 #if !defined(SMBB_NO_IPV6)
 		else if (GetFamily() == IPV6)
 			return memcmp(&_ipv6.sin6_addr, ANY_IPV6, sizeof(_ipv6.sin6_addr)) == 0;
+#endif
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+		else if (GetFamily() == LOCAL) // An unnamed local address
+			return _local.sun_path[0] == 0 && _local.sun_path[1] == 0;
 #endif
 		return false;
 	}
@@ -233,10 +300,15 @@ public:
 		return false;
 	}
 
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	// Checks if the address is an abstract local address
+	bool IsAbstract() const { return GetFamily() == LOCAL && _local.sun_path[0] == 0 && _local.sun_path[1] != 0; }
+#endif
+
 	// Gets whether or not the address is valid
 	bool IsValid() const { return GetFamily() != FAMILY_UNSPECIFIED; }
 
-	// Gets the string URI authority (host/port) representation of the address
+	// Gets the string URI authority (host/port) representation of the address (the path of a local address, prefixed with '@' if it is abstract)
 	SMBB_INLINE char *ToURI(String buffer, bool includePort = true) const;
 
 	friend class IPSocket;
@@ -60,6 +60,15 @@ bool smbb::IPSocket::Initialize() {
 
 	if (!GetSendMMsg())
 		GetSendMMsg() = SendMMsgFunction::Load("sendmmsg");
+
+#if defined(UDP_SEGMENT)
+	// Older kernels ignore the segment size control message, so only use segmentation offload if the socket option is supported
+	IPSocket probe(IPV4, UDP);
+	int segmentSize = 0;
+
+	GetSendSegmentOffload() = probe.IsValid() && probe.GetOptionInternal<int, int>(IPPROTO_UDP, UDP_SEGMENT, segmentSize);
+	(void)probe.Close();
+#endif
 #endif
 #endif
 	return true;
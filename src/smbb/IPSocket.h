@@ -52,6 +52,28 @@ SOFTWARE.
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#if defined(__linux__)
+#include <time.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+
+#if !defined(UDP_GRO)
+#define UDP_GRO 104
+#endif
+
+#if !defined(SO_ZEROCOPY)
+#define SO_ZEROCOPY 60
+#endif
+
+#if !defined(MSG_ZEROCOPY)
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#endif
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/select.h>
@@ -64,6 +86,7 @@ SOFTWARE.
 #endif
 
 #include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
 #include "utilities/StaticCast.h"
 
 #include "IPAddress.h"
@@ -72,7 +95,11 @@ struct timespec;
 
 namespace smbb {
 
+class IPSocketEngine;
+
 class IPSocket {
+	friend class IPSocketEngine;
+
 	typedef void (*DefaultFunction)();
 
 	// Loads the specified function by name
@@ -196,6 +223,66 @@ public:
 #endif
 	};
 
+	class Message;
+
+#if !defined(_WIN32)
+	// A buffer for the ancillary data received with a message (e.g. the segment size of coalesced datagrams)
+	class Control {
+		static const size_t SIZE = 256;
+
+		union {
+			size_t alignment; // Matches the alignment of cmsghdr
+			char data[SIZE];
+		} _value;
+
+	public:
+		Control() : _value() { }
+
+		friend class Message;
+	};
+
+	// The kernel timestamps of a message in nanoseconds since the epoch (0 if not available)
+	class Timestamps {
+	public:
+		// The point at which a send timestamp was taken
+		enum SendStage {
+			SEND_STAGE_NONE = -1, // The timestamps are from a received message
+			SEND_STAGE_SENT = 0, // The data was passed to the device (or the device sent it, for hardware timestamps)
+			SEND_STAGE_SCHEDULED = 1, // The data entered the packet scheduler
+			SEND_STAGE_ACKNOWLEDGED = 2 // All of the data was acknowledged by the peer (TCP only)
+		};
+
+	private:
+		uint64_t _software;
+		uint64_t _hardware;
+		uint32_t _sendId;
+		SendStage _sendStage;
+
+		// Gets the number of nanoseconds since the epoch
+		static uint64_t GetNanoseconds(const timespec &value) { return static_cast<uint64_t>(value.tv_sec) * 1000000000U + static_cast<uint64_t>(value.tv_nsec); }
+
+	public:
+		Timestamps() : _software(), _hardware(), _sendId(), _sendStage(SEND_STAGE_NONE) { }
+
+		// Gets the timestamp taken by the kernel
+		uint64_t GetSoftware() const { return _software; }
+
+		// Gets the timestamp taken by the network device (using the device clock)
+		uint64_t GetHardware() const { return _hardware; }
+
+		// Gets the number of the send call the timestamp belongs to (counting from 0 when send timestamps were enabled on the socket)
+		uint32_t GetSendId() const { return _sendId; }
+
+		// Gets the point at which a send timestamp was taken
+		SendStage GetSendStage() const { return _sendStage; }
+
+		// Returns true if a timestamp is available
+		bool IsValid() const { return _software != 0 || _hardware != 0; }
+
+		friend class Message;
+	};
+#endif
+
 	// A standard layout class containing a set of buffers that can be sent or received as a single message
 	class Message {
 #if defined(_WIN32)
@@ -208,11 +295,22 @@ public:
 #endif
 		mutable msghdr _value;
 
+		// Prepares the message to receive the address and ancillary data
+		void PrepareReceive() const {
+#if !defined(_WIN32)
+			if (_value.msg_control)
+				_value.msg_controllen = sizeof(Control);
+#endif
+			_value.msg_namelen = static_cast<int>(_value.msg_name ? sizeof(IPAddress) : 0);
+		}
+
 	public:
 		// Creates a message structure around an array of buffers (Note: no error checking is done here, it only provides a cross-platform way to access the data)
 		Message(const Buffer buffers[], size_t bufferCount, const IPAddress *address = NULL) : _value() {
-			if (address)
+			if (address) {
 				_value.msg_name = address->GetPointer();
+				_value.msg_namelen = address->GetLength();
+			}
 #if defined(_WIN32)
 			_value.lpBuffers = reinterpret_cast<WSABUF *>(const_cast<Buffer *>(buffers));
 			_value.dwBufferCount = static_cast<ULONG>(bufferCount);
@@ -229,8 +327,76 @@ public:
 #else
 		Buffer *GetBuffers() const { return reinterpret_cast<Buffer *>(_value.msg_iov); }
 		size_t GetLength() const { return _value.msg_iovlen; }
+
+		// Sets the buffer that receives ancillary data (the control buffer must remain valid while the message is being received)
+		void SetControl(Control *control) {
+			_value.msg_control = control ? control->_value.data : NULL;
+			_value.msg_controllen = control ? sizeof(Control) : 0;
+		}
+
+		// Gets the timestamps of the received message (or of a sent message if it was received from the error queue)
+		Timestamps GetTimestamps() const {
+			Timestamps timestamps;
+
+			if (!_value.msg_control)
+				return timestamps;
+
+			for (cmsghdr *header = CMSG_FIRSTHDR(&_value); header; header = CMSG_NXTHDR(&_value, header)) {
+				timespec values[3];
+
+				if (header->cmsg_level == SOL_SOCKET) {
+#if defined(SCM_TIMESTAMPNS)
+					if (header->cmsg_type == SCM_TIMESTAMPNS) {
+						memcpy(values, CMSG_DATA(header), sizeof(values[0]));
+						timestamps._software = Timestamps::GetNanoseconds(values[0]);
+					}
+#endif
+#if defined(SCM_TIMESTAMPING)
+					// The first timestamp is from software, and the last is the raw hardware timestamp
+					if (header->cmsg_type == SCM_TIMESTAMPING) {
+						memcpy(values, CMSG_DATA(header), sizeof(values));
+						timestamps._software = Timestamps::GetNanoseconds(values[0]);
+						timestamps._hardware = Timestamps::GetNanoseconds(values[2]);
+					}
+#endif
+				}
+#if defined(SO_EE_ORIGIN_TIMESTAMPING)
+				else if ((header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_RECVERR) || (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_RECVERR)) {
+					sock_extended_err error;
+
+					memcpy(&error, CMSG_DATA(header), sizeof(error));
+
+					if (error.ee_errno == ENOMSG && error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+						timestamps._sendId = error.ee_data;
+						timestamps._sendStage = static_cast<Timestamps::SendStage>(error.ee_info);
+					}
+				}
+#endif
+			}
+
+			return timestamps;
+		}
+
+		// Gets the size of each datagram coalesced into the received data (0 if the data is a single datagram)
+		size_t GetSegmentSize() const {
+#if defined(UDP_GRO)
+			if (!_value.msg_control)
+				return 0;
+
+			for (cmsghdr *header = CMSG_FIRSTHDR(&_value); header; header = CMSG_NXTHDR(&_value, header)) {
+				if (header->cmsg_level == IPPROTO_UDP && header->cmsg_type == UDP_GRO) {
+					int segmentSize;
+
+					memcpy(&segmentSize, CMSG_DATA(header), sizeof(segmentSize));
+					return segmentSize > 0 ? static_cast<size_t>(segmentSize) : 0;
+				}
+			}
+#endif
+			return 0;
+		}
 #endif
 		friend class IPSocket;
+		friend class IPSocketEngine;
 	};
 
 	// A standard layout class containing a set of buffers that can be sent or received as a single message as part of a multi-message send or receive
@@ -240,14 +406,49 @@ public:
 
 	public:
 		// Creates a message structure for multiple messages around an array of buffers (Note: no error checking is done here, it only provides a cross-platform way to access the data)
-		MultiMessagePart(const Buffer buffers[], size_t bufferCount, const IPAddress *address = NULL) : _message(buffers, bufferCount, address), _result() { }
+		MultiMessagePart(const Buffer buffers[] = NULL, size_t bufferCount = 0, const IPAddress *address = NULL) : _message(buffers, bufferCount, address), _result() { }
 
 		// Gets the array of buffers and length from the metadata (Note: no error checking is done here, it only provides a cross-platform way to access the data)
 		Buffer *GetBuffers() const { return _message.GetBuffers(); }
 		size_t GetLength() const { return _message.GetLength(); }
 
+		// Gets the number of bytes sent or received for this part by the last multi-message operation
+		ResultLength GetResult() const { return _result; }
+#if !defined(_WIN32)
+		// Sets the buffer that receives ancillary data (the control buffer must remain valid while the message is being received)
+		void SetControl(Control *control) { _message.SetControl(control); }
+
+		// Gets the size of each datagram coalesced into the received data (0 if the data is a single datagram)
+		size_t GetSegmentSize() const { return _message.GetSegmentSize(); }
+
+		// Gets the timestamps of the received message
+		Timestamps GetTimestamps() const { return _message.GetTimestamps(); }
+#endif
 		friend class IPSocket;
 	};
+
+	// Splits received data containing coalesced datagrams back into the individual datagrams (without copying)
+	class Segments {
+		const char *_next;
+		const char *_end;
+		size_t _segmentSize;
+
+	public:
+		// Creates the segments of the received data, given the segment size of the message (0 if the data is a single datagram)
+		Segments(const void *data, size_t length, size_t segmentSize) : _next(static_cast<const char *>(data)), _end(_next + length), _segmentSize(segmentSize ? segmentSize : length) { }
+
+		// Gets the next datagram, returning false if there are no more datagrams (the last datagram may be shorter than the segment size)
+		bool Next(Buffer &segment) {
+			if (_next >= _end || _segmentSize == 0)
+				return false;
+
+			const size_t length = static_cast<size_t>(_end - _next) < _segmentSize ? static_cast<size_t>(_end - _next) : _segmentSize;
+
+			segment = Buffer(_next, length);
+			_next += length;
+			return true;
+		}
+	};
 #endif
 
 	// Recommended MTU values to minimize fragmentation
@@ -261,6 +462,14 @@ public:
 	static const int IPV6_MINIMUM_MTU = 1280;
 	static const int IPV4_MINIMUM_MTU = 576;
 
+#if !defined(SMBB_NO_SOCKET_MSG)
+	// The maximum number of datagrams sent by each call to the OS when sending segmented data
+	static const int MAX_SEND_SEGMENTS = 64;
+
+	// The maximum number of bytes sent by each call to the OS when using segmentation offload
+	static const size_t MAX_SEGMENTED_SIZE = 65535 - IPV6_HEADER_SIZE - UDP_HEADER_SIZE;
+#endif
+
 	// Support for select()
 	enum SelectValue {
 		SELECT_NO_CHECK = 0,
@@ -528,6 +737,77 @@ private:
 		static SendMMsgFunction::Type sendMMsg = SendMMsgFunction::Type();
 		return sendMMsg;
 	}
+
+	// Gets the result of a part from a native multi-message operation (the OS only sets the unsigned int at the start of the result)
+	static ResultLength GetNativePartResult(const MultiMessagePart &part) {
+		unsigned int result;
+
+		memcpy(&result, &part._result, sizeof(result));
+		return static_cast<ResultLength>(result);
+	}
+
+	// Gets the flag indicating UDP segmentation offload is supported by the kernel
+	static bool &GetSendSegmentOffload() {
+		static bool sendSegmentOffload = false;
+		return sendSegmentOffload;
+	}
+
+	// Sends the first batch of segments, returning the number of bytes sent
+	MessageResult SendSegmentBatch(const char *data, size_t length, size_t segmentSize, const IPAddress *address) {
+		Buffer buffers[MAX_SEND_SEGMENTS];
+		MultiMessagePart parts[MAX_SEND_SEGMENTS];
+		size_t count = 0;
+		size_t batchLength = 0;
+
+#if defined(UDP_SEGMENT)
+		// Let the kernel (or device) split the data if there is more than one segment (the kernel falls back to sending without offload if it can't be done by the device)
+		if (GetSendSegmentOffload() && segmentSize < length && segmentSize <= MAX_SEGMENTED_SIZE / 2) {
+			union { cmsghdr header; char data[CMSG_SPACE(sizeof(uint16_t))]; } control;
+			const size_t maxSegments = MAX_SEGMENTED_SIZE / segmentSize < size_t(MAX_SEND_SEGMENTS) ? MAX_SEGMENTED_SIZE / segmentSize : size_t(MAX_SEND_SEGMENTS);
+			const uint16_t segment = static_cast<uint16_t>(segmentSize);
+
+			buffers[0] = Buffer(data, length < maxSegments * segmentSize ? length : maxSegments * segmentSize);
+			Message message(buffers, 1, address);
+
+			memset(&control, 0, sizeof(control));
+			message._value.msg_control = control.data;
+			message._value.msg_controllen = sizeof(control.data);
+
+			cmsghdr *header = CMSG_FIRSTHDR(&message._value);
+
+			header->cmsg_level = IPPROTO_UDP;
+			header->cmsg_type = UDP_SEGMENT;
+			header->cmsg_len = CMSG_LEN(sizeof(segment));
+			memcpy(CMSG_DATA(header), &segment, sizeof(segment));
+
+			const ResultLength result = sendmsg(_handle, &message._value, SEND_FLAGS);
+			const int error = result < 0 ? LastError() : 0;
+
+			// Fall back to sending each segment if the offload was rejected (e.g. the segment size is larger than the path MTU)
+			if (result >= 0 || (error != EINVAL && error != EIO && error != ENOPROTOOPT && error != EOPNOTSUPP))
+				return MessageResult(result, error);
+		}
+#endif
+		for (; count < size_t(MAX_SEND_SEGMENTS) && batchLength < length; count++) {
+			const size_t partLength = length - batchLength < segmentSize ? length - batchLength : segmentSize;
+
+			buffers[count] = Buffer(data + batchLength, partLength);
+			parts[count] = MultiMessagePart(&buffers[count], 1, address);
+			batchLength += partLength;
+		}
+
+		MessageResult result = SendMultiple(parts, static_cast<ResultLength>(count));
+
+		if (result.Failed())
+			return result;
+
+		batchLength = 0;
+
+		for (ResultLength i = 0; i < result.GetResult(); i++)
+			batchLength += buffers[i].GetLength();
+
+		return MessageResult(static_cast<ResultLength>(batchLength), 0);
+	}
 #endif
 
 	Handle _handle;
@@ -665,7 +945,9 @@ public:
 		IPAddress address;
 		IPAddressLength addressLength = sizeof(address);
 
-		(void)getsockname(_handle, address.GetPointer(), &addressLength);
+		if (getsockname(_handle, address.GetPointer(), &addressLength) == 0)
+			address.Terminate(addressLength);
+
 		return address;
 	}
 
@@ -674,7 +956,9 @@ public:
 		IPAddress address;
 		IPAddressLength addressLength = sizeof(address);
 
-		(void)getpeername(_handle, address.GetPointer(), &addressLength);
+		if (getpeername(_handle, address.GetPointer(), &addressLength) == 0)
+			address.Terminate(addressLength);
+
 		return address;
 	}
 
@@ -866,6 +1150,45 @@ public:
 #endif
 	}
 
+	// Gets the segment size used to split every send on a UDP socket into multiple datagrams (0 if disabled or not supported)
+	int GetSendSegmentSize() const {
+#if defined(UDP_SEGMENT)
+		return GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(IPPROTO_UDP, UDP_SEGMENT, 0);
+#else
+		return 0;
+#endif
+	}
+
+	// Sets the segment size used to split every send on a UDP socket into multiple datagrams using segmentation offload (0 to disable)
+	Chainable<bool> SetSendSegmentSize(int size) {
+#if defined(UDP_SEGMENT)
+		return Chainable<bool>(this, SetOptionInternal<GET_OPTION_TYPE(int, DWORD)>(IPPROTO_UDP, UDP_SEGMENT, size));
+#else
+		(void)size;
+		return Chainable<bool>(this, false);
+#endif
+	}
+
+	// Checks if received datagrams from the same flow can be coalesced into a single receive
+	bool GetReceiveSegmentOffload() const {
+#if defined(UDP_GRO)
+		return GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(IPPROTO_UDP, UDP_GRO, 0) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Allows received datagrams from the same flow to be coalesced into a single receive (UDP generic receive offload).
+	//  Receive buffers should hold the largest UDP payload, and a control buffer is needed to get the segment size of each receive.
+	Chainable<bool> SetReceiveSegmentOffload(bool enable = true) {
+#if defined(UDP_GRO)
+		return Chainable<bool>(this, SetOptionInternal<GET_OPTION_TYPE(int, DWORD)>(IPPROTO_UDP, UDP_GRO, enable ? 1 : 0));
+#else
+		(void)enable;
+		return Chainable<bool>(this, false);
+#endif
+	}
+
 	// Gets the send buffer size for the socket
 	int GetSendBufferSize() const {
 		return GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_SNDBUF, 0);
@@ -905,6 +1228,81 @@ public:
 		TOS_MASK = 0xFE
 	};
 
+	// Checks if zero-copy sends are enabled on the socket
+	bool GetZeroCopy() const {
+#if defined(SO_ZEROCOPY)
+		return GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_ZEROCOPY, 0) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Enables zero-copy sends on the socket (see IPSocketZeroCopy for tracking when the sent data can be reused)
+	Chainable<bool> SetZeroCopy(bool enable = true) {
+#if defined(SO_ZEROCOPY)
+		return Chainable<bool>(this, SetOptionInternal<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_ZEROCOPY, enable ? 1 : 0));
+#else
+		(void)enable;
+		return Chainable<bool>(this, false);
+#endif
+	}
+
+	enum TimestampFlags {
+#if defined(SO_TIMESTAMPING)
+		TIMESTAMP_RECEIVE_SOFTWARE = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE, // Timestamp received messages when they enter the kernel
+		TIMESTAMP_RECEIVE_HARDWARE = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE, // Timestamp received messages in the network device (the device must be configured to timestamp packets)
+		TIMESTAMP_SEND_SCHEDULED = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY, // Timestamp sent data when it enters the packet scheduler
+		TIMESTAMP_SEND_SOFTWARE = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY, // Timestamp sent data when it is passed to the network device
+		TIMESTAMP_SEND_HARDWARE = SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY, // Timestamp sent data in the network device (the device must be configured to timestamp packets)
+		TIMESTAMP_SEND_ACKNOWLEDGED = SOF_TIMESTAMPING_TX_ACK | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY, // Timestamp sent data when all of it is acknowledged by the peer (TCP only)
+#else
+		TIMESTAMP_RECEIVE_SOFTWARE = 0, // (Not available) Timestamp received messages when they enter the kernel
+		TIMESTAMP_RECEIVE_HARDWARE = 0, // (Not available) Timestamp received messages in the network device
+		TIMESTAMP_SEND_SCHEDULED = 0, // (Not available) Timestamp sent data when it enters the packet scheduler
+		TIMESTAMP_SEND_SOFTWARE = 0, // (Not available) Timestamp sent data when it is passed to the network device
+		TIMESTAMP_SEND_HARDWARE = 0, // (Not available) Timestamp sent data in the network device
+		TIMESTAMP_SEND_ACKNOWLEDGED = 0, // (Not available) Timestamp sent data when all of it is acknowledged by the peer
+#endif
+		TIMESTAMP_NONE = 0
+	};
+
+	// Gets the packet timestamps generated for the socket
+	TimestampFlags GetTimestamping() const {
+#if defined(SO_TIMESTAMPING)
+		return static_cast<TimestampFlags>(GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_TIMESTAMPING, 0));
+#else
+		return TIMESTAMP_NONE;
+#endif
+	}
+
+	// Sets the packet timestamps generated for the socket (receive timestamps are read using a control buffer, and send timestamps using ReceiveSendTimestamps())
+	Chainable<bool> SetTimestamping(TimestampFlags flags) {
+#if defined(SO_TIMESTAMPING)
+		return Chainable<bool>(this, SetOptionInternal<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_TIMESTAMPING, flags));
+#else
+		return Chainable<bool>(this, flags == TIMESTAMP_NONE);
+#endif
+	}
+
+	// Checks if received messages are timestamped in software with nanosecond resolution
+	bool GetReceiveTimestamp() const {
+#if defined(SO_TIMESTAMPNS)
+		return GetOptionInternalDefault<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_TIMESTAMPNS, 0) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// Timestamps received messages in software with nanosecond resolution (a simpler alternative to SetTimestamping(), read using a control buffer)
+	Chainable<bool> SetReceiveTimestamp(bool enable = true) {
+#if defined(SO_TIMESTAMPNS)
+		return Chainable<bool>(this, SetOptionInternal<GET_OPTION_TYPE(int, DWORD)>(SOL_SOCKET, SO_TIMESTAMPNS, enable ? 1 : 0));
+#else
+		(void)enable;
+		return Chainable<bool>(this, false);
+#endif
+	}
+
 	// Gets the type of service option (may not work on all OSes)
 	TypeOfService GetTOS() const {
 		int tos = 0;
@@ -1066,8 +1464,10 @@ public:
 		IPAddressLength length = sizeof(address);
 		IPSocket socket = IPSocket(accept(_handle, address.GetPointer(), &length));
 
-		if (socket.IsValid() && newAddress)
+		if (socket.IsValid() && newAddress) {
+			address.Terminate(length);
 			*newAddress = address;
+		}
 
 		return socket;
 	}
@@ -1150,7 +1550,12 @@ public:
 		int error = LastError();
 		return MessageResult(error == IP_SOCKET_ERROR(MSGSIZE) ? static_cast<ResultLength>(bytesReceived) : -1, error);
 #else
-		return MessageResult(recvfrom(_handle, reinterpret_cast<char *>(data), length, flags, from.GetPointer(), &addressLength));
+		ResultLength result = recvfrom(_handle, reinterpret_cast<char *>(data), length, flags, from.GetPointer(), &addressLength);
+
+		if (result >= 0)
+			from.Terminate(addressLength);
+
+		return MessageResult(result);
 #endif
 	}
 
@@ -1176,8 +1581,12 @@ public:
 		int error = LastError();
 		return MessageResult(error == IP_SOCKET_ERROR(MSGSIZE) ? static_cast<ResultLength>(bytesReceived) : -1, error);
 #else
-		message._value.msg_namelen = static_cast<int>(message._value.msg_name ? sizeof(IPAddress) : 0);
+		message.PrepareReceive();
 		ResultLength result = recvmsg(_handle, &message._value, flags);
+
+		if (result >= 0 && message._value.msg_name)
+			reinterpret_cast<IPAddress *>(message._value.msg_name)->Terminate(static_cast<IPAddressLength>(message._value.msg_namelen));
+
 		return MessageResult(result, (result < 0 ? LastError() : ((message._value.msg_flags & MSG_TRUNC) != 0 ? IP_SOCKET_ERROR(MSGSIZE) : 0)));
 #endif
 	}
@@ -1187,8 +1596,21 @@ public:
 
 	// Receive multiple data packets from the socket (result is number of messages received)
 	MessageResult ReceiveMultiple(MultiMessagePart parts[], ResultLength length, ReceiveFlags flags = RECEIVE_NORMAL) {
-		if (GetRecvMMsg())
-			return MessageResult(GetRecvMMsg()(_handle, parts, length, flags, NULL));
+		if (GetRecvMMsg()) {
+			for (ResultLength i = 0; i < length; i++)
+				parts[i]._message.PrepareReceive();
+
+			MessageResult result(GetRecvMMsg()(_handle, parts, length, flags, NULL));
+
+			for (ResultLength i = 0; i < result.GetResult(); i++) {
+				parts[i]._result = GetNativePartResult(parts[i]);
+
+				if (parts[i]._message._value.msg_name)
+					reinterpret_cast<IPAddress *>(parts[i]._message._value.msg_name)->Terminate(static_cast<IPAddressLength>(parts[i]._message._value.msg_namelen));
+			}
+
+			return result;
+		}
 
 		for (ResultLength i = 0; i < length; i++) {
 			MessageResult result = Receive(parts[i]._message, flags);
@@ -1232,8 +1654,14 @@ public:
 
 	// Send multiple data packets on the socket (result is number of messages sent)
 	MessageResult SendMultiple(MultiMessagePart parts[], ResultLength length) {
-		if (GetSendMMsg())
-			return MessageResult(GetSendMMsg()(_handle, parts, length, SEND_FLAGS));
+		if (GetSendMMsg()) {
+			MessageResult result(GetSendMMsg()(_handle, parts, length, SEND_FLAGS));
+
+			for (ResultLength i = 0; i < result.GetResult(); i++)
+				parts[i]._result = GetNativePartResult(parts[i]);
+
+			return result;
+		}
 
 		for (ResultLength i = 0; i < length; i++) {
 			MessageResult result = Send(parts[i]._message);
@@ -1246,6 +1674,75 @@ public:
 
 		return MessageResult(length, 0);
 	}
+
+	// Checks if native UDP segmentation offload is available (otherwise, segmented sends are emulated with send multiple)
+	static bool HasNativeSendSegmented() { return GetSendSegmentOffload(); }
+
+	// Sends the data as consecutive datagrams of the segment size (the last datagram may be shorter), result is the number of bytes sent.
+	//  With UDP segmentation offload, up to MAX_SEND_SEGMENTS datagrams are built by the kernel (or device) from each call to the OS.
+	MessageResult SendSegmented(const void *data, DataLength length, DataLength segmentSize, const IPAddress *address = NULL) {
+		const char *next = static_cast<const char *>(data);
+		size_t sent = 0;
+
+		if (segmentSize == 0)
+			return MessageResult(-1, IP_SOCKET_ERROR(INVAL));
+
+		while (sent < static_cast<size_t>(length)) {
+			MessageResult result = SendSegmentBatch(next + sent, static_cast<size_t>(length) - sent, static_cast<size_t>(segmentSize), address);
+
+			if (result.Failed())
+				return sent == 0 ? result : MessageResult(static_cast<ResultLength>(sent), result.GetError());
+
+			sent += static_cast<size_t>(result.GetResult());
+		}
+
+		return MessageResult(static_cast<ResultLength>(sent), 0);
+	}
+
+#if !defined(_WIN32)
+	// Reads the next send timestamp from the socket error queue without blocking, returning false if none are available (other notifications on the error queue are discarded)
+	//  Since zero-copy completions are also read from the error queue, this can not be used on a socket used by IPSocketZeroCopy (its completions would be lost).
+	bool ReceiveSendTimestamps(Timestamps &timestamps) {
+#if defined(MSG_ERRQUEUE)
+		Control control;
+		Message message(NULL, 0);
+
+		message.SetControl(&control);
+
+		for (;;) {
+			message.PrepareReceive();
+
+			if (recvmsg(_handle, &message._value, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+				if (LastError() == IP_SOCKET_ERROR(INTR))
+					continue;
+
+				return false;
+			}
+
+			timestamps = message.GetTimestamps();
+
+			if (timestamps.GetSendStage() != Timestamps::SEND_STAGE_NONE)
+				return true;
+		}
+#else
+		(void)timestamps;
+		return false;
+#endif
+	}
+#endif
+
+#if defined(MSG_ZEROCOPY)
+	// Sends data without copying it if zero-copy is enabled on the socket (the data must not be modified until the kernel reports that the send completed)
+	MessageResult SendZeroCopy(const void *data, DataLength length) {
+		return MessageResult(send(_handle, data, length, SEND_FLAGS | MSG_ZEROCOPY));
+	}
+
+	// Sends a message without copying it if zero-copy is enabled on the socket (the data must not be modified until the kernel reports that the send completed)
+	MessageResult SendZeroCopy(const Message &message) {
+		message._value.msg_namelen = (message._value.msg_name ? reinterpret_cast<const IPAddress *>(message._value.msg_name)->GetLength() : 0);
+		return MessageResult(sendmsg(_handle, &message._value, SEND_FLAGS | MSG_ZEROCOPY));
+	}
+#endif
 #endif // SMBB_NO_SOCKET_MSG
 
 	// Gets the number of hops value for outgoing multicast packets
@@ -1353,6 +1850,9 @@ inline IPSocket::TypeOfService operator&(IPSocket::TypeOfService x, IPSocket::Ty
 inline IPSocket::DSCP operator|(IPSocket::DSCP x, IPSocket::DSCP y) { return static_cast<IPSocket::DSCP>(static_cast<int>(x) | y); }
 inline IPSocket::DSCP operator&(IPSocket::DSCP x, IPSocket::DSCP y) { return static_cast<IPSocket::DSCP>(static_cast<int>(x) & y); }
 
+inline IPSocket::TimestampFlags operator|(IPSocket::TimestampFlags x, IPSocket::TimestampFlags y) { return static_cast<IPSocket::TimestampFlags>(static_cast<int>(x) | y); }
+inline IPSocket::TimestampFlags operator&(IPSocket::TimestampFlags x, IPSocket::TimestampFlags y) { return static_cast<IPSocket::TimestampFlags>(static_cast<int>(x) & y); }
+
 inline IPSocket::ReceiveFlags operator|(IPSocket::ReceiveFlags x, IPSocket::ReceiveFlags y) { return static_cast<IPSocket::ReceiveFlags>(static_cast<int>(x) | y); }
 inline IPSocket::ReceiveFlags operator&(IPSocket::ReceiveFlags x, IPSocket::ReceiveFlags y) { return static_cast<IPSocket::ReceiveFlags>(static_cast<int>(x) & y); }
 
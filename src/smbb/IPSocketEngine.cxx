@@ -0,0 +1,615 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "IPSocketEngine.h"
+
+#if !defined(SMBB_NO_SOCKET_ENGINE)
+#include <cstring>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// The io_uring system calls (numbered the same on all architectures using the generic system call table)
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+#endif
+
+namespace smbb {
+namespace engine_detail {
+
+// The io_uring definitions used by the engine (see linux/io_uring.h)
+enum {
+	OPCODE_READ_FIXED = 4,
+	OPCODE_WRITE_FIXED = 5,
+	OPCODE_SENDMSG = 9,
+	OPCODE_RECVMSG = 10,
+	OPCODE_ACCEPT = 13,
+	OPCODE_SEND = 26,
+	OPCODE_RECV = 27
+};
+
+static const uint8_t ENTRY_FIXED_FILE = 1U << 0;
+
+static const uint32_t SETUP_SQPOLL = 1U << 1;
+
+static const uint32_t FEATURE_SINGLE_MMAP = 1U << 0;
+static const uint32_t FEATURE_NODROP = 1U << 1;
+static const uint32_t FEATURE_FAST_POLL = 1U << 5;
+
+static const uint32_t ENTER_GETEVENTS = 1U << 0;
+static const uint32_t ENTER_SQ_WAKEUP = 1U << 1;
+
+static const uint32_t SUBMISSION_NEED_WAKEUP = 1U << 0;
+
+static const unsigned int REGISTER_BUFFERS = 0;
+static const unsigned int UNREGISTER_BUFFERS = 1;
+static const unsigned int REGISTER_FILES = 2;
+static const unsigned int UNREGISTER_FILES = 3;
+
+static const off_t OFFSET_SUBMISSION_RING = 0;
+static const off_t OFFSET_COMPLETION_RING = 0x8000000;
+static const off_t OFFSET_SUBMISSIONS = 0x10000000;
+
+// The offsets of the fields of the submission ring
+struct SubmissionRingOffsets {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t ringMask;
+	uint32_t ringEntries;
+	uint32_t flags;
+	uint32_t dropped;
+	uint32_t array;
+	uint32_t reserved1;
+	uint64_t reserved2;
+};
+
+// The offsets of the fields of the completion ring
+struct CompletionRingOffsets {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t ringMask;
+	uint32_t ringEntries;
+	uint32_t overflow;
+	uint32_t completions;
+	uint32_t flags;
+	uint32_t reserved1;
+	uint64_t reserved2;
+};
+
+// The parameters used to create an io_uring
+struct Parameters {
+	uint32_t submissionEntries;
+	uint32_t completionEntries;
+	uint32_t flags;
+	uint32_t submissionThreadCPU;
+	uint32_t submissionThreadIdle;
+	uint32_t features;
+	uint32_t workQueue;
+	uint32_t reserved[3];
+	SubmissionRingOffsets submissionOffsets;
+	CompletionRingOffsets completionOffsets;
+};
+
+}
+}
+
+// A submission queue entry (64 bytes)
+struct smbb::IPSocketEngine::SubmissionEntry {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t priority;
+	int32_t descriptor;
+	uint64_t offset;
+	uint64_t address;
+	uint32_t length;
+	uint32_t operationFlags;
+	uint64_t userData;
+	uint16_t bufferIndex;
+	uint16_t personality;
+	int32_t spliceDescriptor;
+	uint64_t reserved[2];
+};
+
+// A completion queue entry (16 bytes)
+struct smbb::IPSocketEngine::CompletionEntry {
+	uint64_t userData;
+	int32_t result;
+	uint32_t flags;
+};
+
+// An operation queued when using poll()
+struct smbb::IPSocketEngine::Request {
+	void *data;
+	size_t length;
+	const void *message;
+	uint64_t userData;
+	IPSocket::Handle handle;
+	uint32_t bufferIndex;
+	int flags;
+	int operation;
+};
+
+// Creates the io_uring
+bool smbb::IPSocketEngine::CreateRing(uint32_t entries, bool kernelPolling) {
+#if defined(__linux__)
+	using namespace engine_detail;
+
+	Parameters parameters;
+
+	memset(&parameters, 0, sizeof(parameters));
+
+	if (kernelPolling) {
+		parameters.flags = SETUP_SQPOLL;
+		parameters.submissionThreadIdle = 1000;
+	}
+
+	_ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &parameters));
+
+	if (_ring == -1)
+		return false;
+
+	// Sockets must be polled internally rather than handed to worker threads, and completions must never be dropped
+	if ((parameters.features & FEATURE_FAST_POLL) == 0 || (parameters.features & FEATURE_NODROP) == 0) {
+		Close();
+		return false;
+	}
+
+	_submissionRingSize = parameters.submissionOffsets.array + parameters.submissionEntries * sizeof(uint32_t);
+	_completionRingSize = parameters.completionOffsets.completions + parameters.completionEntries * sizeof(CompletionEntry);
+
+	if (parameters.features & FEATURE_SINGLE_MMAP) {
+		if (_completionRingSize > _submissionRingSize)
+			_submissionRingSize = _completionRingSize;
+
+		_completionRingSize = _submissionRingSize;
+	}
+
+	void *submissionRing = mmap(NULL, _submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, OFFSET_SUBMISSION_RING);
+	void *completionRing = MAP_FAILED;
+	void *submissions = MAP_FAILED;
+
+	if (submissionRing != MAP_FAILED) {
+		_submissionRing = static_cast<uint8_t *>(submissionRing);
+		completionRing = (parameters.features & FEATURE_SINGLE_MMAP) ? submissionRing : mmap(NULL, _completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, OFFSET_COMPLETION_RING);
+	}
+
+	if (completionRing != MAP_FAILED) {
+		_completionRing = static_cast<uint8_t *>(completionRing);
+		_submissionsSize = parameters.submissionEntries * sizeof(SubmissionEntry);
+		submissions = mmap(NULL, _submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring, OFFSET_SUBMISSIONS);
+	}
+
+	if (submissions == MAP_FAILED) {
+		Close();
+		return false;
+	}
+
+	_submissions = static_cast<SubmissionEntry *>(submissions);
+	_submissionHead = reinterpret_cast<Atomic<uint32_t> *>(_submissionRing + parameters.submissionOffsets.head);
+	_submissionTail = reinterpret_cast<Atomic<uint32_t> *>(_submissionRing + parameters.submissionOffsets.tail);
+	_submissionFlags = reinterpret_cast<Atomic<uint32_t> *>(_submissionRing + parameters.submissionOffsets.flags);
+	_submissionMask = *reinterpret_cast<uint32_t *>(_submissionRing + parameters.submissionOffsets.ringMask);
+	_submissionEntries = *reinterpret_cast<uint32_t *>(_submissionRing + parameters.submissionOffsets.ringEntries);
+	_completionHead = reinterpret_cast<Atomic<uint32_t> *>(_completionRing + parameters.completionOffsets.head);
+	_completionTail = reinterpret_cast<Atomic<uint32_t> *>(_completionRing + parameters.completionOffsets.tail);
+	_completionMask = *reinterpret_cast<uint32_t *>(_completionRing + parameters.completionOffsets.ringMask);
+	_completions = reinterpret_cast<CompletionEntry *>(_completionRing + parameters.completionOffsets.completions);
+
+	// Each slot of the submission ring always refers to the submission entry with the same index
+	uint32_t *array = reinterpret_cast<uint32_t *>(_submissionRing + parameters.submissionOffsets.array);
+
+	for (uint32_t i = 0; i < _submissionEntries; i++)
+		array[i] = i;
+
+	_queuedTail = _submissionTail->Load(MEMORY_ORDER_RELAXED);
+	_submittedTail = _queuedTail;
+	_kernelPolling = kernelPolling;
+	return true;
+#else
+	(void)entries;
+	(void)kernelPolling;
+	return false;
+#endif
+}
+
+// Queues an operation
+smbb::IPSocketEngine::Result smbb::IPSocketEngine::Queue(Operation operation, const Target &target, void *data, size_t length, const void *message, uint32_t bufferIndex, int flags, uint64_t userData) {
+	if (!IsValid())
+		return ENGINE_FAILED_UNSUPPORTED;
+	else if (length > 0x7FFFFFFF)
+		return ENGINE_FAILED_BAD_SIZE;
+	else if (target._registered ? static_cast<uint32_t>(target._handle) >= _socketCount : target._handle == IPSocket::INVALID_HANDLE)
+		return ENGINE_FAILED_BAD_TARGET;
+
+	// The data of a fixed operation is the offset into the registered buffer
+	if (operation == OPERATION_RECEIVE_FIXED || operation == OPERATION_SEND_FIXED) {
+		const size_t offset = reinterpret_cast<size_t>(data);
+
+		if (bufferIndex >= _bufferCount || offset > _buffers[bufferIndex].GetLength() || length > _buffers[bufferIndex].GetLength() - offset)
+			return ENGINE_FAILED_BAD_BUFFER;
+
+		data = static_cast<uint8_t *>(_buffers[bufferIndex].GetData()) + offset;
+	}
+
+#if defined(__linux__)
+	if (IsUsingRing()) {
+		using namespace engine_detail;
+
+		if (_queuedTail - _submissionHead->Load(MEMORY_ORDER_ACQUIRE) >= _submissionEntries)
+			return ENGINE_FULL;
+
+		SubmissionEntry &entry = _submissions[_queuedTail & _submissionMask];
+
+		memset(&entry, 0, sizeof(entry));
+		entry.flags = target._registered ? ENTRY_FIXED_FILE : 0;
+		entry.descriptor = target._handle;
+		entry.userData = userData;
+
+		switch (operation) {
+		case OPERATION_RECEIVE: entry.opcode = OPCODE_RECV; break;
+		case OPERATION_SEND: entry.opcode = OPCODE_SEND; break;
+		case OPERATION_RECEIVE_MESSAGE: entry.opcode = OPCODE_RECVMSG; break;
+		case OPERATION_SEND_MESSAGE: entry.opcode = OPCODE_SENDMSG; break;
+		case OPERATION_ACCEPT: entry.opcode = OPCODE_ACCEPT; break;
+		case OPERATION_RECEIVE_FIXED: entry.opcode = OPCODE_READ_FIXED; break;
+		case OPERATION_SEND_FIXED: entry.opcode = OPCODE_WRITE_FIXED; break;
+		}
+
+		if (operation == OPERATION_RECEIVE_FIXED || operation == OPERATION_SEND_FIXED) {
+			entry.offset = uint64_t(-1); // Use the current position (sockets are not seekable)
+			entry.bufferIndex = static_cast<uint16_t>(bufferIndex);
+		}
+		else
+			entry.operationFlags = static_cast<uint32_t>(flags);
+
+		entry.address = reinterpret_cast<uintptr_t>(message ? message : data);
+		entry.length = message ? 1 : static_cast<uint32_t>(length);
+
+		_queuedTail++;
+		return ENGINE_SUCCESS;
+	}
+#endif
+
+	if (_pending >= _capacity)
+		return ENGINE_FULL;
+
+	Request &request = _requests[_pending++];
+
+	request.data = data;
+	request.length = length;
+	request.message = message;
+	request.userData = userData;
+	request.handle = GetHandle(target);
+	request.bufferIndex = bufferIndex;
+	request.flags = flags;
+	request.operation = operation;
+	return ENGINE_SUCCESS;
+}
+
+// Performs a queued operation without blocking when using poll(), returning false if it would block
+bool smbb::IPSocketEngine::Perform(const Request &request, int32_t &result) const {
+	const int nonblocking = IPSocket::RECEIVE_REQUEST_NONBLOCKING;
+	ssize_t length = -1;
+
+	switch (request.operation) {
+	case OPERATION_RECEIVE:
+	case OPERATION_RECEIVE_FIXED:
+		length = recv(request.handle, request.data, request.length, request.flags | nonblocking);
+		break;
+
+	case OPERATION_SEND:
+	case OPERATION_SEND_FIXED:
+		length = send(request.handle, request.data, request.length, IPSocket::SEND_FLAGS | nonblocking);
+		break;
+
+	case OPERATION_RECEIVE_MESSAGE:
+		length = recvmsg(request.handle, static_cast<msghdr *>(const_cast<void *>(request.message)), request.flags | nonblocking);
+		break;
+
+	case OPERATION_SEND_MESSAGE:
+		length = sendmsg(request.handle, static_cast<const msghdr *>(request.message), IPSocket::SEND_FLAGS | nonblocking);
+		break;
+
+	case OPERATION_ACCEPT:
+		length = accept(request.handle, NULL, NULL);
+		break;
+	}
+
+	if (length >= 0)
+		result = static_cast<int32_t>(length);
+	else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		return false;
+	else
+		result = -errno;
+
+	return true;
+}
+
+// Gets the size of the workspace required to use poll() with the specified number of entries
+size_t smbb::IPSocketEngine::GetWorkspaceSize(uint32_t entries) {
+	return entries * (sizeof(Request) + sizeof(struct pollfd));
+}
+
+smbb::IPSocketEngine::IPSocketEngine() : _ring(-1), _submissionRing(), _submissionRingSize(), _completionRing(), _completionRingSize(), _submissions(), _submissionsSize(),
+		_submissionHead(), _submissionTail(), _submissionFlags(), _submissionMask(), _submissionEntries(), _queuedTail(), _submittedTail(),
+		_completionHead(), _completionTail(), _completionMask(), _completions(), _kernelPolling(),
+		_requests(), _pollItems(), _capacity(), _pending(), _buffers(), _bufferCount(), _sockets(), _socketCount() { }
+
+// Creates the engine with the specified number of entries
+smbb::IPSocketEngine::Result smbb::IPSocketEngine::Create(uint32_t entries, void *workspace, size_t workspaceSize, Mode mode) {
+	Close();
+
+	if (entries == 0 || entries > MAX_ENTRIES || (entries & (entries - 1)) != 0)
+		return ENGINE_FAILED_BAD_SIZE;
+
+	if (mode != MODE_POLL) {
+		if ((mode == MODE_RING_KERNEL_POLLING && CreateRing(entries, true)) || CreateRing(entries, false))
+			return ENGINE_SUCCESS;
+		else if (mode != MODE_AUTOMATIC)
+			return ENGINE_FAILED_UNSUPPORTED;
+	}
+
+	if (!workspace || workspaceSize < GetWorkspaceSize(entries) || reinterpret_cast<uintptr_t>(workspace) % sizeof(void *) != 0)
+		return ENGINE_FAILED_BAD_SIZE;
+
+	_requests = static_cast<Request *>(workspace);
+	_pollItems = reinterpret_cast<struct pollfd *>(static_cast<uint8_t *>(workspace) + entries * sizeof(Request));
+	_capacity = entries;
+	return ENGINE_SUCCESS;
+}
+
+// Registers buffers with the kernel for use with the fixed operations
+smbb::IPSocketEngine::Result smbb::IPSocketEngine::RegisterBuffers(const IPSocket::Buffer buffers[], uint32_t count) {
+	UnregisterBuffers();
+
+	if (!IsValid())
+		return ENGINE_FAILED_UNSUPPORTED;
+	else if (!buffers || count == 0 || count > 0xFFFF)
+		return ENGINE_FAILED_BAD_BUFFER;
+
+#if defined(__linux__)
+	if (IsUsingRing() && syscall(__NR_io_uring_register, _ring, engine_detail::REGISTER_BUFFERS, buffers, count) != 0)
+		return ENGINE_FAILED_TO_REGISTER;
+#endif
+
+	_buffers = buffers;
+	_bufferCount = count;
+	return ENGINE_SUCCESS;
+}
+
+// Unregisters all buffers
+void smbb::IPSocketEngine::UnregisterBuffers() {
+#if defined(__linux__)
+	if (IsUsingRing() && _bufferCount)
+		(void)syscall(__NR_io_uring_register, _ring, engine_detail::UNREGISTER_BUFFERS, NULL, 0);
+#endif
+
+	_buffers = NULL;
+	_bufferCount = 0;
+}
+
+// Registers sockets with the kernel, so they can be targeted by index
+smbb::IPSocketEngine::Result smbb::IPSocketEngine::RegisterSockets(const IPSocket::Handle sockets[], uint32_t count) {
+	UnregisterSockets();
+
+	if (!IsValid())
+		return ENGINE_FAILED_UNSUPPORTED;
+	else if (!sockets || count == 0)
+		return ENGINE_FAILED_BAD_TARGET;
+
+#if defined(__linux__)
+	if (IsUsingRing() && syscall(__NR_io_uring_register, _ring, engine_detail::REGISTER_FILES, sockets, count) != 0)
+		return ENGINE_FAILED_TO_REGISTER;
+#endif
+
+	_sockets = sockets;
+	_socketCount = count;
+	return ENGINE_SUCCESS;
+}
+
+// Unregisters all sockets
+void smbb::IPSocketEngine::UnregisterSockets() {
+#if defined(__linux__)
+	if (IsUsingRing() && _socketCount)
+		(void)syscall(__NR_io_uring_register, _ring, engine_detail::UNREGISTER_FILES, NULL, 0);
+#endif
+
+	_sockets = NULL;
+	_socketCount = 0;
+}
+
+// Submits all queued operations, returning the number submitted
+int smbb::IPSocketEngine::Submit() {
+	if (!IsUsingRing())
+		return IsValid() ? 0 : -1; // Operations are performed when reaping
+
+#if defined(__linux__)
+	using namespace engine_detail;
+
+	const uint32_t count = _queuedTail - _submittedTail;
+
+	if (count == 0)
+		return 0;
+
+	_submissionTail->Store(_queuedTail, MEMORY_ORDER_SEQUENTIAL);
+
+	// The kernel thread picks up the operations on its own, unless it has gone idle
+	if (_kernelPolling) {
+		_submittedTail = _queuedTail;
+
+		if ((_submissionFlags->Load(MEMORY_ORDER_SEQUENTIAL) & SUBMISSION_NEED_WAKEUP) != 0)
+			(void)syscall(__NR_io_uring_enter, _ring, 0, 0, ENTER_SQ_WAKEUP, NULL, 0);
+
+		return static_cast<int>(count);
+	}
+
+	const int result = static_cast<int>(syscall(__NR_io_uring_enter, _ring, count, 0, 0, NULL, 0));
+
+	if (result < 0)
+		return errno == EINTR || errno == EAGAIN || errno == EBUSY ? 0 : -1;
+
+	_submittedTail += static_cast<uint32_t>(result);
+	return result;
+#else
+	return -1;
+#endif
+}
+
+// Submits all queued operations and reaps completed operations, waiting until at least the specified number have completed
+int smbb::IPSocketEngine::Reap(Completion completions[], uint32_t maxCompletions, uint32_t waitFor) {
+	uint32_t count = 0;
+
+	if (waitFor > maxCompletions)
+		waitFor = maxCompletions;
+
+	if (!IsValid())
+		return -1;
+#if defined(__linux__)
+	else if (IsUsingRing()) {
+		using namespace engine_detail;
+
+		const uint32_t head = _completionHead->Load(MEMORY_ORDER_RELAXED);
+		uint32_t available = _completionTail->Load(MEMORY_ORDER_ACQUIRE) - head;
+		const uint32_t queued = _queuedTail - _submittedTail;
+
+		// Submit and wait using a single system call
+		if (queued != 0 || available < waitFor) {
+			const uint32_t waitFlags = available < waitFor ? ENTER_GETEVENTS : 0;
+			int result;
+
+			if (_kernelPolling) {
+				(void)Submit();
+				result = waitFlags ? static_cast<int>(syscall(__NR_io_uring_enter, _ring, 0, waitFor, waitFlags, NULL, 0)) : 0;
+			}
+			else {
+				_submissionTail->Store(_queuedTail, MEMORY_ORDER_RELEASE);
+				result = static_cast<int>(syscall(__NR_io_uring_enter, _ring, queued, waitFlags ? waitFor : 0, waitFlags, NULL, 0));
+
+				if (result > 0)
+					_submittedTail += static_cast<uint32_t>(result);
+			}
+
+			if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				return -1;
+
+			available = _completionTail->Load(MEMORY_ORDER_ACQUIRE) - head;
+		}
+
+		for (; count < available && count < maxCompletions; count++) {
+			const CompletionEntry &entry = _completions[(head + count) & _completionMask];
+
+			completions[count]._data = entry.userData;
+			completions[count]._result = entry.result;
+		}
+
+		_completionHead->Store(head + count, MEMORY_ORDER_RELEASE);
+		return static_cast<int>(count);
+	}
+#endif
+
+	// Poll the sockets with queued operations, and perform the operations on the ready sockets (in order, so operations on the same socket stay in order)
+	while (_pending != 0 && count < maxCompletions) {
+		for (uint32_t i = 0; i < _pending; i++) {
+			const int operation = _requests[i].operation;
+
+			_pollItems[i].fd = _requests[i].handle;
+			_pollItems[i].events = (operation == OPERATION_SEND || operation == OPERATION_SEND_FIXED || operation == OPERATION_SEND_MESSAGE) ? POLLOUT : POLLIN;
+			_pollItems[i].revents = 0;
+		}
+
+		const int ready = poll(_pollItems, _pending, count < waitFor ? -1 : 0);
+
+		if (ready < 0 && errno != EINTR)
+			return count ? static_cast<int>(count) : -1;
+		else if (ready <= 0 && count >= waitFor)
+			break;
+
+		uint32_t kept = 0;
+
+		for (uint32_t i = 0; i < _pending; i++) {
+			int32_t result;
+
+			if (count < maxCompletions && _pollItems[i].revents != 0 && Perform(_requests[i], result)) {
+				completions[count]._data = _requests[i].userData;
+				completions[count]._result = result;
+				count++;
+			}
+			else
+				_requests[kept++] = _requests[i];
+		}
+
+		_pending = kept;
+
+		if (count >= waitFor)
+			break;
+	}
+
+	return static_cast<int>(count);
+}
+
+// Closes the engine
+void smbb::IPSocketEngine::Close() {
+#if defined(__linux__)
+	if (_submissions)
+		(void)munmap(_submissions, _submissionsSize);
+
+	if (_completionRing && _completionRing != _submissionRing)
+		(void)munmap(_completionRing, _completionRingSize);
+
+	if (_submissionRing)
+		(void)munmap(_submissionRing, _submissionRingSize);
+#endif
+
+	if (_ring != -1)
+		(void)close(_ring);
+
+	_ring = -1;
+	_submissionRing = NULL;
+	_completionRing = NULL;
+	_submissions = NULL;
+	_kernelPolling = false;
+	_requests = NULL;
+	_pollItems = NULL;
+	_capacity = 0;
+	_pending = 0;
+	_buffers = NULL;
+	_bufferCount = 0;
+	_sockets = NULL;
+	_socketCount = 0;
+}
+#endif
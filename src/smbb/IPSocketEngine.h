@@ -0,0 +1,272 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_IPSOCKETENGINE_H
+#define SMBB_IPSOCKETENGINE_H
+
+// The engine uses poll() when io_uring is not available, so it is not available on Windows
+#if (defined(_WIN32) || defined(SMBB_NO_POLL)) && !defined(SMBB_NO_SOCKET_ENGINE)
+#define SMBB_NO_SOCKET_ENGINE
+#endif
+
+#if !defined(SMBB_NO_SOCKET_ENGINE)
+#include <cstdlib>
+#include <cstring>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "IPSocket.h"
+
+namespace smbb {
+
+// Performs batches of asynchronous socket operations (receive, send, and accept) using io_uring on Linux.
+//  Operations are queued in memory shared with the kernel, and a single system call both submits all queued operations and waits for completions.
+//  Completions are reaped directly from shared memory, so under load (or with kernel polling) the number of system calls per message approaches zero.
+//  Buffers and sockets can be registered with the kernel ahead of time, avoiding the cost of mapping them on every operation.
+//  When io_uring is not available, the same operations are performed using poll() with a caller-provided workspace.
+//  Operations complete in any order, and multiple receives queued on the same stream socket may be filled in any order when using io_uring.
+class IPSocketEngine {
+public:
+	enum Result {
+		ENGINE_SUCCESS = 0,
+		ENGINE_FULL, // The submission queue is full (submit or reap before queuing more operations)
+		ENGINE_FAILED_UNSUPPORTED,
+		ENGINE_FAILED_BAD_SIZE,
+		ENGINE_FAILED_BAD_TARGET,
+		ENGINE_FAILED_BAD_BUFFER,
+		ENGINE_FAILED_TO_CREATE,
+		ENGINE_FAILED_TO_REGISTER
+	};
+
+	enum Mode {
+		MODE_AUTOMATIC = 0, // Uses io_uring if available, otherwise poll()
+		MODE_RING, // Uses io_uring only
+		MODE_RING_KERNEL_POLLING, // Uses io_uring with a kernel thread that polls for submissions, so submitting rarely needs a system call (falls back to MODE_RING)
+		MODE_POLL // Uses poll() only
+	};
+
+	// The maximum number of queued operations
+	static const uint32_t MAX_ENTRIES = 4096;
+
+	// The socket an operation is performed on (either a socket or the index of a registered socket)
+	class Target {
+		IPSocket::Handle _handle;
+		bool _registered;
+
+		Target(IPSocket::Handle handle, bool registered) : _handle(handle), _registered(registered) { }
+
+	public:
+		// Targets a socket
+		Target(const IPSocket &socket) : _handle(socket.GetNativeHandle()), _registered(false) { }
+
+		// Targets a socket registered using RegisterSockets()
+		static Target Registered(uint32_t index) { return Target(static_cast<IPSocket::Handle>(index), true); }
+
+		friend class IPSocketEngine;
+	};
+
+	// The result of a completed operation
+	class Completion {
+		uint64_t _data;
+		int32_t _result;
+
+	public:
+		Completion() : _data(), _result() { }
+
+		// Gets the user data of the operation
+		uint64_t GetData() const { return _data; }
+
+		// Gets the result of the operation (the number of bytes sent or received, or the socket accepted), along with any error
+		IPSocket::MessageResult GetResult() const { return IPSocket::MessageResult(_result < 0 ? -1 : _result, _result < 0 ? -_result : 0); }
+
+		// Gets the socket accepted by an accept operation
+		IPSocket GetSocket() const { return IPSocket(_result < 0 ? IPSocket::INVALID_HANDLE : static_cast<IPSocket::Handle>(_result)); }
+
+		friend class IPSocketEngine;
+	};
+
+private:
+	// Kernel structures (defined in the implementation to avoid depending on the kernel headers)
+	struct SubmissionEntry;
+	struct CompletionEntry;
+
+	// An operation queued when using poll()
+	struct Request;
+
+	// Operation types
+	enum Operation {
+		OPERATION_RECEIVE,
+		OPERATION_SEND,
+		OPERATION_RECEIVE_MESSAGE,
+		OPERATION_SEND_MESSAGE,
+		OPERATION_ACCEPT,
+		OPERATION_RECEIVE_FIXED,
+		OPERATION_SEND_FIXED
+	};
+
+	// The io_uring state
+	int _ring;
+	uint8_t *_submissionRing;
+	size_t _submissionRingSize;
+	uint8_t *_completionRing;
+	size_t _completionRingSize;
+	SubmissionEntry *_submissions;
+	size_t _submissionsSize;
+	Atomic<uint32_t> *_submissionHead;
+	Atomic<uint32_t> *_submissionTail;
+	Atomic<uint32_t> *_submissionFlags;
+	uint32_t _submissionMask;
+	uint32_t _submissionEntries;
+	uint32_t _queuedTail; // The tail including queued operations that have not been published to the kernel
+	uint32_t _submittedTail; // The tail that has been submitted to the kernel
+	Atomic<uint32_t> *_completionHead;
+	Atomic<uint32_t> *_completionTail;
+	uint32_t _completionMask;
+	CompletionEntry *_completions;
+	bool _kernelPolling;
+
+	// The poll() state
+	Request *_requests;
+	struct pollfd *_pollItems;
+	uint32_t _capacity;
+	uint32_t _pending;
+
+	// The registered buffers and sockets (only referenced when using poll())
+	const IPSocket::Buffer *_buffers;
+	uint32_t _bufferCount;
+	const IPSocket::Handle *_sockets;
+	uint32_t _socketCount;
+
+	// Disable copying
+	IPSocketEngine(const IPSocketEngine &) { }
+	IPSocketEngine &operator=(const IPSocketEngine &) { return *this; }
+
+	// Creates the io_uring
+	SMBB_INLINE bool CreateRing(uint32_t entries, bool kernelPolling);
+
+	// Queues an operation
+	SMBB_INLINE Result Queue(Operation operation, const Target &target, void *data, size_t length, const void *message, uint32_t bufferIndex, int flags, uint64_t userData);
+
+	// Performs a queued operation without blocking when using poll(), returning false if it would block
+	SMBB_INLINE bool Perform(const Request &request, int32_t &result) const;
+
+	// Gets the handle of a target when using poll() (or INVALID_HANDLE if it is not valid)
+	IPSocket::Handle GetHandle(const Target &target) const {
+		return !target._registered ? target._handle : static_cast<uint32_t>(target._handle) < _socketCount ? _sockets[target._handle] : IPSocket::INVALID_HANDLE;
+	}
+
+public:
+	// Gets the size of the workspace required to use poll() with the specified number of entries
+	static SMBB_INLINE size_t GetWorkspaceSize(uint32_t entries);
+
+	SMBB_INLINE IPSocketEngine();
+	~IPSocketEngine() { Close(); }
+
+	// Creates the engine with the specified number of entries (a power of 2 up to MAX_ENTRIES)
+	//  The workspace is only used with poll(), so it can be NULL when using io_uring only.
+	SMBB_INLINE Result Create(uint32_t entries, void *workspace = NULL, size_t workspaceSize = 0, Mode mode = MODE_AUTOMATIC);
+
+	// Returns true if the engine has been created
+	bool IsValid() const { return _ring != -1 || _requests != NULL; }
+
+	// Returns true if the engine is using io_uring (rather than poll())
+	bool IsUsingRing() const { return _ring != -1; }
+
+	// Returns true if the engine is using a kernel thread to poll for submissions
+	bool IsKernelPolling() const { return _kernelPolling; }
+
+	// Registers buffers with the kernel for use with the fixed operations (the buffers must remain valid until they are unregistered)
+	SMBB_INLINE Result RegisterBuffers(const IPSocket::Buffer buffers[], uint32_t count);
+
+	// Unregisters all buffers
+	SMBB_INLINE void UnregisterBuffers();
+
+	// Registers sockets with the kernel, so they can be targeted by index without being looked up on every operation (the handles must remain valid until they are unregistered)
+	SMBB_INLINE Result RegisterSockets(const IPSocket::Handle sockets[], uint32_t count);
+
+	// Unregisters all sockets
+	SMBB_INLINE void UnregisterSockets();
+
+	// Queues a receive into the specified buffer
+	Result QueueReceive(const Target &target, void *data, size_t length, uint64_t userData, IPSocket::ReceiveFlags flags = IPSocket::RECEIVE_NORMAL) {
+		return Queue(OPERATION_RECEIVE, target, data, length, NULL, 0, flags, userData);
+	}
+
+	// Queues a send of the specified data
+	Result QueueSend(const Target &target, const void *data, size_t length, uint64_t userData) {
+		return Queue(OPERATION_SEND, target, const_cast<void *>(data), length, NULL, 0, IPSocket::SEND_FLAGS, userData);
+	}
+
+#if !defined(SMBB_NO_SOCKET_MSG)
+	// Queues a receive of a message (the message, its buffers, and its address must remain valid until the operation completes)
+	Result QueueReceive(const Target &target, const IPSocket::Message &message, uint64_t userData, IPSocket::ReceiveFlags flags = IPSocket::RECEIVE_NORMAL) {
+		// The address is cleared, since the length of a received local address is derived from its path
+		if (message._value.msg_name)
+			memset(message._value.msg_name, 0, sizeof(IPAddress));
+
+		message.PrepareReceive();
+		return Queue(OPERATION_RECEIVE_MESSAGE, target, NULL, 0, &message._value, 0, flags, userData);
+	}
+
+	// Queues a send of a message (the message, its buffers, and its address must remain valid until the operation completes)
+	Result QueueSend(const Target &target, const IPSocket::Message &message, uint64_t userData) {
+		message._value.msg_namelen = (message._value.msg_name ? reinterpret_cast<const IPAddress *>(message._value.msg_name)->GetLength() : 0);
+		return Queue(OPERATION_SEND_MESSAGE, target, NULL, 0, &message._value, 0, IPSocket::SEND_FLAGS, userData);
+	}
+#endif
+
+	// Queues an accept of a new connection on a listening socket
+	Result QueueAccept(const Target &target, uint64_t userData) {
+		return Queue(OPERATION_ACCEPT, target, NULL, 0, NULL, 0, 0, userData);
+	}
+
+	// Queues a receive into part of a registered buffer
+	Result QueueReceiveFixed(const Target &target, uint32_t bufferIndex, size_t offset, size_t length, uint64_t userData) {
+		return Queue(OPERATION_RECEIVE_FIXED, target, reinterpret_cast<void *>(offset), length, NULL, bufferIndex, 0, userData);
+	}
+
+	// Queues a send from part of a registered buffer
+	Result QueueSendFixed(const Target &target, uint32_t bufferIndex, size_t offset, size_t length, uint64_t userData) {
+		return Queue(OPERATION_SEND_FIXED, target, reinterpret_cast<void *>(offset), length, NULL, bufferIndex, 0, userData);
+	}
+
+	// Gets the number of queued operations that have not been submitted
+	uint32_t GetQueued() const { return IsUsingRing() ? _queuedTail - _submittedTail : 0; }
+
+	// Submits all queued operations, returning the number submitted (or -1 on failure)
+	SMBB_INLINE int Submit();
+
+	// Submits all queued operations and reaps completed operations, waiting until at least the specified number have completed
+	//  Returns the number of completions (or -1 on failure). No system call is made if nothing is queued and enough operations have already completed.
+	SMBB_INLINE int Reap(Completion completions[], uint32_t maxCompletions, uint32_t waitFor = 0);
+
+	// Closes the engine (any outstanding operations are cancelled)
+	SMBB_INLINE void Close();
+};
+
+}
+#endif // SMBB_NO_SOCKET_ENGINE
+
+#endif
@@ -0,0 +1,238 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "IPSocketGroup.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/filter.h>
+
+#if !defined(SO_ATTACH_REUSEPORT_CBPF)
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#endif
+#endif
+
+// The entry point of each worker thread
+#if defined(_WIN32)
+unsigned long __stdcall smbb::IPSocketGroup::Main(void *job) {
+#else
+void *smbb::IPSocketGroup::Main(void *job) {
+#endif
+	Job &current = *static_cast<Job *>(job);
+	IPSocketGroup &group = *current.group;
+
+	group._worker(group._sockets[current.index], current.index, group._context);
+#if defined(_WIN32)
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+// Pins the worker thread of the socket at the specified index to the cores steered to the socket
+bool smbb::IPSocketGroup::Pin(uint32_t index) const {
+	const uint32_t processors = GetProcessorCount();
+
+	// There may be more sockets than cores
+	if (index >= processors)
+		return false;
+
+#if defined(_WIN32)
+	DWORD_PTR mask = 0;
+
+	for (uint32_t i = index; i < processors && i < sizeof(mask) * 8; i += _count)
+		mask |= DWORD_PTR(1) << i;
+
+	return mask != 0 && SetThreadAffinityMask(_threads[index], mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+
+	for (uint32_t i = index; i < processors && i < CPU_SETSIZE; i += _count)
+		CPU_SET(i, &set);
+
+	return CPU_COUNT(&set) != 0 && pthread_setaffinity_np(_threads[index], sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+// Attaches the CPU steering program to the group
+bool smbb::IPSocketGroup::AttachSteering() {
+#if defined(__linux__)
+	// The program returns the index of the socket for the current core (the kernel falls back to the flow hash for an out of range index)
+	sock_filter code[] = {
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) },
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, _count },
+		{ BPF_RET | BPF_A, 0, 0, 0 }
+	};
+	sock_fprog program = { static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code };
+
+	// The program is shared by the whole group, so it only needs to be attached to one socket
+	return setsockopt(_sockets[0].GetNativeHandle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == 0;
+#else
+	return false;
+#endif
+}
+
+// Gets the number of configured processors
+uint32_t smbb::IPSocketGroup::GetProcessorCount() {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return static_cast<uint32_t>(info.dwNumberOfProcessors);
+#else
+	const long count = sysconf(_SC_NPROCESSORS_CONF);
+
+	return count > 0 ? static_cast<uint32_t>(count) : 1;
+#endif
+}
+
+// Opens the specified number of sockets bound to the address (TCP sockets are also listening)
+smbb::IPSocketGroup::Result smbb::IPSocketGroup::Open(const IPAddress &address, IPProtocol protocol, uint32_t count, Steering steering) {
+	if (_count != 0)
+		return GROUP_FAILED_IN_USE;
+	else if (count == 0 || count > MAX_SOCKETS)
+		return GROUP_FAILED_BAD_SIZE;
+
+#if !defined(__linux__)
+	if (steering != STEER_BY_HASH)
+		return GROUP_FAILED_UNSUPPORTED;
+#endif
+
+	IPAddress bindAddress = address;
+
+	for (; _count < count; _count++) {
+		IPSocket &socket = _sockets[_count];
+
+		if (!socket.Open(bindAddress.GetFamily(), protocol)) {
+			Close();
+			return GROUP_FAILED_TO_OPEN;
+		}
+		else if (!socket.SetReusePort(true)) {
+			socket.Close();
+			Close();
+			return GROUP_FAILED_UNSUPPORTED;
+		}
+		else if (!socket.Bind(bindAddress) || (protocol == TCP && !socket.Listen())) {
+			socket.Close();
+			Close();
+			return GROUP_FAILED_TO_OPEN;
+		}
+
+		// Bind the remaining sockets to the port chosen for the first socket
+		if (_count == 0)
+			bindAddress = socket.GetAddress();
+	}
+
+	_steering = steering;
+
+	if (steering == STEER_BY_CPU && !AttachSteering()) {
+		Close();
+		return GROUP_FAILED_TO_STEER;
+	}
+
+	return GROUP_SUCCESS;
+}
+
+// Starts a worker thread for each socket, pinning each thread to the cores steered to its socket if requested
+smbb::IPSocketGroup::Result smbb::IPSocketGroup::Start(Worker worker, void *context, bool pin) {
+	if (_count == 0 || !worker)
+		return GROUP_FAILED_TO_START;
+
+	for (uint32_t i = 0; i < _count; i++) {
+		if (_started[i])
+			return GROUP_FAILED_IN_USE;
+	}
+
+	_worker = worker;
+	_context = context;
+
+	for (uint32_t i = 0; i < _count; i++) {
+		_jobs[i].group = this;
+		_jobs[i].index = i;
+
+#if defined(_WIN32)
+		_started[i] = (_threads[i] = CreateThread(NULL, 0, Main, &_jobs[i], CREATE_SUSPENDED, NULL)) != NULL;
+#else
+		_started[i] = pthread_create(&_threads[i], NULL, Main, &_jobs[i]) == 0;
+#endif
+		if (!_started[i]) {
+			Close();
+			return GROUP_FAILED_TO_START;
+		}
+
+		// Pinning is best effort
+		if (pin)
+			(void)Pin(i);
+
+#if defined(_WIN32)
+		(void)ResumeThread(_threads[i]);
+#endif
+	}
+
+	return GROUP_SUCCESS;
+}
+
+// Waits for all of the worker threads to return
+void smbb::IPSocketGroup::Join() {
+	for (uint32_t i = 0; i < MAX_SOCKETS; i++) {
+		if (_started[i]) {
+#if defined(_WIN32)
+			(void)WaitForSingleObject(_threads[i], INFINITE);
+			(void)CloseHandle(_threads[i]);
+#else
+			(void)pthread_join(_threads[i], NULL);
+#endif
+			_started[i] = false;
+		}
+	}
+}
+
+// Shuts down all of the sockets (waking any workers blocked on them), waits for the workers to return, and closes the sockets
+void smbb::IPSocketGroup::Close() {
+	for (uint32_t i = 0; i < _count; i++) {
+#if defined(_WIN32)
+		(void)shutdown(_sockets[i].GetNativeHandle(), SD_BOTH);
+#else
+		(void)shutdown(_sockets[i].GetNativeHandle(), SHUT_RDWR);
+#endif
+	}
+
+	Join();
+
+	for (uint32_t i = 0; i < _count; i++)
+		(void)_sockets[i].Close();
+
+	_count = 0;
+	_steering = STEER_BY_HASH;
+}
@@ -0,0 +1,142 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SMBB_IPSOCKETGROUP_H
+#define SMBB_IPSOCKETGROUP_H
+
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "IPSocket.h"
+
+namespace smbb {
+
+// A group of sockets bound to the same address using SO_REUSEPORT, so the kernel spreads connections (TCP) or datagrams (UDP) across the sockets.
+//  Each socket is serviced by its own worker thread, so accepting and receiving scale with the number of cores instead of being limited by a single socket.
+//  On Linux, a CPU steering program can be attached so that each flow is delivered to the socket (and pinned worker) on the core that handled its interrupts.
+class IPSocketGroup {
+public:
+	enum Result {
+		GROUP_SUCCESS = 0,
+		GROUP_FAILED_UNSUPPORTED,
+		GROUP_FAILED_BAD_SIZE,
+		GROUP_FAILED_IN_USE,
+		GROUP_FAILED_TO_OPEN,
+		GROUP_FAILED_TO_STEER,
+		GROUP_FAILED_TO_START
+	};
+
+	// How the kernel selects a socket for a new connection or datagram
+	enum Steering {
+		STEER_BY_HASH = 0, // Hash of the flow (the kernel default)
+		STEER_BY_CPU // The core that received the packet (socket i handles cores i, i + count, i + 2 * count, ...)
+	};
+
+	// The maximum number of sockets in a group
+	static const uint32_t MAX_SOCKETS = 64;
+
+	// The function run by each worker thread, given the socket and its index in the group
+	typedef void (*Worker)(IPSocket &socket, uint32_t index, void *context);
+
+private:
+	struct Job {
+		IPSocketGroup *group;
+		uint32_t index;
+	};
+
+#if defined(_WIN32)
+	void *_threads[MAX_SOCKETS];
+#else
+	pthread_t _threads[MAX_SOCKETS];
+#endif
+	bool _started[MAX_SOCKETS];
+	Job _jobs[MAX_SOCKETS];
+	IPSocket _sockets[MAX_SOCKETS];
+	uint32_t _count;
+	Steering _steering;
+	Worker _worker;
+	void *_context;
+
+	// Disable copying
+	IPSocketGroup(const IPSocketGroup &);
+	IPSocketGroup &operator=(const IPSocketGroup &);
+
+	// The entry point of each worker thread
+#if defined(_WIN32)
+	SMBB_INLINE static unsigned long __stdcall Main(void *job);
+#else
+	SMBB_INLINE static void *Main(void *job);
+#endif
+
+	// Pins the worker thread of the socket at the specified index to the cores steered to the socket
+	SMBB_INLINE bool Pin(uint32_t index) const;
+
+	// Attaches the CPU steering program to the group
+	SMBB_INLINE bool AttachSteering();
+
+public:
+	// Gets the number of configured processors
+	SMBB_INLINE static uint32_t GetProcessorCount();
+
+	IPSocketGroup() : _threads(), _started(), _jobs(), _sockets(), _count(), _steering(), _worker(), _context() { }
+	~IPSocketGroup() { Close(); }
+
+	// Opens the specified number of sockets (at most MAX_SOCKETS) bound to the address (TCP sockets are also listening).
+	//  If the port of the address is 0, all sockets are bound to the port chosen for the first socket.
+	SMBB_INLINE Result Open(const IPAddress &address, IPProtocol protocol, uint32_t count, Steering steering = STEER_BY_HASH);
+
+	// Returns true if the group is open
+	bool IsValid() const { return _count != 0; }
+
+	// Gets the number of sockets in the group
+	uint32_t GetCount() const { return _count; }
+
+	// Gets the socket at the specified index
+	IPSocket GetSocket(uint32_t index) const { return index < _count ? _sockets[index] : IPSocket(); }
+
+	// Gets the address shared by all sockets in the group
+	IPAddress GetAddress() const { return _count != 0 ? _sockets[0].GetAddress() : IPAddress(); }
+
+	// Gets the steering used by the group
+	Steering GetSteering() const { return _steering; }
+
+	// Starts a worker thread for each socket, pinning each thread to the cores steered to its socket if requested
+	SMBB_INLINE Result Start(Worker worker, void *context, bool pin = true);
+
+	// Waits for all of the worker threads to return
+	SMBB_INLINE void Join();
+
+	// Shuts down all of the sockets (waking any workers blocked on them), waits for the workers to return, and closes the sockets
+	SMBB_INLINE void Close();
+};
+
+}
+
+#endif
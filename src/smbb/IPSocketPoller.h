@@ -0,0 +1,155 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_IPSOCKETPOLLER_H
+#define SMBB_IPSOCKETPOLLER_H
+
+// The poller uses epoll, which is only available on Linux
+#if !defined(__linux__) && !defined(SMBB_NO_EPOLL)
+#define SMBB_NO_EPOLL
+#endif
+
+#if !defined(SMBB_NO_EPOLL)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#ifndef EPOLLRDHUP
+#define EPOLLRDHUP 0x2000
+#endif
+
+#include "utilities/IntegerTypes.h"
+
+#include "IPSocket.h"
+
+namespace smbb {
+
+// Monitors a large set of sockets, returning only the sockets that are ready.
+//  Unlike IPSocket::SelectSets and IPSocket::Poll, the sockets are registered with the kernel once, so adding, modifying, and removing a socket is O(1),
+//  and the cost of waiting depends only on the number of ready sockets (not on the number of idle sockets).
+class IPSocketPoller {
+public:
+	enum EventValue {
+		EVENT_NO_CHECK = 0,
+		EVENT_CAN_READ = EPOLLIN,
+		EVENT_CAN_ACCEPT = EPOLLIN,
+		EVENT_CAN_WRITE = EPOLLOUT,
+		EVENT_IS_CONNECTED = EPOLLOUT,
+		EVENT_DISCONNECTING = EPOLLRDHUP | EPOLLHUP, // The peer has shut down its side of the connection, continue reading until a successful read returns 0
+		EVENT_ERROR = EPOLLERR, // Always returned (even if not monitored), including for a failed connection attempt
+		EVENT_CHECK_ALL = EVENT_CAN_READ | EVENT_CAN_WRITE | EVENT_DISCONNECTING
+	};
+
+	enum TriggerMode {
+		TRIGGER_LEVEL = 0, // Events are returned for as long as the socket is ready
+		TRIGGER_EDGE = EPOLLET, // Events are only returned when the socket becomes ready (the socket must be non-blocking and drained until it would block)
+		TRIGGER_ONE_SHOT = EPOLLONESHOT // Events are returned once, after which the socket must be re-armed using Modify()
+	};
+
+	// The result of a wait for a single socket
+	class Event {
+		struct epoll_event _event;
+
+	public:
+		Event() : _event() { }
+
+		// Checks if the specified result is set after a wait
+		bool HasResult(EventValue value) const { return (_event.events & static_cast<uint32_t>(value)) != 0; }
+
+		// Gets the results after a wait
+		EventValue GetResult() const { return static_cast<EventValue>(_event.events & (EVENT_CHECK_ALL | EVENT_ERROR)); }
+
+		// Checks if the event indicates a failed connection attempt
+		bool HasFailedConnectionResult() const { return (_event.events & EVENT_ERROR) != 0; }
+
+		// Gets the user data of the socket
+		void *GetData() const { return _event.data.ptr; }
+	};
+
+private:
+	int _handle;
+
+	// Disable copying
+	IPSocketPoller(const IPSocketPoller &) { }
+	IPSocketPoller &operator=(const IPSocketPoller &) { return *this; }
+
+	// Adds, modifies, or removes a socket
+	bool Control(int operation, const IPSocket &socket, EventValue monitor, void *data, TriggerMode trigger) {
+		struct epoll_event event = epoll_event();
+
+		event.events = static_cast<uint32_t>(monitor & EVENT_CHECK_ALL) | static_cast<uint32_t>(trigger);
+		event.data.ptr = data;
+		return epoll_ctl(_handle, operation, socket.GetNativeHandle(), &event) == 0;
+	}
+
+public:
+	IPSocketPoller() : _handle(-1) { }
+	~IPSocketPoller() { Close(); }
+
+	// Creates the poller (if it is not already created), returning true if successful
+	bool Create() {
+		if (_handle == -1)
+			_handle = epoll_create1(EPOLL_CLOEXEC);
+
+		return _handle != -1;
+	}
+
+	// Returns true if the poller has been created
+	bool IsValid() const { return _handle != -1; }
+
+	// Gets the native handle of the poller (which can itself be monitored for readability)
+	int GetNativeHandle() const { return _handle; }
+
+	// Adds a socket to monitor, along with user data that is returned with each of its events (each socket can only be added once)
+	bool Add(const IPSocket &socket, EventValue monitor, void *data = NULL, TriggerMode trigger = TRIGGER_LEVEL) { return Control(EPOLL_CTL_ADD, socket, monitor, data, trigger); }
+
+	// Modifies the values to monitor and the user data of a socket (this also re-arms a one-shot socket)
+	bool Modify(const IPSocket &socket, EventValue monitor, void *data = NULL, TriggerMode trigger = TRIGGER_LEVEL) { return Control(EPOLL_CTL_MOD, socket, monitor, data, trigger); }
+
+	// Removes a socket (a socket is also removed automatically when it is closed)
+	bool Remove(const IPSocket &socket) { return Control(EPOLL_CTL_DEL, socket, EVENT_NO_CHECK, NULL, TRIGGER_LEVEL); }
+
+	// Waits for at most the specified number of ready sockets or for a timeout (-1 waits indefinitely), returning the number of events, or -1 on failure
+	//  (An interrupted wait returns 0.)
+	int Wait(Event events[], int maxEvents, int timeoutMs = -1) {
+		const int result = epoll_wait(_handle, reinterpret_cast<struct epoll_event *>(events), maxEvents, timeoutMs);
+
+		return result < 0 && errno == EINTR ? 0 : result;
+	}
+
+	// Closes the poller
+	void Close() {
+		if (_handle != -1) {
+			(void)close(_handle);
+			_handle = -1;
+		}
+	}
+};
+
+inline IPSocketPoller::EventValue operator|(IPSocketPoller::EventValue x, IPSocketPoller::EventValue y) { return static_cast<IPSocketPoller::EventValue>(static_cast<int>(x) | y); }
+inline IPSocketPoller::EventValue operator&(IPSocketPoller::EventValue x, IPSocketPoller::EventValue y) { return static_cast<IPSocketPoller::EventValue>(static_cast<int>(x) & y); }
+
+}
+#endif // SMBB_NO_EPOLL
+
+#endif
@@ -0,0 +1,180 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "IPSocketZeroCopy.h"
+
+#if !defined(SMBB_NO_ZERO_COPY)
+#include <cstring>
+
+#include <linux/errqueue.h>
+
+#if !defined(SO_EE_ORIGIN_ZEROCOPY)
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#if !defined(SO_EE_CODE_ZEROCOPY_COPIED)
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+// Tracks a buffer that was sent
+void smbb::IPSocketZeroCopy::Track(const void *data, size_t length, uint64_t userData) {
+	Pending &pending = _pending[(_head + _count) % _capacity];
+
+	pending._data = data;
+	pending._length = length;
+	pending._userData = userData;
+	pending._completed = false;
+	pending._copied = false;
+	_count++;
+}
+
+// Marks the outstanding buffers with sequence numbers in the specified range as complete, returning the number of buffers marked
+uint32_t smbb::IPSocketZeroCopy::Complete(uint32_t first, uint32_t last, bool copied) {
+	uint32_t completed = 0;
+
+	// Sequence numbers wrap, so compare the distance from the start of the range
+	for (uint32_t i = 0; i < _count; i++) {
+		Pending &pending = _pending[(_head + i) % _capacity];
+
+		if (_headSequence + i - first <= last - first && !pending._completed) {
+			pending._completed = true;
+			pending._copied = copied;
+			completed++;
+
+			if (copied)
+				_copied++;
+		}
+	}
+
+	return completed;
+}
+
+// Enables zero-copy sends on a socket, tracking up to the specified number of outstanding buffers using caller-provided storage
+smbb::IPSocketZeroCopy::Result smbb::IPSocketZeroCopy::Open(const IPSocket &socket, Pending pending[], uint32_t capacity) {
+	_pending = NULL;
+
+	if (!pending || capacity == 0)
+		return ZERO_COPY_FAILED_BAD_SIZE;
+
+	_socket = socket;
+
+	if (!_socket.SetZeroCopy(true))
+		return ZERO_COPY_FAILED_UNSUPPORTED;
+
+	_pending = pending;
+	_capacity = capacity;
+	_head = 0;
+	_count = 0;
+	_headSequence = 0;
+	_copied = 0;
+	return ZERO_COPY_SUCCESS;
+}
+
+// Sends data without copying it
+smbb::IPSocket::MessageResult smbb::IPSocketZeroCopy::Send(const void *data, IPSocket::DataLength length, uint64_t userData) {
+	if (!_pending)
+		return IPSocket::MessageResult(-1, IP_SOCKET_ERROR(NOTSOCK));
+	else if (IsFull())
+		return IPSocket::MessageResult(-1, IP_SOCKET_ERROR(NOBUFS));
+	else if (length == 0)
+		return _socket.Send(data, length);
+
+	IPSocket::MessageResult result = _socket.SendZeroCopy(data, length);
+
+	// Each successful send is assigned the next sequence number
+	if (result.GetResult() > 0)
+		Track(data, static_cast<size_t>(result.GetResult()), userData);
+
+	return result;
+}
+
+// Sends a message without copying it
+smbb::IPSocket::MessageResult smbb::IPSocketZeroCopy::Send(const IPSocket::Message &message, uint64_t userData) {
+	if (!_pending)
+		return IPSocket::MessageResult(-1, IP_SOCKET_ERROR(NOTSOCK));
+	else if (IsFull())
+		return IPSocket::MessageResult(-1, IP_SOCKET_ERROR(NOBUFS));
+
+	IPSocket::MessageResult result = _socket.SendZeroCopy(message);
+
+	if (result.GetResult() > 0)
+		Track(message.GetLength() > 0 ? message.GetBuffers()[0].GetData() : NULL, static_cast<size_t>(result.GetResult()), userData);
+
+	return result;
+}
+
+// Reads all of the available completion notifications from the socket error queue without blocking, returning the number of buffers that completed
+uint32_t smbb::IPSocketZeroCopy::ProcessCompletions() {
+	uint32_t completed = 0;
+
+	if (!_pending)
+		return 0;
+
+	for (;;) {
+		union { size_t alignment; char data[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))]; } control;
+		msghdr message;
+
+		memset(&message, 0, sizeof(message));
+		message.msg_control = control.data;
+		message.msg_controllen = sizeof(control.data);
+
+		if (recvmsg(_socket.GetNativeHandle(), &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return completed;
+		}
+
+		for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+			if ((header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_RECVERR) || (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_RECVERR)) {
+				sock_extended_err error;
+
+				memcpy(&error, CMSG_DATA(header), sizeof(error));
+
+				// The notification covers a range of sends (from ee_info to ee_data)
+				if (error.ee_errno == 0 && error.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+					completed += Complete(error.ee_info, error.ee_data, (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+			}
+		}
+	}
+}
+
+// Releases the oldest outstanding buffer if the kernel has finished with it
+smbb::IPSocketZeroCopy::Result smbb::IPSocketZeroCopy::Release(Pending &released) {
+	if (_count == 0)
+		return ZERO_COPY_EMPTY;
+
+	Pending &oldest = _pending[_head];
+
+	if (!oldest._completed)
+		return ZERO_COPY_PENDING;
+
+	released = oldest;
+	oldest = Pending();
+	_head = (_head + 1) % _capacity;
+	_headSequence++;
+	_count--;
+	return ZERO_COPY_SUCCESS;
+}
+#endif
@@ -0,0 +1,137 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SMBB_IPSOCKETZEROCOPY_H
+#define SMBB_IPSOCKETZEROCOPY_H
+
+// Zero-copy sends (MSG_ZEROCOPY) are only available on Linux
+#if (!defined(__linux__) || defined(SMBB_NO_SOCKET_MSG)) && !defined(SMBB_NO_ZERO_COPY)
+#define SMBB_NO_ZERO_COPY
+#endif
+
+#if !defined(SMBB_NO_ZERO_COPY)
+#include <cstdlib>
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "IPSocket.h"
+
+namespace smbb {
+
+// Sends data on a socket without copying it into kernel buffers (MSG_ZEROCOPY), tracking when each sent buffer can be reused.
+//  The kernel pins the pages of each buffer until the data has been transmitted (and acknowledged, for TCP), then queues a completion notification on the socket error queue.
+//  Completions are read using ProcessCompletions(), after which buffers are released in the order they were sent.
+//  Zero-copy is only worth it for large sends (roughly 10 KB and up), since pinning pages and reading completions has a fixed cost.
+//  Send timestamps share the error queue, so the socket must not also use IPSocket::ReceiveSendTimestamps() (each would discard the notifications of the other).
+class IPSocketZeroCopy {
+public:
+	enum Result {
+		ZERO_COPY_SUCCESS = 0,
+		ZERO_COPY_PENDING, // The oldest buffer is still in use by the kernel
+		ZERO_COPY_EMPTY, // No buffers are outstanding
+		ZERO_COPY_FAILED_UNSUPPORTED,
+		ZERO_COPY_FAILED_BAD_SIZE
+	};
+
+	// A buffer that has been sent, and may still be in use by the kernel
+	class Pending {
+		const void *_data;
+		size_t _length;
+		uint64_t _userData;
+		bool _completed;
+		bool _copied;
+
+	public:
+		Pending() : _data(), _length(), _userData(), _completed(), _copied() { }
+
+		// Gets the first byte of the buffer that was sent (the buffer may include unsent bytes after a partial send)
+		const void *GetData() const { return _data; }
+
+		// Gets the number of bytes that were sent
+		size_t GetLength() const { return _length; }
+
+		// Gets the user data that was provided for the send
+		uint64_t GetUserData() const { return _userData; }
+
+		// Returns true if the kernel copied the data instead of sending it in place (e.g. the device does not support it, or the data was sent on loopback)
+		bool WasCopied() const { return _copied; }
+
+		friend class IPSocketZeroCopy;
+	};
+
+private:
+	IPSocket _socket;
+	Pending *_pending;
+	uint32_t _capacity;
+	uint32_t _head;
+	uint32_t _count;
+	uint32_t _headSequence;
+	uint64_t _copied;
+
+	// Tracks a buffer that was sent
+	SMBB_INLINE void Track(const void *data, size_t length, uint64_t userData);
+
+	// Marks the outstanding buffers with sequence numbers in the specified range as complete, returning the number of buffers marked
+	SMBB_INLINE uint32_t Complete(uint32_t first, uint32_t last, bool copied);
+
+public:
+	IPSocketZeroCopy() : _socket(), _pending(), _capacity(), _head(), _count(), _headSequence(), _copied() { }
+
+	// Enables zero-copy sends on a socket (which remains owned by the caller), tracking up to the specified number of outstanding buffers using caller-provided storage.
+	//  The kernel numbers zero-copy sends from the creation of the socket, so all zero-copy sends on the socket must be made through this object.
+	SMBB_INLINE Result Open(const IPSocket &socket, Pending pending[], uint32_t capacity);
+
+	// Returns true if zero-copy sends have been enabled on a socket
+	bool IsValid() const { return _pending != NULL; }
+
+	// Gets the number of buffers that have been sent but not yet released
+	uint32_t GetOutstanding() const { return _count; }
+
+	// Returns true if no more buffers can be sent until an outstanding buffer is released
+	bool IsFull() const { return _count >= _capacity; }
+
+	// Gets the number of completions reporting that the kernel copied the data anyway (if this is common, zero-copy is only adding overhead)
+	uint64_t GetCopiedCount() const { return _copied; }
+
+	// Sends data without copying it (the data must not be modified until its buffer is released).
+	//  If too many buffers are outstanding, the send fails with a temporary send error.
+	SMBB_INLINE IPSocket::MessageResult Send(const void *data, IPSocket::DataLength length, uint64_t userData = 0);
+
+	// Sends a message without copying it (the data must not be modified until the buffer is released, which is tracked using the first buffer of the message)
+	SMBB_INLINE IPSocket::MessageResult Send(const IPSocket::Message &message, uint64_t userData = 0);
+
+	// Reads all of the available completion notifications from the socket error queue without blocking, returning the number of buffers that completed
+	//  (any other notifications on the error queue, such as send timestamps, are discarded)
+	SMBB_INLINE uint32_t ProcessCompletions();
+
+	// Releases the oldest outstanding buffer if the kernel has finished with it
+	SMBB_INLINE Result Release(Pending &released);
+};
+
+}
+
+#endif // SMBB_NO_ZERO_COPY
+
+#endif
@@ -0,0 +1,185 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "LZCodec.h"
+
+#include <cstring>
+
+// Writes a length continuation (after the 4 bits in the token), returning false if there is not enough space
+bool smbb::LZCodec::WriteLength(uint8_t *destination, size_t destinationSize, size_t &position, size_t length) {
+	for (length -= 15; length >= 255; length -= 255) {
+		if (position >= destinationSize)
+			return false;
+
+		destination[position++] = 255;
+	}
+
+	if (position >= destinationSize)
+		return false;
+
+	destination[position++] = static_cast<uint8_t>(length);
+	return true;
+}
+
+// Writes a sequence of literals, optionally followed by a match (a match length of zero writes only the literals)
+bool smbb::LZCodec::WriteSequence(uint8_t *destination, size_t destinationSize, size_t &position, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength) {
+	const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+
+	if (position >= destinationSize)
+		return false;
+
+	destination[position++] = static_cast<uint8_t>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+	if ((literalLength >= 15 && !WriteLength(destination, destinationSize, position, literalLength)) || destinationSize - position < literalLength)
+		return false;
+
+	memcpy(destination + position, literals, literalLength);
+	position += literalLength;
+
+	if (matchLength) {
+		if (destinationSize - position < 2)
+			return false;
+
+		destination[position++] = static_cast<uint8_t>(offset);
+		destination[position++] = static_cast<uint8_t>(offset >> 8);
+
+		if (matchCode >= 15 && !WriteLength(destination, destinationSize, position, matchCode))
+			return false;
+	}
+
+	return true;
+}
+
+// Compresses data, returning the compressed size (or 0 if the destination is too small)
+size_t smbb::LZCodec::Compress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize) {
+	uint32_t table[1U << HASH_BITS];
+	size_t position = 0;
+	size_t anchor = 0;
+	size_t i = 0;
+
+	if (sourceSize > 0xFFFFFFFF)
+		return 0;
+
+	memset(table, 0, sizeof(table));
+
+	while (i + MIN_MATCH <= sourceSize) {
+		const uint32_t sequence = Read32(source + i);
+		const uint32_t hash = (sequence * 2654435761U) >> (32 - HASH_BITS);
+		const size_t candidate = table[hash];
+
+		table[hash] = static_cast<uint32_t>(i);
+
+		if (candidate < i && i - candidate <= MAX_OFFSET && Read32(source + candidate) == sequence) {
+			size_t length = MIN_MATCH;
+
+			while (i + length < sourceSize && source[candidate + length] == source[i + length])
+				length++;
+
+			if (!WriteSequence(destination, destinationSize, position, source + anchor, i - anchor, i - candidate, length))
+				return 0;
+
+			i += length;
+			anchor = i;
+		}
+		else // Skip faster through data that is not compressing
+			i += 1 + ((i - anchor) >> 6);
+	}
+
+	return WriteSequence(destination, destinationSize, position, source + anchor, sourceSize - anchor, 0, 0) ? position : 0;
+}
+
+// Decompresses data, returning false if the data is corrupt or does not fit in the destination
+bool smbb::LZCodec::Decompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize, size_t &length) {
+	size_t input = 0;
+	size_t output = 0;
+
+	length = 0;
+
+	while (input < sourceSize) {
+		const uint8_t token = source[input++];
+		size_t literalLength = token >> 4;
+
+		if (literalLength == 15) {
+			uint8_t value;
+
+			do {
+				if (input >= sourceSize)
+					return false;
+
+				value = source[input++];
+				literalLength += value;
+			} while (value == 255);
+		}
+
+		if (literalLength > sourceSize - input || literalLength > destinationSize - output)
+			return false;
+
+		memcpy(destination + output, source + input, literalLength);
+		input += literalLength;
+		output += literalLength;
+
+		// The last sequence contains only literals
+		if (input == sourceSize)
+			break;
+		else if (sourceSize - input < 2)
+			return false;
+
+		const size_t offset = source[input] | (static_cast<size_t>(source[input + 1]) << 8);
+		size_t matchLength = token & 15;
+
+		input += 2;
+
+		if (offset == 0 || offset > output)
+			return false;
+
+		if (matchLength == 15) {
+			uint8_t value;
+
+			do {
+				if (input >= sourceSize)
+					return false;
+
+				value = source[input++];
+				matchLength += value;
+			} while (value == 255);
+		}
+
+		matchLength += MIN_MATCH;
+
+		if (matchLength > destinationSize - output)
+			return false;
+
+		// An overlapping match repeats the most recent bytes, so it must be copied one byte at a time
+		if (offset >= matchLength)
+			memcpy(destination + output, destination + output - offset, matchLength);
+		else {
+			for (size_t i = 0; i < matchLength; i++)
+				destination[output + i] = destination[output + i - offset];
+		}
+
+		output += matchLength;
+	}
+
+	length = output;
+	return true;
+}
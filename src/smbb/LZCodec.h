@@ -0,0 +1,71 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_LZCODEC_H
+#define SMBB_LZCODEC_H
+
+#include <cstdlib>
+#include <cstring>
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+namespace smbb {
+
+// A fast, dependency-free LZ77 block codec (using an LZ4-style sequence format).
+//  Each sequence is a token (the literal length in the upper 4 bits and the match length - 4 in the lower 4 bits), the literals,
+//  and a little-endian 16-bit match offset. Lengths of 15 or more are continued with bytes that are added to the length until a byte is not 255.
+//  The last sequence contains only literals. Decompression checks all bounds, so corrupt data is rejected rather than overrunning a buffer.
+class LZCodec {
+	static const size_t MIN_MATCH = 4;
+	static const size_t MAX_OFFSET = 65535;
+	static const uint32_t HASH_BITS = 12;
+
+	// Reads 4 bytes of data
+	static uint32_t Read32(const uint8_t *data) {
+		uint32_t value;
+
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// Writes a length continuation (after the 4 bits in the token), returning false if there is not enough space
+	static SMBB_INLINE bool WriteLength(uint8_t *destination, size_t destinationSize, size_t &position, size_t length);
+
+	// Writes a sequence of literals, optionally followed by a match (a match length of zero writes only the literals)
+	static SMBB_INLINE bool WriteSequence(uint8_t *destination, size_t destinationSize, size_t &position, const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength);
+
+public:
+	// Gets the maximum size of the compressed data for the specified size of uncompressed data
+	static size_t GetMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+	// Compresses data, returning the compressed size (or 0 if the destination is too small)
+	static SMBB_INLINE size_t Compress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize);
+
+	// Decompresses data, returning false if the data is corrupt or does not fit in the destination
+	static SMBB_INLINE bool Decompress(const uint8_t *source, size_t sourceSize, uint8_t *destination, size_t destinationSize, size_t &length);
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "ProcessOwner.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+#endif
+
+// Gets the start nonce of a process (or 0 if it is not available)
+uint32_t smbb::ProcessOwner::GetStartNonce(uint32_t processId) {
+	uint64_t startTime = 0;
+
+#if defined(_WIN32)
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(processId));
+	FILETIME creation, exit, kernel, user;
+
+	if (!process)
+		return 0;
+
+	if (GetProcessTimes(process, &creation, &exit, &kernel, &user))
+		startTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+
+	(void)CloseHandle(process);
+#elif defined(__linux__)
+	// The start time (in clock ticks since boot) is the 22nd field of /proc/<pid>/stat, after the parenthesized command name
+	char path[64];
+	char stat[1024];
+
+	(void)snprintf(path, sizeof(path), "/proc/%u/stat", processId);
+
+	int handle = open(path, O_RDONLY);
+
+	if (handle < 0)
+		return 0;
+
+	ssize_t length = read(handle, stat, sizeof(stat) - 1);
+	(void)close(handle);
+
+	if (length <= 0)
+		return 0;
+
+	stat[length] = '\0';
+
+	const char *field = strrchr(stat, ')');
+
+	// A zombie process has exited, even though it has not been reaped yet
+	if (!field || field[1] != ' ' || field[2] == 'Z' || field[2] == 'X')
+		return 0;
+
+	for (int i = 2; field && i < 22; i++)
+		field = strchr(field + 1, ' ');
+
+	if (!field)
+		return 0;
+
+	while (*++field >= '0' && *field <= '9')
+		startTime = startTime * 10 + static_cast<uint64_t>(*field - '0');
+#else
+	(void)processId;
+#endif
+
+	// Fold the start time into 32 bits, never returning 0 for a known start time
+	const uint32_t nonce = static_cast<uint32_t>(startTime ^ (startTime >> 32));
+	return startTime == 0 ? 0 : nonce == 0 ? 1 : nonce;
+}
+
+// Gets the owner value of the current process
+smbb::ProcessOwner::Owner smbb::ProcessOwner::GetCurrent() {
+	static Owner current = 0;
+
+	if (current == 0) {
+#if defined(_WIN32)
+		const uint32_t processId = static_cast<uint32_t>(GetCurrentProcessId());
+#else
+		const uint32_t processId = static_cast<uint32_t>(getpid());
+#endif
+		current = (static_cast<Owner>(GetStartNonce(processId)) << 32) | processId;
+	}
+#if !defined(_WIN32)
+	// A forked child has a new process ID
+	else if (GetProcessId(current) != static_cast<uint32_t>(getpid())) {
+		current = 0;
+		return GetCurrent();
+	}
+#endif
+
+	return current;
+}
+
+// Checks if the owning process is still running (an owner without a start nonce is only checked by process ID)
+bool smbb::ProcessOwner::IsAlive(Owner owner) {
+	const uint32_t processId = GetProcessId(owner);
+	const uint32_t nonce = static_cast<uint32_t>(owner >> 32);
+
+	if (processId == 0)
+		return false;
+
+#if defined(_WIN32)
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(processId));
+
+	if (!process)
+		return GetLastError() == ERROR_ACCESS_DENIED;
+
+	const bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+
+	(void)CloseHandle(process);
+
+	if (!running)
+		return false;
+#else
+	if (kill(static_cast<pid_t>(processId), 0) != 0 && errno != EPERM)
+		return false;
+#endif
+
+	return nonce == 0 || GetStartNonce(processId) == nonce;
+}
@@ -0,0 +1,54 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_PROCESSOWNER_H
+#define SMBB_PROCESSOWNER_H
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+namespace smbb {
+
+// Identifies a process for ownership of shared memory structures.
+//  An owner combines the process ID (in the lower 32 bits) with a nonce derived from the process start time (in the upper 32 bits),
+//  so an owner is not mistaken for a new process that reuses the same process ID. A value of zero is never a valid owner.
+class ProcessOwner {
+	// Gets the start nonce of a process (or 0 if it is not available)
+	static SMBB_INLINE uint32_t GetStartNonce(uint32_t processId);
+
+public:
+	typedef uint64_t Owner;
+
+	// Gets the owner value of the current process
+	static SMBB_INLINE Owner GetCurrent();
+
+	// Gets the process ID of an owner
+	static uint32_t GetProcessId(Owner owner) { return static_cast<uint32_t>(owner); }
+
+	// Checks if the owning process is still running (an owner without a start nonce is only checked by process ID)
+	static SMBB_INLINE bool IsAlive(Owner owner);
+};
+
+}
+
+#endif
@@ -26,14 +26,51 @@ SOFTWARE.
 
 #include "IPAddress.h"
 #include "IPSocket.h"
+#include "IPSocketEngine.h"
+#include "IPSocketGroup.h"
+#include "IPSocketPoller.h"
+#include "IPSocketZeroCopy.h"
+#include "LZCodec.h"
+#include "ProcessOwner.h"
+#include "SharedHistogram.h"
 #include "SharedMemory.h"
+#include "SharedMemoryBus.h"
+#include "SharedMemoryChannel.h"
+#include "SharedMemoryCheckpoint.h"
+#include "SharedMemoryDirectory.h"
+#include "SharedMemoryMappingPool.h"
+#include "SharedMemoryMulticast.h"
+#include "SharedMemoryReplicator.h"
+#include "SharedMemoryRing.h"
 #include "SharedMemorySection.h"
+#include "SharedMemoryStream.h"
+#include "SharedMetrics.h"
+#include "SharedObjectPool.h"
 #include "Version.h"
+#include "WaitStrategy.h"
 
 #if defined(SMBB_HEADER_ONLY)
 #include "IPAddress.cxx"
 #include "IPSocket.cxx"
+#include "IPSocketEngine.cxx"
+#include "IPSocketGroup.cxx"
+#include "IPSocketZeroCopy.cxx"
+#include "LZCodec.cxx"
+#include "ProcessOwner.cxx"
+#include "SharedHistogram.cxx"
 #include "SharedMemory.cxx"
+#include "SharedMemoryBus.cxx"
+#include "SharedMemoryChannel.cxx"
+#include "SharedMemoryCheckpoint.cxx"
+#include "SharedMemoryDirectory.cxx"
+#include "SharedMemoryMappingPool.cxx"
+#include "SharedMemoryMulticast.cxx"
+#include "SharedMemoryReplicator.cxx"
+#include "SharedMemoryRing.cxx"
+#include "SharedMemoryStream.cxx"
+#include "SharedMetrics.cxx"
+#include "SharedObjectPool.cxx"
+#include "WaitStrategy.cxx"
 #endif
 
 #endif
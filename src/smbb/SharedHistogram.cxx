@@ -0,0 +1,178 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedHistogram.h"
+
+#include <cstring>
+
+// Attaches to an initialized histogram
+void smbb::SharedHistogram::Attach(uint8_t *data, bool readOnly) {
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	_data = data;
+	_buckets = reinterpret_cast<Atomic<uint64_t> *>(data + sizeof(Header));
+	_precision = header->precision;
+	_bucketCount = header->bucketCount;
+	_readOnly = readOnly;
+}
+
+// Creates a new histogram in the specified memory (which should be cache-line aligned), overwriting any existing content
+smbb::SharedHistogram::Result smbb::SharedHistogram::Create(uint8_t *data, size_t size, uint32_t precision) {
+	_data = NULL;
+	_buckets = NULL;
+
+	if (!data || precision < MIN_PRECISION || precision > MAX_PRECISION || size < GetRequiredSize(precision))
+		return HISTOGRAM_FAILED_BAD_SIZE;
+
+	Header *header = reinterpret_cast<Header *>(data);
+
+	memset(data, 0, GetRequiredSize(precision));
+	header->version = VERSION;
+	header->precision = precision;
+	header->bucketCount = GetBucketCount(precision);
+
+	// Publish the histogram last, so that it is never seen partially initialized
+	header->magic.Store(MAGIC, MEMORY_ORDER_RELEASE);
+
+	Attach(data, false);
+	return HISTOGRAM_SUCCESS;
+}
+
+// Opens an existing histogram in the specified memory
+smbb::SharedHistogram::Result smbb::SharedHistogram::Open(uint8_t *data, size_t size, bool readOnly) {
+	_data = NULL;
+	_buckets = NULL;
+
+	if (!data || size < sizeof(Header))
+		return HISTOGRAM_FAILED_BAD_MEMORY;
+
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	if (header->magic.Load(MEMORY_ORDER_ACQUIRE) != MAGIC || header->version != VERSION || header->precision < MIN_PRECISION || header->precision > MAX_PRECISION ||
+			header->bucketCount != GetBucketCount(header->precision) || size < GetRequiredSize(header->precision))
+		return HISTOGRAM_FAILED_BAD_MEMORY;
+
+	Attach(data, readOnly);
+	return HISTOGRAM_SUCCESS;
+}
+
+// Gets the total number of recorded values
+uint64_t smbb::SharedHistogram::GetTotalCount() const {
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < _bucketCount; i++)
+		total += _buckets[i].Load(MEMORY_ORDER_RELAXED);
+
+	return total;
+}
+
+// Gets the (highest equivalent) value at the specified percentile (0 - 100)
+uint64_t smbb::SharedHistogram::GetValueAtPercentile(double percentile) const {
+	const uint64_t total = GetTotalCount();
+
+	if (total == 0)
+		return 0;
+
+	percentile = percentile < 0.0 ? 0.0 : percentile > 100.0 ? 100.0 : percentile;
+
+	uint64_t target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+	uint64_t cumulative = 0;
+	uint32_t last = 0;
+
+	if (target == 0)
+		target = 1;
+
+	for (uint32_t i = 0; i < _bucketCount; i++) {
+		const uint64_t count = _buckets[i].Load(MEMORY_ORDER_RELAXED);
+
+		if (count != 0) {
+			cumulative += count;
+			last = i;
+
+			if (cumulative >= target)
+				break;
+		}
+	}
+
+	return GetBucketHighestValue(last);
+}
+
+// Gets the lowest recorded value (to the precision of the histogram)
+uint64_t smbb::SharedHistogram::GetMin() const {
+	for (uint32_t i = 0; i < _bucketCount; i++) {
+		if (_buckets[i].Load(MEMORY_ORDER_RELAXED) != 0)
+			return GetBucketLowestValue(i);
+	}
+
+	return 0;
+}
+
+// Gets the approximate mean of the recorded values (using the middle of each bucket)
+double smbb::SharedHistogram::GetMean() const {
+	double sum = 0.0;
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < _bucketCount; i++) {
+		const uint64_t count = _buckets[i].Load(MEMORY_ORDER_RELAXED);
+
+		if (count != 0) {
+			sum += (static_cast<double>(GetBucketLowestValue(i)) + static_cast<double>(GetBucketHighestValue(i))) / 2.0 * static_cast<double>(count);
+			total += count;
+		}
+	}
+
+	return total != 0 ? sum / static_cast<double>(total) : 0.0;
+}
+
+// Adds the counts of this histogram to another histogram of the same precision, atomically resetting the counts of this histogram if requested
+smbb::SharedHistogram::Result smbb::SharedHistogram::Snapshot(SharedHistogram &destination, bool reset) {
+	if (!_data || !destination._data)
+		return HISTOGRAM_FAILED_BAD_MEMORY;
+	else if (destination._precision != _precision)
+		return HISTOGRAM_FAILED_MISMATCH;
+	else if (destination._readOnly || (reset && _readOnly))
+		return HISTOGRAM_FAILED_READ_ONLY;
+
+	// Each bucket is exchanged individually, so no recorded value is ever lost or counted twice
+	for (uint32_t i = 0; i < _bucketCount; i++) {
+		const uint64_t count = reset ? _buckets[i].Exchange(0, MEMORY_ORDER_RELAXED) : _buckets[i].Load(MEMORY_ORDER_RELAXED);
+
+		if (count != 0)
+			(void)destination._buckets[i].FetchAdd(count, MEMORY_ORDER_RELAXED);
+	}
+
+	return HISTOGRAM_SUCCESS;
+}
+
+// Resets all of the counts of the histogram
+smbb::SharedHistogram::Result smbb::SharedHistogram::Reset() {
+	if (!_data)
+		return HISTOGRAM_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return HISTOGRAM_FAILED_READ_ONLY;
+
+	for (uint32_t i = 0; i < _bucketCount; i++)
+		_buckets[i].Store(0, MEMORY_ORDER_RELAXED);
+
+	return HISTOGRAM_SUCCESS;
+}
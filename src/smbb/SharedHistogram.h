@@ -0,0 +1,197 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDHISTOGRAM_H
+#define SMBB_SHAREDHISTOGRAM_H
+
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// A log-linear (HDR-style) histogram of unsigned 64-bit values (e.g. latencies in nanoseconds) stored in shared memory.
+//  Values below 2^precision are counted exactly, and larger values are counted in buckets with a relative width of at most 2^(1 - precision).
+//  Recording is a single relaxed atomic increment, and an observer can snapshot (and optionally reset) the histogram into another histogram to query it.
+class SharedHistogram {
+public:
+	enum Result {
+		HISTOGRAM_SUCCESS = 0,
+		HISTOGRAM_FAILED_BAD_MEMORY,
+		HISTOGRAM_FAILED_BAD_SIZE,
+		HISTOGRAM_FAILED_MISMATCH,
+		HISTOGRAM_FAILED_READ_ONLY
+	};
+
+	// The range of supported precisions (the number of significant bits of each bucket)
+	static const uint32_t MIN_PRECISION = 1;
+	static const uint32_t MAX_PRECISION = 16;
+
+	// The default precision (a relative bucket width of at most 1/16)
+	static const uint32_t DEFAULT_PRECISION = 5;
+
+private:
+	static const uint32_t MAGIC = 0x534D4248; // "SMBH"
+	static const uint32_t VERSION = 1;
+
+	// The layout of the histogram header in shared memory (one cache line)
+	struct Header {
+		Atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t precision;
+		uint32_t bucketCount;
+		uint32_t reserved[12];
+	};
+
+	uint8_t *_data;
+	Atomic<uint64_t> *_buckets;
+	uint32_t _precision;
+	uint32_t _bucketCount;
+	bool _readOnly;
+
+	// Gets the index of the highest set bit of a non-zero value
+	static uint32_t GetHighestBit(uint64_t value) {
+#if defined(__GNUC__)
+		return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#elif defined(_MSC_VER) && defined(_WIN64)
+		unsigned long index;
+
+		(void)_BitScanReverse64(&index, value);
+		return static_cast<uint32_t>(index);
+#else
+		uint32_t index = 0;
+
+		while (value >>= 1)
+			index++;
+
+		return index;
+#endif
+	}
+
+	// Attaches to an initialized histogram
+	SMBB_INLINE void Attach(uint8_t *data, bool readOnly);
+
+public:
+	// Gets the number of buckets for the specified precision
+	static uint32_t GetBucketCount(uint32_t precision) { return (1U << precision) + (64 - precision) * (1U << (precision - 1)); }
+
+	// Gets the size required for a histogram with the specified precision
+	static size_t GetRequiredSize(uint32_t precision = DEFAULT_PRECISION) { return sizeof(Header) + sizeof(uint64_t) * GetBucketCount(precision); }
+
+	SharedHistogram() : _data(), _buckets(), _precision(), _bucketCount(), _readOnly() { }
+
+	// Creates a new histogram in the specified memory (which should be cache-line aligned), overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t precision = DEFAULT_PRECISION);
+
+	// Creates a new histogram at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t precision = DEFAULT_PRECISION) {
+		return section.ReadOnly() ? HISTOGRAM_FAILED_READ_ONLY : Create(section.Data(), section.Size(), precision);
+	}
+
+	// Opens an existing histogram in the specified memory (a snapshot can not be reset through a read-only histogram)
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing histogram at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the histogram has been created or opened
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the precision of the histogram
+	uint32_t GetPrecision() const { return _precision; }
+
+	// Gets the bucket index of a value
+	uint32_t GetBucketIndex(uint64_t value) const {
+		const uint64_t linear = uint64_t(1) << _precision;
+
+		if (value < linear)
+			return static_cast<uint32_t>(value);
+
+		const uint32_t shift = GetHighestBit(value) - _precision + 1;
+		const uint32_t half = 1U << (_precision - 1);
+
+		return static_cast<uint32_t>(linear) + (shift - 1) * half + static_cast<uint32_t>(value >> shift) - half;
+	}
+
+	// Gets the lowest value counted by a bucket
+	uint64_t GetBucketLowestValue(uint32_t index) const {
+		const uint32_t linear = 1U << _precision;
+
+		if (index < linear)
+			return index;
+
+		const uint32_t half = 1U << (_precision - 1);
+		const uint32_t shift = (index - linear) / half + 1;
+
+		return static_cast<uint64_t>(half + (index - linear) % half) << shift;
+	}
+
+	// Gets the highest value counted by a bucket
+	uint64_t GetBucketHighestValue(uint32_t index) const {
+		const uint32_t linear = 1U << _precision;
+
+		return index < linear ? index : GetBucketLowestValue(index) + ((uint64_t(1) << ((index - linear) / (1U << (_precision - 1)) + 1)) - 1);
+	}
+
+	// Records a value (ignored if the histogram is read-only)
+	void Record(uint64_t value, uint64_t count = 1) {
+		if (!_readOnly && _buckets)
+			(void)_buckets[GetBucketIndex(value)].FetchAdd(count, MEMORY_ORDER_RELAXED);
+	}
+
+	// Gets the count of the bucket at the specified index
+	uint64_t GetCountAt(uint32_t index) const { return index < _bucketCount ? _buckets[index].Load(MEMORY_ORDER_RELAXED) : 0; }
+
+	// Gets the total number of recorded values
+	SMBB_INLINE uint64_t GetTotalCount() const;
+
+	// Gets the (highest equivalent) value at the specified percentile (0 - 100)
+	SMBB_INLINE uint64_t GetValueAtPercentile(double percentile) const;
+
+	// Gets the lowest and highest recorded values (to the precision of the histogram)
+	SMBB_INLINE uint64_t GetMin() const;
+	uint64_t GetMax() const { return GetValueAtPercentile(100.0); }
+
+	// Gets the approximate mean of the recorded values (using the middle of each bucket)
+	SMBB_INLINE double GetMean() const;
+
+	// Adds the counts of this histogram to another histogram of the same precision, atomically resetting the counts of this histogram if requested
+	SMBB_INLINE Result Snapshot(SharedHistogram &destination, bool reset = false);
+
+	// Resets all of the counts of the histogram
+	SMBB_INLINE Result Reset();
+};
+
+}
+
+#endif
@@ -26,6 +26,13 @@ SOFTWARE.
 #include <cstdlib>
 #include <cstring>
 
+// Gets a new identifier for opened shared memory
+uint64_t smbb::SharedMemory::GetNextId() {
+	static Atomic<uint64_t> lastId(0);
+
+	return lastId.FetchAdd(1, MEMORY_ORDER_RELAXED) + 1;
+}
+
 #if !defined(SMBB_NO_SHARED_MEMORY)
 #if defined(_WIN32)
 #include <sys/types.h>
@@ -34,6 +41,32 @@ SOFTWARE.
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+
+// Sealing definitions (in case the C library is older than the kernel)
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#endif
+
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#define F_SEAL_WRITE 0x0008
+#endif
+#endif
 #endif
 #endif
 
@@ -95,6 +128,7 @@ smbb::SharedMemory::LoadResult smbb::SharedMemory::Load(const char *name, const
 		_mapHandle = OpenFileMapping(FILE_MAP_READ | (readOnly ? 0 : FILE_MAP_WRITE), FALSE, name);
 
 	_readOnly = readOnly;
+	_id = GetNextId();
 	return LOAD_SUCCESS;
 }
 
@@ -109,6 +143,43 @@ void smbb::SharedMemory::Close() {
 		(void)CloseHandle(_handle);
 		_handle = INVALID_HANDLE_VALUE;
 	}
+
+	_id = 0;
+}
+
+// Creates new anonymous shared memory (Linux only)
+smbb::SharedMemory::LoadResult smbb::SharedMemory::CreateAnonymous(const char *, Size, bool) {
+	return LOAD_FAILED_UNSUPPORTED;
+}
+
+// Opens shared memory from a descriptor
+smbb::SharedMemory::LoadResult smbb::SharedMemory::OpenDescriptor(int, bool) {
+	return LOAD_FAILED_UNSUPPORTED;
+}
+
+// Gets the descriptor of the shared memory
+int smbb::SharedMemory::GetDescriptor() const {
+	return -1;
+}
+
+// Gets the current size of the shared memory (only file-backed memory has a queryable size)
+smbb::SharedMemory::Size smbb::SharedMemory::GetSize() const {
+	LARGE_INTEGER size;
+
+	if (_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(_handle, &size))
+		return -1;
+
+	return size.QuadPart;
+}
+
+// Adds seals to anonymous shared memory
+bool smbb::SharedMemory::AddSeals(int) {
+	return false;
+}
+
+// Gets the seals of the shared memory
+int smbb::SharedMemory::GetSeals() const {
+	return 0;
 }
 #else
 static bool CopyFilename(char *newFilename, size_t newNameSize, const char *filename) {
@@ -208,6 +279,7 @@ smbb::SharedMemory::LoadResult smbb::SharedMemory::Load(const char *name, const
 	}
 
 	_readOnly = readOnly;
+	_id = GetNextId();
 	return LOAD_SUCCESS;
 }
 
@@ -226,6 +298,127 @@ void smbb::SharedMemory::Close() {
 		(void)close(_handle);
 		_handle = -1;
 	}
+
+	_id = 0;
+}
+
+// Creates new anonymous shared memory (Linux only)
+smbb::SharedMemory::LoadResult smbb::SharedMemory::CreateAnonymous(const char *name, Size size, bool allowSealing) {
+	Close();
+
+	if (size <= 0)
+		return LOAD_FAILED_BAD_SIZE;
+	else if (!name)
+		return LOAD_FAILED_BAD_NAME;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+	// The system call is used directly, since the C library wrapper is relatively recent
+	_handle = static_cast<int>(syscall(SYS_memfd_create, name, MFD_CLOEXEC | (allowSealing ? MFD_ALLOW_SEALING : 0)));
+
+	if (_handle == -1)
+		return LOAD_FAILED_TO_OPEN_FILE;
+	else if (ftruncate(_handle, size) == -1) { //< Resize (zeroizes memory)
+		Close();
+		return LOAD_FAILED_TO_RESIZE_FILE;
+	}
+
+	_usingFile = false;
+	_readOnly = false;
+	_id = GetNextId();
+	return LOAD_SUCCESS;
+#else
+	(void)allowSealing;
+	return LOAD_FAILED_UNSUPPORTED;
+#endif
+}
+
+// Opens shared memory from a descriptor, duplicating the descriptor so the caller still owns it
+smbb::SharedMemory::LoadResult smbb::SharedMemory::OpenDescriptor(int descriptor, bool readOnly) {
+	Close();
+
+	if (descriptor < 0)
+		return LOAD_FAILED_BAD_NAME;
+
+	_handle = fcntl(descriptor, F_DUPFD_CLOEXEC, 0);
+
+	if (_handle == -1)
+		return LOAD_FAILED_TO_OPEN_FILE;
+
+	// Write-sealed memory can only be mapped read-only
+	_usingFile = false;
+	_readOnly = readOnly || (GetSeals() & SEAL_WRITE) != 0;
+	_id = GetNextId();
+	return LOAD_SUCCESS;
+}
+
+// Gets the descriptor of the shared memory
+int smbb::SharedMemory::GetDescriptor() const {
+	return _handle;
+}
+
+// Gets the current size of the shared memory
+smbb::SharedMemory::Size smbb::SharedMemory::GetSize() const {
+	struct stat status;
+
+	if (_handle == -1 || fstat(_handle, &status) == -1)
+		return -1;
+
+	return status.st_size;
+}
+
+// Adds seals to anonymous shared memory
+bool smbb::SharedMemory::AddSeals(int seals) {
+#if defined(__linux__)
+	int linuxSeals = 0;
+
+	if (_handle == -1 || (seals & ~SEAL_IMMUTABLE) != 0)
+		return false;
+
+	if (seals & SEAL_SHRINK)
+		linuxSeals |= F_SEAL_SHRINK;
+	if (seals & SEAL_GROW)
+		linuxSeals |= F_SEAL_GROW;
+	if (seals & SEAL_WRITE)
+		linuxSeals |= F_SEAL_WRITE;
+	if (seals & SEAL_SEAL)
+		linuxSeals |= F_SEAL_SEAL;
+
+	if (fcntl(_handle, F_ADD_SEALS, linuxSeals) == -1)
+		return false;
+
+	// Any further sections must be mapped read-only
+	if (seals & SEAL_WRITE)
+		_readOnly = true;
+
+	return true;
+#else
+	(void)seals;
+	return false;
+#endif
+}
+
+// Gets the seals of the shared memory
+int smbb::SharedMemory::GetSeals() const {
+#if defined(__linux__)
+	const int linuxSeals = _handle == -1 ? -1 : fcntl(_handle, F_GET_SEALS);
+	int seals = 0;
+
+	if (linuxSeals == -1)
+		return 0;
+
+	if (linuxSeals & F_SEAL_SHRINK)
+		seals |= SEAL_SHRINK;
+	if (linuxSeals & F_SEAL_GROW)
+		seals |= SEAL_GROW;
+	if (linuxSeals & F_SEAL_WRITE)
+		seals |= SEAL_WRITE;
+	if (linuxSeals & F_SEAL_SEAL)
+		seals |= SEAL_SEAL;
+
+	return seals;
+#else
+	return 0;
+#endif
 }
 #endif
 #else // SMBB_NO_SHARED_MEMORY
@@ -252,4 +445,34 @@ smbb::SharedMemory::LoadResult smbb::SharedMemory::Load(const char *, const char
 // Closes the shared memory, so that it can no longer be mapped (existing mappings will continue to operate properly)
 void smbb::SharedMemory::Close() {
 }
+
+// Creates new anonymous shared memory (Linux only)
+smbb::SharedMemory::LoadResult smbb::SharedMemory::CreateAnonymous(const char *, Size, bool) {
+	return LOAD_FAILED_UNSUPPORTED;
+}
+
+// Opens shared memory from a descriptor
+smbb::SharedMemory::LoadResult smbb::SharedMemory::OpenDescriptor(int, bool) {
+	return LOAD_FAILED_UNSUPPORTED;
+}
+
+// Gets the descriptor of the shared memory
+int smbb::SharedMemory::GetDescriptor() const {
+	return -1;
+}
+
+// Gets the current size of the shared memory
+smbb::SharedMemory::Size smbb::SharedMemory::GetSize() const {
+	return -1;
+}
+
+// Adds seals to anonymous shared memory
+bool smbb::SharedMemory::AddSeals(int) {
+	return false;
+}
+
+// Gets the seals of the shared memory
+int smbb::SharedMemory::GetSeals() const {
+	return 0;
+}
 #endif
@@ -33,7 +33,9 @@ SOFTWARE.
 #include <unistd.h>
 #endif
 
+#include "utilities/Atomic.h"
 #include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
 
 #ifndef MAX_SHARED_MEMORY_FILENAME_SIZE
 #define MAX_SHARED_MEMORY_FILENAME_SIZE 1024U
@@ -62,6 +64,15 @@ public:
 		LOAD_FAILED_TO_RESIZE_FILE
 	};
 
+	// The seals that can be applied to anonymous shared memory (see CreateAnonymous())
+	enum Seal {
+		SEAL_SHRINK = 1, // The size can not be reduced
+		SEAL_GROW = 2, // The size can not be increased
+		SEAL_WRITE = 4, // The content can not be modified (requires that no writable mapping exists)
+		SEAL_SEAL = 8, // No further seals can be added
+		SEAL_IMMUTABLE = SEAL_SHRINK | SEAL_GROW | SEAL_WRITE | SEAL_SEAL
+	};
+
 private:
 #if defined(_WIN32)
 	typedef HANDLE Handle;
@@ -75,6 +86,10 @@ private:
 	int _handle;
 	char _name[MAX_SHARED_MEMORY_FILENAME_SIZE];
 #endif
+	uint64_t _id;
+
+	// Gets a new identifier for opened shared memory
+	static SMBB_INLINE uint64_t GetNextId();
 
 	// Disable copying
 	SharedMemory(const SharedMemory &) { }
@@ -94,9 +109,9 @@ public:
 	static SMBB_INLINE bool DeleteNamed(const char *);
 
 #if defined(_WIN32)
-	SharedMemory() : _handle(INVALID_HANDLE_VALUE), _mapHandle(), _readOnly() { }
+	SharedMemory() : _handle(INVALID_HANDLE_VALUE), _mapHandle(), _readOnly(), _id() { }
 #else
-	SharedMemory() : _readOnly(), _usingFile(), _handle(-1) { _name[0] = (char)0; }
+	SharedMemory() : _readOnly(), _usingFile(), _handle(-1), _id() { _name[0] = (char)0; }
 #endif
 
 	~SharedMemory() { Close(); }
@@ -121,6 +136,35 @@ public:
 		return Load(name, NULL, readOnly);
 	}
 
+	// Creates new anonymous shared memory, which has no name to collide with or leak and can only be shared by passing its descriptor (Linux only)
+	//  The name is only used for debugging (e.g. /proc/<pid>/maps), and the memory can be sealed to guarantee its size and content to readers.
+	SMBB_INLINE LoadResult CreateAnonymous(const char *name, Size size, bool allowSealing = true);
+
+	// Opens shared memory from a descriptor (e.g. one received from another process), duplicating the descriptor so the caller still owns it
+	SMBB_INLINE LoadResult OpenDescriptor(int descriptor, bool readOnly = true);
+
+	// Gets the descriptor of the shared memory (or -1 if it is not open or not supported), e.g. to pass it to another process
+	SMBB_INLINE int GetDescriptor() const;
+
+	// Gets an identifier that is unique to each time shared memory is opened within the process (or 0 if it is not open)
+	uint64_t GetId() const { return _id; }
+
+	// Returns true if the shared memory can only be mapped read-only
+	bool ReadOnly() const { return _readOnly; }
+
+	// Gets the current size of the shared memory (or -1 on failure)
+	SMBB_INLINE Size GetSize() const;
+
+	// Adds seals to anonymous shared memory, returning true on success.
+	//  Adding SEAL_WRITE fails while any writable mapping exists, and once it is added the memory can only be mapped read-only.
+	SMBB_INLINE bool AddSeals(int seals);
+
+	// Gets the seals of the shared memory (0 if it is not sealed or sealing is not supported)
+	SMBB_INLINE int GetSeals() const;
+
+	// Returns true if the size and content of the shared memory can never change, so readers need not copy it or recheck its bounds
+	bool IsImmutable() const { return (GetSeals() & (SEAL_SHRINK | SEAL_GROW | SEAL_WRITE)) == (SEAL_SHRINK | SEAL_GROW | SEAL_WRITE); }
+
 	// Closes the shared memory, so that it can no longer be mapped (existing mappings will continue to operate properly)
 	SMBB_INLINE void Close();
 };
@@ -0,0 +1,165 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryBus.h"
+
+// Gets the ring of a topic, attaching to it if it was added by another process
+smbb::SharedMemoryRing *smbb::SharedMemoryBus::GetRing(uint32_t topic) {
+	if (topic >= MAX_TOPICS)
+		return NULL;
+
+	SharedMemoryRing &ring = _rings[topic];
+
+	if (!ring.Valid()) {
+		SharedMemoryDirectory::Region region;
+
+		// The ring may not be initialized yet if another process is still adding the topic
+		if (_directory.Get(topic, region) != SharedMemoryDirectory::DIRECTORY_SUCCESS ||
+				ring.Open(region.Data(), region.Size(), _directory.ReadOnly()) != SharedMemoryRing::RING_SUCCESS)
+			return NULL;
+	}
+
+	return &ring;
+}
+
+// Creates a new bus in the specified memory, overwriting any existing content
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::Create(uint8_t *data, size_t size, uint32_t maxTopics) {
+	for (uint32_t i = 0; i < MAX_TOPICS; i++)
+		_rings[i] = SharedMemoryRing();
+
+	if (maxTopics > MAX_TOPICS)
+		return BUS_FAILED_BAD_SIZE;
+
+	return _directory.Create(data, size, maxTopics) == SharedMemoryDirectory::DIRECTORY_SUCCESS ? BUS_SUCCESS : BUS_FAILED_BAD_SIZE;
+}
+
+// Opens an existing bus in the specified memory
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::Open(uint8_t *data, size_t size, bool readOnly) {
+	for (uint32_t i = 0; i < MAX_TOPICS; i++)
+		_rings[i] = SharedMemoryRing();
+
+	return _directory.Open(data, size, readOnly) == SharedMemoryDirectory::DIRECTORY_SUCCESS ? BUS_SUCCESS : BUS_FAILED_BAD_MEMORY;
+}
+
+// Adds a new topic with the specified slot size (a multiple of SharedMemoryRing::SLOT_ALIGNMENT) and slot count (a power of 2)
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::AddTopic(const char *name, uint32_t slotSize, uint32_t slotCount, uint32_t &topic) {
+	SharedMemoryDirectory::Region region;
+
+	if (slotSize == 0 || slotSize % SharedMemoryRing::SLOT_ALIGNMENT != 0 || slotCount == 0 || (slotCount & (slotCount - 1)) != 0)
+		return BUS_FAILED_BAD_SIZE;
+
+	switch (_directory.Allocate(name, GetTopicSize(slotSize, slotCount), region)) {
+	case SharedMemoryDirectory::DIRECTORY_SUCCESS:
+		topic = region.Index();
+		return _rings[topic].Create(region.Data(), region.Size(), slotSize, slotCount) == SharedMemoryRing::RING_SUCCESS ? BUS_SUCCESS : BUS_FAILED_BAD_SIZE;
+
+	case SharedMemoryDirectory::DIRECTORY_ALREADY_EXISTS: {
+		const SharedMemoryRing *ring = GetRing(region.Index());
+
+		// A ring that another process is still initializing can only be checked by its size
+		if (ring ? ring->GetSlotSize() != slotSize || ring->GetSlotCount() != slotCount : region.Size() != GetTopicSize(slotSize, slotCount))
+			return BUS_FAILED_MISMATCH;
+
+		topic = region.Index();
+		return BUS_ALREADY_EXISTS;
+	}
+	case SharedMemoryDirectory::DIRECTORY_FAILED_BAD_NAME: return BUS_FAILED_BAD_NAME;
+	case SharedMemoryDirectory::DIRECTORY_FAILED_READ_ONLY: return BUS_FAILED_READ_ONLY;
+	case SharedMemoryDirectory::DIRECTORY_FAILED_FULL: return BUS_FAILED_FULL;
+	case SharedMemoryDirectory::DIRECTORY_FAILED_OUT_OF_SPACE: return BUS_FAILED_BAD_SIZE;
+	default: return BUS_FAILED_BAD_MEMORY;
+	}
+}
+
+// Finds an existing topic
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::FindTopic(const char *name, uint32_t &topic) {
+	SharedMemoryDirectory::Region region;
+
+	switch (_directory.Find(name, region)) {
+	case SharedMemoryDirectory::DIRECTORY_SUCCESS: topic = region.Index(); return BUS_SUCCESS;
+	case SharedMemoryDirectory::DIRECTORY_FAILED_BAD_NAME: return BUS_FAILED_BAD_NAME;
+	case SharedMemoryDirectory::DIRECTORY_FAILED_NOT_FOUND: return BUS_FAILED_NOT_FOUND;
+	default: return BUS_FAILED_BAD_MEMORY;
+	}
+}
+
+// Publishes a message to a topic
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::Publish(uint32_t topic, const void *data, uint32_t length) {
+	SharedMemoryRing *ring = GetRing(topic);
+
+	if (!ring)
+		return Valid() ? BUS_FAILED_BAD_TOPIC : BUS_FAILED_BAD_MEMORY;
+
+	switch (ring->WriteMessage(data, length)) {
+	case SharedMemoryRing::RING_SUCCESS: return BUS_SUCCESS;
+	case SharedMemoryRing::RING_FAILED_READ_ONLY: return BUS_FAILED_READ_ONLY;
+	case SharedMemoryRing::RING_FAILED_TOO_LARGE: return BUS_FAILED_TOO_LARGE;
+	default: return BUS_FAILED_BAD_MEMORY;
+	}
+}
+
+// Subscribes to a topic, starting with the next message published to it
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::Subscribe(Subscriber &subscriber, uint32_t topic) {
+	SharedMemoryRing *ring = GetRing(topic);
+
+	if (!ring)
+		return Valid() ? BUS_FAILED_BAD_TOPIC : BUS_FAILED_BAD_MEMORY;
+
+	subscriber._positions[topic] = ring->GetWritePosition();
+	subscriber._interest |= uint64_t(1) << topic;
+	return BUS_SUCCESS;
+}
+
+// Receives the next message from any subscribed topic, polling the topics in turn
+smbb::SharedMemoryBus::Result smbb::SharedMemoryBus::Receive(Subscriber &subscriber, uint32_t &topic, void *buffer, uint32_t bufferSize, uint32_t &length) {
+	if (!Valid())
+		return BUS_FAILED_BAD_MEMORY;
+	else if (subscriber._interest == 0)
+		return BUS_EMPTY;
+
+	// Start after the last topic that received a message, so that a busy topic cannot starve the others
+	for (uint32_t i = 0; i < MAX_TOPICS; i++) {
+		const uint32_t current = (subscriber._next + i) % MAX_TOPICS;
+
+		if ((subscriber._interest & (uint64_t(1) << current)) == 0)
+			continue;
+
+		SharedMemoryRing *ring = GetRing(current);
+
+		if (!ring)
+			continue;
+
+		SharedMemoryRing::Result result;
+
+		while ((result = ring->ReadMessage(subscriber._positions[current], buffer, bufferSize, length)) == SharedMemoryRing::RING_OVERRUN || result == SharedMemoryRing::RING_ABORTED)
+			subscriber._lost++;
+
+		if (result == SharedMemoryRing::RING_SUCCESS || result == SharedMemoryRing::RING_FAILED_TOO_LARGE) {
+			topic = current;
+			subscriber._next = (current + 1) % MAX_TOPICS;
+			return result == SharedMemoryRing::RING_SUCCESS ? BUS_SUCCESS : BUS_FAILED_TOO_LARGE;
+		}
+	}
+
+	return BUS_EMPTY;
+}
@@ -0,0 +1,154 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYBUS_H
+#define SMBB_SHAREDMEMORYBUS_H
+
+#include <cstdlib>
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemoryDirectory.h"
+#include "SharedMemoryRing.h"
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// A topic-based publish / subscribe bus stored in a single shared memory section.
+//  Topics are registered by name in a directory at the start of the section, and each topic has its own ring.
+//  Subscribers select topics using an interest mask, so receiving only polls the rings of interesting topics and never makes a system call.
+class SharedMemoryBus {
+public:
+	enum Result {
+		BUS_SUCCESS = 0,
+		BUS_ALREADY_EXISTS, // The topic already exists; the existing topic is returned
+		BUS_EMPTY, // No message is available on the subscribed topics
+		BUS_FAILED_BAD_MEMORY,
+		BUS_FAILED_BAD_NAME,
+		BUS_FAILED_BAD_SIZE,
+		BUS_FAILED_BAD_TOPIC,
+		BUS_FAILED_READ_ONLY,
+		BUS_FAILED_NOT_FOUND,
+		BUS_FAILED_FULL,
+		BUS_FAILED_TOO_LARGE,
+		BUS_FAILED_MISMATCH // The topic already exists with a different slot size or slot count
+	};
+
+	// The maximum number of topics on a bus (one per bit of an interest mask)
+	static const uint32_t MAX_TOPICS = 64;
+
+	// The state of a subscriber (owned by the subscribing process)
+	class Subscriber {
+		uint64_t _interest;
+		uint64_t _positions[MAX_TOPICS];
+		uint64_t _lost;
+		uint32_t _next;
+
+	public:
+		Subscriber() : _interest(), _positions(), _lost(), _next() { }
+
+		// Gets the mask of subscribed topics
+		uint64_t GetInterest() const { return _interest; }
+
+		// Returns true if the subscriber is subscribed to the topic
+		bool IsSubscribed(uint32_t topic) const { return topic < MAX_TOPICS && (_interest & (uint64_t(1) << topic)) != 0; }
+
+		// Unsubscribes from a topic
+		void Unsubscribe(uint32_t topic) {
+			if (topic < MAX_TOPICS)
+				_interest &= ~(uint64_t(1) << topic);
+		}
+
+		// Gets the number of times the subscriber has been overrun by a producer or skipped a message abandoned by a producer
+		uint64_t GetLost() const { return _lost; }
+
+		friend class SharedMemoryBus;
+	};
+
+private:
+	SharedMemoryDirectory _directory;
+	SharedMemoryRing _rings[MAX_TOPICS];
+
+	// Gets the ring of a topic, attaching to it if it was added by another process
+	SMBB_INLINE SharedMemoryRing *GetRing(uint32_t topic);
+
+public:
+	// Gets the size of a topic with the specified slot size and count (including alignment padding)
+	static size_t GetTopicSize(uint32_t slotSize, uint32_t slotCount) {
+		return (SharedMemoryRing::GetRequiredSize(slotSize, slotCount) + SharedMemoryDirectory::DEFAULT_ALIGNMENT - 1) & ~(SharedMemoryDirectory::DEFAULT_ALIGNMENT - 1);
+	}
+
+	// Gets the section size required for a bus with the specified number of topics and total topic size
+	static size_t GetRequiredSize(uint32_t maxTopics, size_t topicsSize) { return SharedMemoryDirectory::GetRequiredSize(maxTopics, topicsSize); }
+
+	SharedMemoryBus() : _directory(), _rings() { }
+
+	// Creates a new bus in the specified memory, overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t maxTopics = MAX_TOPICS);
+
+	// Creates a new bus at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t maxTopics = MAX_TOPICS) {
+		return section.ReadOnly() ? BUS_FAILED_READ_ONLY : Create(section.Data(), section.Size(), maxTopics);
+	}
+
+	// Opens an existing bus in the specified memory
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing bus at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the bus has been created or opened
+	bool Valid() const { return _directory.Valid(); }
+
+	// Gets the number of topics on the bus
+	uint32_t GetTopicCount() const { return _directory.Count(); }
+
+	// Gets the name of a topic (or NULL if the topic does not exist)
+	const char *GetTopicName(uint32_t topic) const { return _directory.GetName(topic); }
+
+	// Adds a new topic with the specified slot size (a multiple of SharedMemoryRing::SLOT_ALIGNMENT) and slot count (a power of 2)
+	//  An existing topic is only returned if it has the same slot size and slot count.
+	SMBB_INLINE Result AddTopic(const char *name, uint32_t slotSize, uint32_t slotCount, uint32_t &topic);
+
+	// Finds an existing topic
+	SMBB_INLINE Result FindTopic(const char *name, uint32_t &topic);
+
+	// Gets the ring of a topic (or NULL if the topic does not exist or is not yet initialized)
+	SharedMemoryRing *GetTopicRing(uint32_t topic) { return GetRing(topic); }
+
+	// Publishes a message to a topic (messages larger than a slot are fragmented across consecutive slots)
+	SMBB_INLINE Result Publish(uint32_t topic, const void *data, uint32_t length);
+
+	// Subscribes to a topic, starting with the next message published to it
+	SMBB_INLINE Result Subscribe(Subscriber &subscriber, uint32_t topic);
+
+	// Receives the next message from any subscribed topic, polling the topics in turn
+	SMBB_INLINE Result Receive(Subscriber &subscriber, uint32_t &topic, void *buffer, uint32_t bufferSize, uint32_t &length);
+};
+
+}
+
+#endif
@@ -0,0 +1,267 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryChannel.h"
+
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(SMBB_NO_SHARED_MEMORY)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#if defined(MSG_CMSG_CLOEXEC)
+#define SMBB_CHANNEL_RECEIVE_FLAGS MSG_CMSG_CLOEXEC
+#else
+#define SMBB_CHANNEL_RECEIVE_FLAGS 0
+#endif
+
+#if defined(MSG_NOSIGNAL)
+#define SMBB_CHANNEL_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SMBB_CHANNEL_SEND_FLAGS 0
+#endif
+
+// The maximum number of descriptors accepted in a single message (any beyond the first are closed)
+#define SMBB_CHANNEL_MAX_DESCRIPTORS 4
+
+// Control message storage, aligned for the control message header
+union ControlBuffer {
+	struct cmsghdr header;
+	char data[CMSG_SPACE(sizeof(int) * SMBB_CHANNEL_MAX_DESCRIPTORS)];
+};
+
+// Creates a connected pair of channels
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::CreatePair(SharedMemoryChannel &first, SharedMemoryChannel &second) {
+	int handles[2];
+
+	first.Close();
+	second.Close();
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, handles) == -1)
+		return CHANNEL_FAILED_BAD_SOCKET;
+
+	first._handle = handles[0];
+	second._handle = handles[1];
+	return CHANNEL_SUCCESS;
+}
+
+// Sends shared memory, along with a tag
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::Send(const SharedMemory &memory, uint64_t tag) {
+	const int descriptor = memory.GetDescriptor();
+	const SharedMemory::Size size = memory.GetSize();
+
+	if (_handle == -1)
+		return CHANNEL_FAILED_BAD_SOCKET;
+	else if (descriptor == -1 || size <= 0)
+		return CHANNEL_FAILED_BAD_MEMORY;
+
+	Message message;
+	ControlBuffer control;
+	struct iovec buffer;
+	struct msghdr header;
+
+	message.magic = MAGIC;
+	message.flags = memory.ReadOnly() ? FLAG_READ_ONLY : 0;
+	message.size = static_cast<uint64_t>(size);
+	message.tag = tag;
+
+	buffer.iov_base = &message;
+	buffer.iov_len = sizeof(message);
+
+	memset(&control, 0, sizeof(control));
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &buffer;
+	header.msg_iovlen = 1;
+	header.msg_control = control.data;
+	header.msg_controllen = CMSG_SPACE(sizeof(int));
+
+	struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&header);
+
+	controlMessage->cmsg_level = SOL_SOCKET;
+	controlMessage->cmsg_type = SCM_RIGHTS;
+	controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(controlMessage), &descriptor, sizeof(int));
+
+	ssize_t result;
+
+	while ((result = sendmsg(_handle, &header, SMBB_CHANNEL_SEND_FLAGS)) == -1 && errno == EINTR) { }
+
+	if (result <= 0)
+		return CHANNEL_FAILED_TO_SEND;
+
+	// The descriptor is attached to the first byte, so the rest of a partially sent message can be sent normally
+	for (size_t sent = static_cast<size_t>(result); sent < sizeof(message); sent += static_cast<size_t>(result)) {
+		while ((result = send(_handle, reinterpret_cast<const char *>(&message) + sent, sizeof(message) - sent, SMBB_CHANNEL_SEND_FLAGS)) == -1 && errno == EINTR) { }
+
+		if (result <= 0)
+			return CHANNEL_FAILED_TO_SEND;
+	}
+
+	return CHANNEL_SUCCESS;
+}
+
+// Receives shared memory, along with its size and tag
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::Receive(SharedMemory &memory, SharedMemory::Size &size, uint64_t &tag) {
+	memory.Close();
+
+	if (_handle == -1)
+		return CHANNEL_FAILED_BAD_SOCKET;
+
+	ssize_t result;
+
+	// Start a new message, unless part of one was received by an earlier call
+	if (_received == 0) {
+		ControlBuffer control;
+		struct iovec buffer;
+		struct msghdr header;
+
+		buffer.iov_base = &_message;
+		buffer.iov_len = sizeof(_message);
+
+		memset(&header, 0, sizeof(header));
+		header.msg_iov = &buffer;
+		header.msg_iovlen = 1;
+		header.msg_control = control.data;
+		header.msg_controllen = sizeof(control.data);
+
+		while ((result = recvmsg(_handle, &header, SMBB_CHANNEL_RECEIVE_FLAGS)) == -1 && errno == EINTR) { }
+
+		if (result == 0)
+			return CHANNEL_CLOSED;
+		else if (result < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK ? CHANNEL_EMPTY : CHANNEL_FAILED_TO_RECEIVE;
+
+		// Take ownership of all received descriptors, keeping only the first
+		for (struct cmsghdr *controlMessage = CMSG_FIRSTHDR(&header); controlMessage; controlMessage = CMSG_NXTHDR(&header, controlMessage)) {
+			if (controlMessage->cmsg_level != SOL_SOCKET || controlMessage->cmsg_type != SCM_RIGHTS)
+				continue;
+
+			const size_t count = (controlMessage->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+			for (size_t i = 0; i < count; i++) {
+				int received;
+
+				memcpy(&received, CMSG_DATA(controlMessage) + i * sizeof(int), sizeof(int));
+
+				if (_descriptor == -1)
+					_descriptor = received;
+				else
+					(void)close(received);
+			}
+		}
+
+		// A truncated control message fails the message once it is fully received
+		if ((header.msg_flags & MSG_CTRUNC) != 0 && _descriptor != -1) {
+			(void)close(_descriptor);
+			_descriptor = -1;
+		}
+
+		_received = static_cast<size_t>(result);
+	}
+
+	Result status = CHANNEL_SUCCESS;
+
+	// Receive the rest of a partially received message, keeping it for the next call if the rest is not available yet
+	while (_received < sizeof(_message) && status == CHANNEL_SUCCESS) {
+		while ((result = recv(_handle, reinterpret_cast<char *>(&_message) + _received, sizeof(_message) - _received, 0)) == -1 && errno == EINTR) { }
+
+		if (result == 0)
+			status = CHANNEL_CLOSED;
+		else if (result > 0)
+			_received += static_cast<size_t>(result);
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return CHANNEL_WOULD_BLOCK;
+		else
+			status = CHANNEL_FAILED_TO_RECEIVE;
+	}
+
+	if (status == CHANNEL_SUCCESS && (_descriptor == -1 || _message.magic != MAGIC || _message.size == 0 ||
+			static_cast<uint64_t>(static_cast<SharedMemory::Size>(_message.size)) != _message.size || static_cast<SharedMemory::Size>(_message.size) < 0))
+		status = CHANNEL_FAILED_BAD_DATA;
+
+	if (status == CHANNEL_SUCCESS && memory.OpenDescriptor(_descriptor, (_message.flags & FLAG_READ_ONLY) != 0) != SharedMemory::LOAD_SUCCESS)
+		status = CHANNEL_FAILED_BAD_MEMORY;
+
+	// Make sure the memory is not smaller than the advertised size (this only holds afterwards if the memory has SEAL_SHRINK)
+	if (status == CHANNEL_SUCCESS && memory.GetSize() < static_cast<SharedMemory::Size>(_message.size)) {
+		memory.Close();
+		status = CHANNEL_FAILED_BAD_DATA;
+	}
+
+	if (status == CHANNEL_SUCCESS) {
+		size = static_cast<SharedMemory::Size>(_message.size);
+		tag = _message.tag;
+	}
+
+	DiscardPartial();
+	return status;
+}
+
+// Discards any partially received message
+void smbb::SharedMemoryChannel::DiscardPartial() {
+	if (_descriptor != -1) {
+		(void)close(_descriptor);
+		_descriptor = -1;
+	}
+
+	_received = 0;
+}
+
+// Closes the socket of the channel
+void smbb::SharedMemoryChannel::Close() {
+	DiscardPartial();
+
+	if (_handle != -1) {
+		(void)close(_handle);
+		_handle = -1;
+	}
+}
+#else
+// Creates a connected pair of channels (not supported)
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::CreatePair(SharedMemoryChannel &, SharedMemoryChannel &) {
+	return CHANNEL_FAILED_UNSUPPORTED;
+}
+
+// Sends shared memory (not supported)
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::Send(const SharedMemory &, uint64_t) {
+	return CHANNEL_FAILED_UNSUPPORTED;
+}
+
+// Receives shared memory (not supported)
+smbb::SharedMemoryChannel::Result smbb::SharedMemoryChannel::Receive(SharedMemory &, SharedMemory::Size &, uint64_t &) {
+	return CHANNEL_FAILED_UNSUPPORTED;
+}
+
+// Discards any partially received message
+void smbb::SharedMemoryChannel::DiscardPartial() {
+	_descriptor = -1;
+	_received = 0;
+}
+
+// Closes the socket of the channel
+void smbb::SharedMemoryChannel::Close() {
+	_handle = -1;
+}
+#endif
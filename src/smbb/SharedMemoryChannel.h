@@ -0,0 +1,126 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYCHANNEL_H
+#define SMBB_SHAREDMEMORYCHANNEL_H
+
+#include <cstdlib>
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemory.h"
+
+namespace smbb {
+
+// Passes shared memory between processes over a Unix-domain socket (using SCM_RIGHTS), so peers can rendezvous without agreeing on a name or path.
+//  Each message carries the descriptor of the shared memory along with its size, read-only flag, and a tag chosen by the sender (e.g. a session identifier).
+//  The receiver gets a ready-to-map SharedMemory, which also allows anonymous and sealed shared memory to be handed to other processes.
+class SharedMemoryChannel {
+public:
+	enum Result {
+		CHANNEL_SUCCESS = 0,
+		CHANNEL_EMPTY, // No message is available on a non-blocking socket
+		CHANNEL_WOULD_BLOCK, // Only part of a message is available on a non-blocking socket (it is kept, and receiving again continues it)
+		CHANNEL_CLOSED, // The peer closed the socket
+		CHANNEL_FAILED_UNSUPPORTED,
+		CHANNEL_FAILED_BAD_SOCKET,
+		CHANNEL_FAILED_BAD_MEMORY,
+		CHANNEL_FAILED_BAD_DATA,
+		CHANNEL_FAILED_TO_SEND,
+		CHANNEL_FAILED_TO_RECEIVE
+	};
+
+private:
+	static const uint32_t MAGIC = 0x534D4246; // "SMBF"
+
+	// The read-only flag in a message
+	static const uint32_t FLAG_READ_ONLY = 1;
+
+	// The layout of each message (the descriptor is sent as ancillary data)
+	struct Message {
+		uint32_t magic;
+		uint32_t flags;
+		uint64_t size;
+		uint64_t tag;
+	};
+
+	int _handle;
+
+	// The state of a partially received message
+	Message _message;
+	size_t _received;
+	int _descriptor;
+
+	// Discards any partially received message
+	SMBB_INLINE void DiscardPartial();
+
+	// Disable copying
+	SharedMemoryChannel(const SharedMemoryChannel &) { }
+	SharedMemoryChannel &operator=(const SharedMemoryChannel &) { return *this; }
+
+public:
+	// Creates a connected pair of channels (e.g. before forking a worker process)
+	static SMBB_INLINE Result CreatePair(SharedMemoryChannel &first, SharedMemoryChannel &second);
+
+	// Creates a channel that takes ownership of a connected Unix-domain stream or sequenced-packet socket (or an invalid channel)
+	explicit SharedMemoryChannel(int handle = -1) : _handle(handle), _message(), _received(0), _descriptor(-1) { }
+
+	~SharedMemoryChannel() { Close(); }
+
+	// Returns true if the channel has a socket
+	bool Valid() const { return _handle != -1; }
+
+	// Gets the socket of the channel (e.g. to poll it)
+	int GetHandle() const { return _handle; }
+
+	// Releases ownership of the socket, returning it (any partially received message is discarded)
+	int Release() {
+		const int handle = _handle;
+
+		DiscardPartial();
+		_handle = -1;
+		return handle;
+	}
+
+	// Sends shared memory (which the peer maps with the same size and access as the sender), along with a tag
+	SMBB_INLINE Result Send(const SharedMemory &memory, uint64_t tag = 0);
+
+	// Receives shared memory, along with its size and tag (the memory is only usable if this returns CHANNEL_SUCCESS)
+	//  The size is checked against the received memory, but the sender can still shrink it later (faulting any access beyond the new size) unless it has SEAL_SHRINK.
+	//  Receivers that do not trust the sender should check for that seal before mapping.
+	SMBB_INLINE Result Receive(SharedMemory &memory, SharedMemory::Size &size, uint64_t &tag);
+
+	// Receives shared memory, along with its size
+	Result Receive(SharedMemory &memory, SharedMemory::Size &size) {
+		uint64_t tag;
+		return Receive(memory, size, tag);
+	}
+
+	// Closes the socket of the channel
+	SMBB_INLINE void Close();
+};
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryCheckpoint.h"
+
+#include <cstring>
+
+// Hashes data into an existing hash (all but the last block of data must be a multiple of 8 bytes)
+uint64_t smbb::SharedMemoryCheckpoint::Hash(uint64_t hash, const uint8_t *data, size_t size) {
+	const uint64_t multiplier = (uint64_t(0x9E3779B9) << 32) | 0x7F4A7C15;
+	size_t i = 0;
+
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+
+		memcpy(&word, data + i, sizeof(word));
+		hash = ((hash ^ word) * multiplier);
+		hash ^= hash >> 29;
+	}
+
+	for (; i < size; i++)
+		hash = (hash ^ data[i]) * multiplier;
+
+	return hash;
+}
+
+// Checks the next checkpoint in a file without applying it
+smbb::SharedMemoryCheckpoint::Result smbb::SharedMemoryCheckpoint::Verify(FILE *file, const FileHeader &header, uint64_t &sequence) {
+	const size_t size = static_cast<size_t>(header.size);
+	const uint64_t pageCount = GetPageCount(size, header.pageSize);
+	uint8_t buffer[BUFFER_SIZE];
+	uint64_t checksum = 0;
+	uint64_t count = 0;
+	uint64_t index;
+
+	while (fread(&index, sizeof(index), 1, file) == 1) {
+		if (index == FOOTER_INDEX) {
+			Footer footer;
+
+			if (fread(&footer.sequence, sizeof(footer) - sizeof(footer.index), 1, file) != 1)
+				return CHECKPOINT_FAILED_TO_READ;
+
+			sequence = footer.sequence;
+			return footer.pageCount == count && footer.checksum == checksum ? CHECKPOINT_SUCCESS : CHECKPOINT_FAILED_BAD_FILE;
+		}
+		else if (index >= pageCount)
+			return CHECKPOINT_FAILED_BAD_FILE;
+
+		const size_t pageSize = GetPageSize(size, header.pageSize, index);
+		uint64_t hash = 0;
+
+		for (size_t offset = 0; offset < pageSize; offset += BUFFER_SIZE) {
+			const size_t length = pageSize - offset < BUFFER_SIZE ? pageSize - offset : BUFFER_SIZE;
+
+			if (fread(buffer, length, 1, file) != 1)
+				return CHECKPOINT_FAILED_TO_READ;
+
+			hash = Hash(hash, buffer, length);
+		}
+
+		checksum = AddToChecksum(checksum, index, FinishHash(hash));
+		count++;
+	}
+
+	return CHECKPOINT_FAILED_TO_READ;
+}
+
+// Restores a region from a checkpoint file, applying each complete checkpoint in order
+smbb::SharedMemoryCheckpoint::Result smbb::SharedMemoryCheckpoint::Restore(FILE *file, uint8_t *data, size_t size, uint64_t *checkpoints) {
+	FileHeader header;
+	fpos_t start;
+	uint64_t complete = 0;
+	uint64_t sequence = 0;
+
+	if (checkpoints)
+		*checkpoints = 0;
+
+	if (!data)
+		return CHECKPOINT_FAILED_BAD_MEMORY;
+	else if (!file || fread(&header, sizeof(header), 1, file) != 1 || header.magic != MAGIC || header.version != VERSION || header.pageSize == 0 || header.pageSize % 8 != 0)
+		return CHECKPOINT_FAILED_BAD_FILE;
+	else if (header.size != size)
+		return CHECKPOINT_FAILED_MISMATCH;
+	else if (fgetpos(file, &start) != 0)
+		return CHECKPOINT_FAILED_TO_READ;
+
+	// Find the complete checkpoints first, so that a partially written checkpoint is never applied
+	while (Verify(file, header, sequence) == CHECKPOINT_SUCCESS && sequence == complete + 1)
+		complete++;
+
+	if (complete == 0)
+		return CHECKPOINT_FAILED_BAD_FILE;
+	else if (fsetpos(file, &start) != 0)
+		return CHECKPOINT_FAILED_TO_READ;
+
+	for (uint64_t i = 0; i < complete; ) {
+		uint64_t index;
+
+		if (fread(&index, sizeof(index), 1, file) != 1)
+			return CHECKPOINT_FAILED_TO_READ;
+
+		if (index == FOOTER_INDEX) {
+			Footer footer;
+
+			if (fread(&footer.sequence, sizeof(footer) - sizeof(footer.index), 1, file) != 1)
+				return CHECKPOINT_FAILED_TO_READ;
+
+			i++;
+		}
+		else if (fread(data + static_cast<size_t>(index) * header.pageSize, GetPageSize(size, header.pageSize, index), 1, file) != 1)
+			return CHECKPOINT_FAILED_TO_READ;
+	}
+
+	if (checkpoints)
+		*checkpoints = complete;
+
+	return CHECKPOINT_SUCCESS;
+}
+
+// Creates a checkpoint of a region, using the specified array (of GetPageCount() hashes) to track the pages from the previous checkpoint
+smbb::SharedMemoryCheckpoint::Result smbb::SharedMemoryCheckpoint::Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint32_t pageSize) {
+	_data = NULL;
+
+	if (!data)
+		return CHECKPOINT_FAILED_BAD_MEMORY;
+	else if (size == 0 || !hashes || pageSize == 0 || pageSize % 8 != 0 || hashCount < GetPageCount(size, pageSize))
+		return CHECKPOINT_FAILED_BAD_SIZE;
+
+	_data = data;
+	_size = size;
+	_hashes = hashes;
+	_pageCount = GetPageCount(size, pageSize);
+	_pageSize = pageSize;
+	Invalidate();
+	return CHECKPOINT_SUCCESS;
+}
+
+// Forgets the previous checkpoint, so that the next checkpoint writes every page
+void smbb::SharedMemoryCheckpoint::Invalidate() {
+	if (_hashes)
+		memset(_hashes, 0, sizeof(uint64_t) * _pageCount);
+
+	_sequence = 0;
+}
+
+// Starts a new checkpoint file, writing the file header and a full checkpoint
+smbb::SharedMemoryCheckpoint::Result smbb::SharedMemoryCheckpoint::Begin(FILE *file, size_t *pagesWritten) {
+	if (pagesWritten)
+		*pagesWritten = 0;
+
+	if (!_data)
+		return CHECKPOINT_FAILED_BAD_MEMORY;
+	else if (!file)
+		return CHECKPOINT_FAILED_BAD_FILE;
+
+	FileHeader header = { MAGIC, VERSION, _pageSize, 0, _size };
+
+	Invalidate();
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+		return CHECKPOINT_FAILED_TO_WRITE;
+
+	_sequence = 1;
+	return Write(file, pagesWritten);
+}
+
+// Appends an incremental checkpoint of the pages that changed since the previous checkpoint (after a failure, a new file must be started)
+smbb::SharedMemoryCheckpoint::Result smbb::SharedMemoryCheckpoint::Write(FILE *file, size_t *pagesWritten) {
+	uint64_t checksum = 0;
+	size_t count = 0;
+
+	if (pagesWritten)
+		*pagesWritten = 0;
+
+	if (!_data)
+		return CHECKPOINT_FAILED_BAD_MEMORY;
+	else if (!file || _sequence == 0) // The file must be started (again) with Begin()
+		return CHECKPOINT_FAILED_BAD_FILE;
+
+	for (size_t i = 0; i < _pageCount; i++) {
+		const uint8_t *page = _data + i * _pageSize;
+		const size_t pageSize = GetPageSize(_size, _pageSize, i);
+		const uint64_t hash = GetPageHash(page, pageSize);
+
+		if (hash == _hashes[i])
+			continue;
+
+		const uint64_t index = i;
+		uint8_t buffer[BUFFER_SIZE];
+		uint64_t writtenHash = 0;
+
+		if (fwrite(&index, sizeof(index), 1, file) != 1) {
+			Invalidate();
+			return CHECKPOINT_FAILED_TO_WRITE;
+		}
+
+		// The page is copied before it is hashed and written, so the checksum matches the written data even if the page is being modified
+		for (size_t offset = 0; offset < pageSize; offset += BUFFER_SIZE) {
+			const size_t length = pageSize - offset < BUFFER_SIZE ? pageSize - offset : BUFFER_SIZE;
+
+			memcpy(buffer, page + offset, length);
+			writtenHash = Hash(writtenHash, buffer, length);
+
+			if (fwrite(buffer, length, 1, file) != 1) {
+				Invalidate();
+				return CHECKPOINT_FAILED_TO_WRITE;
+			}
+		}
+
+		_hashes[i] = FinishHash(writtenHash);
+		checksum = AddToChecksum(checksum, index, _hashes[i]);
+		count++;
+	}
+
+	Footer footer = { FOOTER_INDEX, _sequence, count, checksum };
+
+	if (fwrite(&footer, sizeof(footer), 1, file) != 1 || fflush(file) != 0) {
+		Invalidate();
+		return CHECKPOINT_FAILED_TO_WRITE;
+	}
+
+	if (pagesWritten)
+		*pagesWritten = count;
+
+	_sequence++;
+	return CHECKPOINT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYCHECKPOINT_H
+#define SMBB_SHAREDMEMORYCHECKPOINT_H
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// Incrementally checkpoints a region of shared memory to a file.
+//  The region is divided into pages, and the hash of each page is kept from the previous checkpoint, so each checkpoint only writes the pages that changed.
+//  Pages are compared by content rather than by dirty-page tracking, since the kernel only tracks writes made through the mappings of the current process.
+//  A checkpoint file contains a full checkpoint followed by any number of incremental checkpoints. Each checkpoint ends with a footer,
+//  so restoring ignores a checkpoint that was only partially written. Note that a checkpoint of memory that is being modified is not a consistent snapshot.
+class SharedMemoryCheckpoint {
+public:
+	enum Result {
+		CHECKPOINT_SUCCESS = 0,
+		CHECKPOINT_FAILED_BAD_MEMORY,
+		CHECKPOINT_FAILED_BAD_SIZE,
+		CHECKPOINT_FAILED_BAD_FILE,
+		CHECKPOINT_FAILED_MISMATCH,
+		CHECKPOINT_FAILED_TO_READ,
+		CHECKPOINT_FAILED_TO_WRITE
+	};
+
+	// The default size of each page (a typical virtual memory page size)
+	static const uint32_t DEFAULT_PAGE_SIZE = 4096;
+
+private:
+	static const uint32_t MAGIC = 0x534D4243; // "SMBC"
+	static const uint32_t VERSION = 1;
+
+	// The page index that marks the footer of a checkpoint
+	static const uint64_t FOOTER_INDEX = ~uint64_t(0);
+
+	// The size of the buffer used to verify pages when restoring
+	static const size_t BUFFER_SIZE = 4096;
+
+	// The layout of the file header
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t pageSize;
+		uint32_t reserved;
+		uint64_t size;
+	};
+
+	// The layout of the footer of each checkpoint (following the page records, which are each a page index followed by the page data)
+	struct Footer {
+		uint64_t index; // Always FOOTER_INDEX
+		uint64_t sequence;
+		uint64_t pageCount;
+		uint64_t checksum;
+	};
+
+	const uint8_t *_data;
+	size_t _size;
+	uint64_t *_hashes;
+	size_t _pageCount;
+	uint32_t _pageSize;
+	uint64_t _sequence;
+
+	// Hashes data into an existing hash (all but the last block of data must be a multiple of 8 bytes)
+	static SMBB_INLINE uint64_t Hash(uint64_t hash, const uint8_t *data, size_t size);
+
+	// Finishes a hash, so that it is never zero (which marks an unknown page)
+	static uint64_t FinishHash(uint64_t hash) {
+		hash ^= hash >> 33;
+		hash *= (uint64_t(0xFF51AFD7) << 32) | 0xED558CCD;
+		hash ^= hash >> 33;
+		return hash ? hash : 1;
+	}
+
+	// Adds a page to the checksum of a checkpoint
+	static uint64_t AddToChecksum(uint64_t checksum, uint64_t index, uint64_t hash) { return (checksum ^ index ^ (hash << 1)) * ((uint64_t(0x100) << 32) | 0x1B3); }
+
+	// Gets the size of a page (the last page may be partial)
+	static size_t GetPageSize(size_t size, uint32_t pageSize, uint64_t index) {
+		const size_t offset = static_cast<size_t>(index) * pageSize;
+		return size - offset < pageSize ? size - offset : pageSize;
+	}
+
+	// Checks the next checkpoint in a file without applying it
+	static SMBB_INLINE Result Verify(FILE *file, const FileHeader &header, uint64_t &sequence);
+
+public:
+	// Gets the hash of a page (never zero, so zero can mark an unknown page)
+	static uint64_t GetPageHash(const uint8_t *data, size_t size) { return FinishHash(Hash(0, data, size)); }
+
+	// Gets the number of pages (and page hashes) required for a region of the specified size
+	static size_t GetPageCount(size_t size, uint32_t pageSize = DEFAULT_PAGE_SIZE) { return pageSize ? (size + pageSize - 1) / pageSize : 0; }
+
+	// Restores a region from a checkpoint file, applying each complete checkpoint in order
+	static SMBB_INLINE Result Restore(FILE *file, uint8_t *data, size_t size, uint64_t *checkpoints = NULL);
+
+	// Restores the shared memory section from a checkpoint file
+	static Result Restore(FILE *file, const SharedMemorySection &section, uint64_t *checkpoints = NULL) {
+		return section.ReadOnly() ? CHECKPOINT_FAILED_BAD_MEMORY : Restore(file, section.Data(), section.Size(), checkpoints);
+	}
+
+	SharedMemoryCheckpoint() : _data(), _size(), _hashes(), _pageCount(), _pageSize(), _sequence() { }
+
+	// Creates a checkpoint of a region, using the specified array (of GetPageCount() hashes) to track the pages from the previous checkpoint
+	SMBB_INLINE Result Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint32_t pageSize = DEFAULT_PAGE_SIZE);
+
+	// Creates a checkpoint of the shared memory section
+	Result Create(const SharedMemorySection &section, uint64_t *hashes, size_t hashCount, uint32_t pageSize = DEFAULT_PAGE_SIZE) {
+		return Create(section.Data(), section.Size(), hashes, hashCount, pageSize);
+	}
+
+	// Returns true if the checkpoint has been created
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the number of pages in the region
+	size_t GetPageCount() const { return _pageCount; }
+
+	// Gets the sequence number of the next checkpoint (0 if a new file must be started using Begin())
+	uint64_t GetSequence() const { return _sequence; }
+
+	// Forgets the previous checkpoint, so that the next checkpoint writes every page
+	SMBB_INLINE void Invalidate();
+
+	// Starts a new checkpoint file, writing the file header and a full checkpoint
+	SMBB_INLINE Result Begin(FILE *file, size_t *pagesWritten = NULL);
+
+	// Appends an incremental checkpoint of the pages that changed since the previous checkpoint (after a failure, a new file must be started)
+	SMBB_INLINE Result Write(FILE *file, size_t *pagesWritten = NULL);
+};
+
+}
+
+#endif
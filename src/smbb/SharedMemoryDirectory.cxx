@@ -0,0 +1,175 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryDirectory.h"
+
+#include <cstring>
+
+// Finds the entry with the specified name among the first count entries
+const smbb::SharedMemoryDirectory::Entry *smbb::SharedMemoryDirectory::FindEntry(const char *name, uint32_t hash, uint32_t count) const {
+	const Entry *entries = GetEntries();
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (entries[i].hash == hash && strncmp(entries[i].name, name, MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE) == 0)
+			return &entries[i];
+	}
+
+	return NULL;
+}
+
+// Fills a region from an entry, returning false if the entry does not fit in the mapped memory
+bool smbb::SharedMemoryDirectory::FillRegion(const Entry &entry, Region &region) const {
+	if (entry.offset > _size || entry.size > _size - entry.offset)
+		return false;
+
+	region._data = _data + static_cast<size_t>(entry.offset);
+	region._size = static_cast<size_t>(entry.size);
+	region._offset = entry.offset;
+	region._index = static_cast<uint32_t>(&entry - GetEntries());
+	return true;
+}
+
+// Creates a new directory in the specified memory, overwriting any existing content
+smbb::SharedMemoryDirectory::Result smbb::SharedMemoryDirectory::Create(uint8_t *data, size_t size, uint32_t maxEntries) {
+	_data = NULL;
+
+	if (!data || size < sizeof(Header) || maxEntries == 0 || maxEntries > (size - sizeof(Header)) / sizeof(Entry) || size < GetDataOffset(maxEntries))
+		return DIRECTORY_FAILED_BAD_SIZE;
+
+	Header *header = reinterpret_cast<Header *>(data);
+
+	memset(data, 0, GetDataOffset(maxEntries));
+	header->version = VERSION;
+	header->maxEntries = maxEntries;
+	header->size = size;
+	header->used = GetDataOffset(maxEntries);
+
+	// Publish the directory last, so that it is never seen partially initialized
+	header->magic.Store(MAGIC, MEMORY_ORDER_RELEASE);
+
+	_data = data;
+	_size = size;
+	_readOnly = false;
+	return DIRECTORY_SUCCESS;
+}
+
+// Opens an existing directory in the specified memory
+smbb::SharedMemoryDirectory::Result smbb::SharedMemoryDirectory::Open(uint8_t *data, size_t size, bool readOnly) {
+	_data = NULL;
+
+	if (!data || size < sizeof(Header))
+		return DIRECTORY_FAILED_BAD_MEMORY;
+
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	if (header->magic.Load(MEMORY_ORDER_ACQUIRE) != MAGIC || header->version != VERSION || header->maxEntries == 0 ||
+			header->maxEntries > (size - sizeof(Header)) / sizeof(Entry) || header->size < GetDataOffset(header->maxEntries))
+		return DIRECTORY_FAILED_BAD_MEMORY;
+
+	_data = data;
+	_size = size;
+	_readOnly = readOnly;
+	return DIRECTORY_SUCCESS;
+}
+
+// Allocates a new named sub-region of the specified size and alignment (a power of 2, no larger than the page size)
+smbb::SharedMemoryDirectory::Result smbb::SharedMemoryDirectory::Allocate(const char *name, size_t size, Region &region, size_t alignment) {
+	uint32_t hash;
+	size_t length;
+
+	if (!_data)
+		return DIRECTORY_FAILED_BAD_MEMORY;
+	else if (!HashName(name, MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE, hash, length))
+		return DIRECTORY_FAILED_BAD_NAME;
+	else if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > SharedMemorySection::GetOffsetSize())
+		return DIRECTORY_FAILED_BAD_SIZE;
+	else if (_readOnly)
+		return DIRECTORY_FAILED_READ_ONLY;
+
+	Header *header = GetHeader();
+	Result result = DIRECTORY_SUCCESS;
+
+	// Allocation is rare, so a simple spin lock is sufficient to serialize allocations across processes
+	for (uint32_t unlocked = 0; !header->lock.CompareExchange(unlocked, 1, MEMORY_ORDER_ACQUIRE); unlocked = 0)
+		CpuRelax();
+
+	uint32_t count = header->count.Load(MEMORY_ORDER_RELAXED);
+	const Entry *existing = FindEntry(name, hash, count);
+
+	if (existing)
+		result = FillRegion(*existing, region) ? DIRECTORY_ALREADY_EXISTS : DIRECTORY_FAILED_BAD_MEMORY;
+	else if (count >= header->maxEntries)
+		result = DIRECTORY_FAILED_FULL;
+	else {
+		uint64_t offset = (header->used + alignment - 1) & ~static_cast<uint64_t>(alignment - 1);
+		uint64_t limit = header->size < _size ? header->size : _size;
+
+		if (offset > limit || size > limit - offset)
+			result = DIRECTORY_FAILED_OUT_OF_SPACE;
+		else {
+			Entry &entry = GetEntries()[count];
+
+			memcpy(entry.name, name, length + 1);
+			entry.hash = hash;
+			entry.offset = offset;
+			entry.size = size;
+
+			header->used = offset + size;
+			(void)FillRegion(entry, region);
+
+			// Publish the entry only after it is completely written
+			header->count.Store(count + 1, MEMORY_ORDER_RELEASE);
+		}
+	}
+
+	header->lock.Store(0, MEMORY_ORDER_RELEASE);
+	return result;
+}
+
+// Finds an existing named sub-region
+smbb::SharedMemoryDirectory::Result smbb::SharedMemoryDirectory::Find(const char *name, Region &region) const {
+	uint32_t hash;
+	size_t length;
+
+	if (!_data)
+		return DIRECTORY_FAILED_BAD_MEMORY;
+	else if (!HashName(name, MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE, hash, length))
+		return DIRECTORY_FAILED_BAD_NAME;
+
+	const Entry *entry = FindEntry(name, hash, Count());
+
+	if (!entry)
+		return DIRECTORY_FAILED_NOT_FOUND;
+
+	return FillRegion(*entry, region) ? DIRECTORY_SUCCESS : DIRECTORY_FAILED_BAD_MEMORY;
+}
+
+// Gets the sub-region at the specified index
+smbb::SharedMemoryDirectory::Result smbb::SharedMemoryDirectory::Get(uint32_t index, Region &region) const {
+	if (!_data)
+		return DIRECTORY_FAILED_BAD_MEMORY;
+	else if (index >= Count())
+		return DIRECTORY_FAILED_NOT_FOUND;
+
+	return FillRegion(GetEntries()[index], region) ? DIRECTORY_SUCCESS : DIRECTORY_FAILED_BAD_MEMORY;
+}
@@ -0,0 +1,180 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYDIRECTORY_H
+#define SMBB_SHAREDMEMORYDIRECTORY_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+#include "utilities/NameHash.h"
+
+#include "SharedMemorySection.h"
+
+#ifndef MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE
+#define MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE 40U
+#endif
+
+namespace smbb {
+
+// A directory of named, aligned sub-regions carved out of a single shared memory section.
+//  The directory is stored at the start of the section, so any process mapping the section can look up the sub-regions by name.
+//  Sub-regions can be allocated (but never freed) by any process with write access.
+class SharedMemoryDirectory {
+public:
+	enum Result {
+		DIRECTORY_SUCCESS = 0,
+		DIRECTORY_ALREADY_EXISTS, // The name already exists; the existing region is returned
+		DIRECTORY_FAILED_BAD_MEMORY,
+		DIRECTORY_FAILED_BAD_NAME,
+		DIRECTORY_FAILED_BAD_SIZE,
+		DIRECTORY_FAILED_READ_ONLY,
+		DIRECTORY_FAILED_NOT_FOUND,
+		DIRECTORY_FAILED_FULL,
+		DIRECTORY_FAILED_OUT_OF_SPACE
+	};
+
+	// The default alignment of a sub-region (a typical cache line size)
+	static const size_t DEFAULT_ALIGNMENT = 64;
+
+	// A named sub-region of the directory
+	class Region {
+		uint8_t *_data;
+		size_t _size;
+		DataSize _offset;
+		uint32_t _index;
+
+	public:
+		Region() : _data(), _size(), _offset(), _index() { }
+
+		// Returns true if the region is valid
+		bool Valid() const { return _data != NULL; }
+
+		// Gets the offset of the region from the start of the directory
+		DataSize Offset() const { return _offset; }
+
+		// Gets the data pointer of the region
+		uint8_t *Data() const { return _data; }
+
+		// Gets the size of the region
+		size_t Size() const { return _size; }
+
+		// Gets the index of the region in the directory
+		uint32_t Index() const { return _index; }
+
+		friend class SharedMemoryDirectory;
+	};
+
+private:
+	static const uint32_t MAGIC = 0x534D4244; // "SMBD"
+	static const uint32_t VERSION = 1;
+
+	// The layout of the directory header in shared memory
+	struct Header {
+		Atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t maxEntries;
+		Atomic<uint32_t> lock;
+		Atomic<uint32_t> count;
+		uint32_t reserved;
+		uint64_t size;
+		uint64_t used;
+	};
+
+	// The layout of a directory entry in shared memory
+	struct Entry {
+		char name[MAX_SHARED_MEMORY_DIRECTORY_NAME_SIZE];
+		uint32_t hash;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	uint8_t *_data;
+	size_t _size;
+	bool _readOnly;
+
+	// Gets the header and entries of the directory
+	Header *GetHeader() const { return reinterpret_cast<Header *>(_data); }
+	Entry *GetEntries() const { return reinterpret_cast<Entry *>(_data + sizeof(Header)); }
+
+	// Gets the offset of the first sub-region for the specified number of entries
+	static size_t GetDataOffset(uint32_t maxEntries) {
+		return (sizeof(Header) + sizeof(Entry) * maxEntries + DEFAULT_ALIGNMENT - 1) & ~(DEFAULT_ALIGNMENT - 1);
+	}
+
+	// Finds the entry with the specified name among the first count entries
+	SMBB_INLINE const Entry *FindEntry(const char *name, uint32_t hash, uint32_t count) const;
+
+	// Fills a region from an entry, returning false if the entry does not fit in the mapped memory
+	SMBB_INLINE bool FillRegion(const Entry &entry, Region &region) const;
+
+public:
+	// Gets the section size required for a directory with the specified number of entries and total sub-region size (including alignment padding)
+	static size_t GetRequiredSize(uint32_t maxEntries, size_t dataSize) { return GetDataOffset(maxEntries) + dataSize; }
+
+	SharedMemoryDirectory() : _data(), _size(), _readOnly() { }
+
+	// Creates a new directory in the specified memory, overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t maxEntries);
+
+	// Creates a new directory at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t maxEntries) {
+		return section.ReadOnly() ? DIRECTORY_FAILED_READ_ONLY : Create(section.Data(), section.Size(), maxEntries);
+	}
+
+	// Opens an existing directory in the specified memory
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing directory at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the directory has been created or opened
+	bool Valid() const { return _data != NULL; }
+
+	// Returns true if the directory is read only
+	bool ReadOnly() const { return _readOnly; }
+
+	// Gets the number of sub-regions in the directory
+	uint32_t Count() const { return _data ? GetHeader()->count.Load(MEMORY_ORDER_ACQUIRE) : 0; }
+
+	// Gets the name of the sub-region at the specified index (or NULL if the index is out of range)
+	const char *GetName(uint32_t index) const { return index < Count() ? GetEntries()[index].name : NULL; }
+
+	// Allocates a new named sub-region of the specified size and alignment (a power of 2, no larger than the page size)
+	SMBB_INLINE Result Allocate(const char *name, size_t size, Region &region, size_t alignment = DEFAULT_ALIGNMENT);
+
+	// Finds an existing named sub-region
+	SMBB_INLINE Result Find(const char *name, Region &region) const;
+
+	// Gets the sub-region at the specified index
+	SMBB_INLINE Result Get(uint32_t index, Region &region) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryMappingPool.h"
+
+// Unmaps the reserved entries in the mask (the pool must not be locked), then frees them
+void smbb::SharedMemoryMappingPool::Unmap(uint64_t evicted) {
+	if (!evicted)
+		return;
+
+	for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+		if (evicted & (uint64_t(1) << i))
+			_sections[i].Unmap();
+	}
+
+	Lock();
+
+	for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+		if (evicted & (uint64_t(1) << i))
+			_entries[i].state = ENTRY_FREE;
+	}
+
+	Unlock();
+}
+
+// Gets a mapping of the specified range of shared memory (the offset does not need to be aligned), reusing an existing mapping if possible
+smbb::SharedMemoryMappingPool::Result smbb::SharedMemoryMappingPool::Acquire(const SharedMemory &memory, size_t size, SharedMemory::Size offset, Mapping &mapping) {
+	const SharedMemory::Size mapOffset = SharedMemorySection::GetMapOffset(offset);
+	const size_t mapSize = size + static_cast<size_t>(offset - mapOffset);
+	const uint64_t memoryId = memory.GetId();
+
+	mapping._data = NULL;
+
+	if (size == 0 || offset < 0 || mapSize < size)
+		return MAPPING_FAILED_BAD_SIZE;
+	else if (_maxSize && mapSize > _maxSize)
+		return MAPPING_FAILED_FULL;
+	else if (memoryId == 0)
+		return MAPPING_FAILED_TO_MAP;
+
+	Lock();
+	_uses++;
+
+	// Reuse any mapping that contains the range
+	for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+		const SharedMemorySection &section = _sections[i];
+
+		if (_entries[i].state == ENTRY_MAPPED && _entries[i].memoryId == memoryId &&
+				section.Offset() <= offset && static_cast<SharedMemory::Size>(offset + size) <= static_cast<SharedMemory::Size>(section.Offset() + section.Size())) {
+			_entries[i].references++;
+			_entries[i].lastUse = _uses;
+			_hits.FetchAdd(1, MEMORY_ORDER_RELAXED);
+			Unlock();
+
+			mapping._data = section.Data() + static_cast<size_t>(offset - section.Offset());
+			mapping._size = size;
+			mapping._index = i;
+			return MAPPING_SUCCESS;
+		}
+	}
+
+	_misses.FetchAdd(1, MEMORY_ORDER_RELAXED);
+
+	// Unmap the least recently used mappings until there is an entry and enough space for the new mapping
+	for (;;) {
+		uint32_t available = MAX_MAPPINGS;
+		uint32_t oldest = MAX_MAPPINGS;
+
+		for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+			if (_entries[i].state == ENTRY_FREE)
+				available = i;
+			else if (_entries[i].state == ENTRY_MAPPED && _entries[i].references == 0 && (oldest == MAX_MAPPINGS || _entries[i].lastUse < _entries[oldest].lastUse))
+				oldest = i;
+		}
+
+		if (available != MAX_MAPPINGS && (!_maxSize || _mappedSize.Load(MEMORY_ORDER_RELAXED) + mapSize <= _maxSize)) {
+			// The entry and its size are reserved while it is mapped, so the limits still hold for other threads
+			_entries[available].memoryId = memoryId;
+			_entries[available].state = ENTRY_MAPPING;
+			_entries[available].references = 1;
+			_mappedSize.FetchAdd(mapSize, MEMORY_ORDER_RELAXED);
+			Unlock();
+
+			const bool mapped = _sections[available].Map(memory, mapSize, mapOffset);
+
+			Lock();
+
+			if (!mapped) {
+				_entries[available].state = ENTRY_FREE;
+				_mappedSize.FetchSubtract(mapSize, MEMORY_ORDER_RELAXED);
+				Unlock();
+				return MAPPING_FAILED_TO_MAP;
+			}
+
+			_entries[available].state = ENTRY_MAPPED;
+			_entries[available].lastUse = _uses;
+			Unlock();
+
+			mapping._data = _sections[available].Data() + static_cast<size_t>(offset - mapOffset);
+			mapping._size = size;
+			mapping._index = available;
+			return MAPPING_SUCCESS;
+		}
+		else if (oldest == MAX_MAPPINGS) {
+			Unlock();
+			return MAPPING_FAILED_FULL;
+		}
+
+		Evict(oldest);
+		Unlock();
+		Unmap(uint64_t(1) << oldest);
+		Lock();
+	}
+}
+
+// Releases a mapping (the pool keeps the underlying mapping for reuse)
+void smbb::SharedMemoryMappingPool::Release(Mapping &mapping) {
+	if (!mapping._data || mapping._index >= MAX_MAPPINGS)
+		return;
+
+	Lock();
+
+	if (_entries[mapping._index].references > 0)
+		_entries[mapping._index].references--;
+
+	Unlock();
+	mapping._data = NULL;
+}
+
+// Unmaps all unreferenced mappings of the shared memory, returning false if any of its mappings are still referenced
+bool smbb::SharedMemoryMappingPool::Remove(const SharedMemory &memory) {
+	const uint64_t memoryId = memory.GetId();
+	uint64_t evicted = 0;
+	bool removed = true;
+
+	Lock();
+
+	for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+		if (_entries[i].state == ENTRY_FREE || _entries[i].state == ENTRY_UNMAPPING || _entries[i].memoryId != memoryId)
+			continue;
+		else if (_entries[i].state == ENTRY_MAPPED && _entries[i].references == 0) {
+			Evict(i);
+			evicted |= uint64_t(1) << i;
+		}
+		else
+			removed = false;
+	}
+
+	Unlock();
+	Unmap(evicted);
+	return removed;
+}
+
+// Unmaps all unreferenced mappings
+void smbb::SharedMemoryMappingPool::Clear() {
+	uint64_t evicted = 0;
+
+	Lock();
+
+	for (uint32_t i = 0; i < MAX_MAPPINGS; i++) {
+		if (_entries[i].state == ENTRY_MAPPED && _entries[i].references == 0) {
+			Evict(i);
+			evicted |= uint64_t(1) << i;
+		}
+	}
+
+	Unlock();
+	Unmap(evicted);
+}
@@ -0,0 +1,155 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYMAPPINGPOOL_H
+#define SMBB_SHAREDMEMORYMAPPINGPOOL_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemory.h"
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// A cache of shared memory section mappings, so that briefly mapping part of a large shared memory file does not map and unmap it every time
+//  (each unmap invalidates the TLB entries of every core running the process). Mappings are reference counted, and a mapping containing the requested range
+//  is reused. The least recently used unreferenced mappings are unmapped when the pool runs out of entries or exceeds its size limit.
+//  The pool is thread-safe, and mappings are only reused for the same opening of the shared memory (see SharedMemory::GetId()).
+//  The lock is never held while mapping or unmapping, so other threads are not held up by the system calls.
+class SharedMemoryMappingPool {
+public:
+	enum Result {
+		MAPPING_SUCCESS = 0,
+		MAPPING_FAILED_BAD_SIZE,
+		MAPPING_FAILED_TO_MAP,
+		MAPPING_FAILED_FULL // All mappings are in use and no more can be mapped without exceeding the limits of the pool
+	};
+
+	// The maximum number of mappings in a pool (at most 64, so that a set of entries fits in a mask)
+	static const uint32_t MAX_MAPPINGS = 64;
+
+	// A reference to part of a pooled mapping
+	class Mapping {
+		uint8_t *_data;
+		size_t _size;
+		uint32_t _index;
+
+	public:
+		Mapping() : _data(), _size(), _index() { }
+
+		// Returns true if the mapping is valid
+		bool Valid() const { return _data != NULL; }
+
+		// Gets the data pointer of the mapping
+		uint8_t *Data() const { return _data; }
+
+		// Gets the size of the mapping
+		size_t Size() const { return _size; }
+
+		friend class SharedMemoryMappingPool;
+	};
+
+private:
+	// The state of a pooled mapping
+	enum State {
+		ENTRY_FREE = 0,
+		ENTRY_MAPPING, // Reserved while it is mapped without holding the lock
+		ENTRY_MAPPED,
+		ENTRY_UNMAPPING // Reserved while it is unmapped without holding the lock
+	};
+
+	// A pooled mapping
+	struct Entry {
+		uint64_t memoryId;
+		uint32_t state;
+		uint32_t references;
+		uint64_t lastUse;
+	};
+
+	SharedMemorySection _sections[MAX_MAPPINGS];
+	Entry _entries[MAX_MAPPINGS];
+	Atomic<uint32_t> _lock;
+	size_t _maxSize;
+	Atomic<size_t> _mappedSize; // The mapped size and the hit and miss counts are changed with the pool locked, but can be read without it
+	uint64_t _uses;
+	Atomic<uint64_t> _hits;
+	Atomic<uint64_t> _misses;
+
+	// Disable copying
+	SharedMemoryMappingPool(const SharedMemoryMappingPool &);
+	SharedMemoryMappingPool &operator=(const SharedMemoryMappingPool &);
+
+	// Locks and unlocks the pool
+	void Lock() {
+		uint32_t expected = 0;
+
+		while (!_lock.CompareExchange(expected, 1, MEMORY_ORDER_ACQUIRE)) {
+			expected = 0;
+			CpuRelax();
+		}
+	}
+
+	void Unlock() { _lock.Store(0, MEMORY_ORDER_RELEASE); }
+
+	// Reserves an unreferenced entry to be unmapped (the pool must be locked)
+	void Evict(uint32_t index) {
+		_mappedSize.FetchSubtract(_sections[index].Size(), MEMORY_ORDER_RELAXED);
+		_entries[index].state = ENTRY_UNMAPPING;
+	}
+
+	// Unmaps the reserved entries in the mask (the pool must not be locked), then frees them
+	SMBB_INLINE void Unmap(uint64_t evicted);
+
+public:
+	// Creates a pool that keeps at most the specified number of bytes mapped (0 for no limit)
+	explicit SharedMemoryMappingPool(size_t maxSize = 0) : _sections(), _entries(), _lock(0), _maxSize(maxSize), _mappedSize(), _uses(), _hits(), _misses() { }
+
+	~SharedMemoryMappingPool() { Clear(); }
+
+	// Gets a mapping of the specified range of shared memory (the offset does not need to be aligned), reusing an existing mapping if possible
+	SMBB_INLINE Result Acquire(const SharedMemory &memory, size_t size, SharedMemory::Size offset, Mapping &mapping);
+
+	// Releases a mapping (the pool keeps the underlying mapping for reuse)
+	SMBB_INLINE void Release(Mapping &mapping);
+
+	// Unmaps all unreferenced mappings of the shared memory, returning false if any of its mappings are still referenced
+	SMBB_INLINE bool Remove(const SharedMemory &memory);
+
+	// Unmaps all unreferenced mappings
+	SMBB_INLINE void Clear();
+
+	// Gets the number of bytes currently mapped by the pool
+	size_t GetMappedSize() const { return _mappedSize.Load(MEMORY_ORDER_RELAXED); }
+
+	// Gets the number of requests that reused a mapping and the number that created a mapping
+	uint64_t GetHits() const { return _hits.Load(MEMORY_ORDER_RELAXED); }
+	uint64_t GetMisses() const { return _misses.Load(MEMORY_ORDER_RELAXED); }
+};
+
+}
+
+#endif
@@ -0,0 +1,432 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryMulticast.h"
+
+#include <cstring>
+
+// Writes a block into a packet, returning the size of the packet
+size_t smbb::SharedMemoryMulticast::WriteBlock(uint8_t *packet, PacketType type, uint64_t sequence, uint64_t index, const uint8_t *block, size_t blockSize) {
+	Packet header = { MAGIC, static_cast<uint32_t>(type), 0, 0, sequence, index };
+	uint8_t *payload = packet + PACKET_HEADER_SIZE;
+	size_t length = LZCodec::Compress(block, blockSize, payload, blockSize);
+
+	// Data that does not compress is sent as is
+	if (length == 0 || length >= blockSize) {
+		memcpy(payload, block, blockSize);
+		length = blockSize;
+		header.length = static_cast<uint32_t>(blockSize) | RAW_BLOCK;
+	}
+	else
+		header.length = static_cast<uint32_t>(length);
+
+	WritePacket(packet, header);
+	return PACKET_HEADER_SIZE + length;
+}
+
+// Sends a packet without data
+bool smbb::SharedMemoryMulticast::SendPacket(IPSocket socket, const IPAddress &address, PacketType type, uint64_t sequence, uint64_t index, uint32_t count) {
+	const Packet packet = { MAGIC, static_cast<uint32_t>(type), 0, count, sequence, index };
+	uint8_t data[PACKET_HEADER_SIZE];
+
+	WritePacket(data, packet);
+
+	const IPSocket::MessageResult result = socket.Send(data, sizeof(data), address);
+
+	return !result.Failed() || result.HasTemporarySendError();
+}
+
+// Creates a publisher for a region, using the specified array (of GetBlockCount() hashes) to track the blocks from the previous update and a history of GetHistorySize() bytes
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Publisher::Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint8_t *history, size_t historySize,
+		const IPSocket &socket, const IPAddress &group, uint32_t blockSize) {
+	_data = NULL;
+
+	if (!data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+	else if (size == 0 || !hashes || blockSize == 0 || blockSize > MAX_BLOCK_SIZE || hashCount < GetBlockCount(size, blockSize) || !history || historySize < GetHistorySize(SEND_BATCH, blockSize))
+		return MULTICAST_FAILED_BAD_SIZE;
+
+	_data = data;
+	_size = size;
+	_hashes = hashes;
+	_blockCount = GetBlockCount(size, blockSize);
+	_history = history;
+	_slotSize = GetHistorySize(1, blockSize);
+	_historyCount = historySize / _slotSize;
+	_blockSize = blockSize;
+	_sequence = 0;
+	_socket = socket;
+	_group = group;
+
+	memset(_hashes, 0, sizeof(uint64_t) * _blockCount);
+	memset(_history, 0, _historyCount * _slotSize);
+	return MULTICAST_SUCCESS;
+}
+
+// Multicasts the blocks that changed since the previous update followed by a heartbeat, returning the number of blocks sent if requested
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Publisher::Publish(size_t *blocksSent) {
+	IPSocket::Buffer buffers[SEND_BATCH];
+	IPSocket::MultiMessagePart parts[SEND_BATCH];
+	size_t count = 0;
+	size_t i = 0;
+
+	if (blocksSent)
+		*blocksSent = 0;
+
+	if (!_data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+
+	do {
+		uint32_t batch = 0;
+
+		// Each datagram is written into the history, so it can be retransmitted until it is overwritten
+		for (; i < _blockCount && batch < SEND_BATCH; i++) {
+			const size_t blockSize = GetBlockSize(_size, _blockSize, i);
+
+			// The block is copied first, so the hash always matches the data that is sent even if writers change the block
+			memcpy(_buffer, _data + i * _blockSize, blockSize);
+
+			const uint64_t hash = SharedMemoryCheckpoint::GetPageHash(_buffer, blockSize);
+
+			if (hash == _hashes[i])
+				continue;
+
+			uint8_t *slot = _history + static_cast<size_t>((_sequence + 1) % _historyCount) * _slotSize;
+
+			buffers[batch] = IPSocket::Buffer(slot, WriteBlock(slot, PACKET_DATA, ++_sequence, i, _buffer, blockSize));
+			parts[batch] = IPSocket::MultiMessagePart(&buffers[batch], 1, &_group);
+			_hashes[i] = hash;
+			batch++;
+		}
+
+		for (uint32_t sent = 0; sent < batch; ) {
+			const IPSocket::MessageResult result = _socket.SendMultiple(parts + sent, static_cast<IPSocket::ResultLength>(batch - sent));
+
+			// Datagrams dropped locally are recovered by NAKs, the same as datagrams lost on the network
+			if (result.Failed() && result.HasTemporarySendError())
+				break;
+			else if (result.Failed() || result.GetResult() == 0)
+				return MULTICAST_FAILED_TO_SEND;
+
+			sent += static_cast<uint32_t>(result.GetResult());
+		}
+
+		count += batch;
+	} while (i < _blockCount);
+
+	if (blocksSent)
+		*blocksSent = count;
+
+	return Heartbeat();
+}
+
+// Serves the NAKs and snapshot requests that have been received from subscribers, returning the number of requests served if requested
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Publisher::Serve(size_t *requestsServed) {
+	size_t count = 0;
+
+	if (requestsServed)
+		*requestsServed = 0;
+
+	if (!_data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+
+	for (;;) {
+		IPAddress from;
+		uint8_t data[PACKET_HEADER_SIZE];
+		const IPSocket::MessageResult result = _socket.Receive(data, sizeof(data), from);
+
+		if (result.Failed()) {
+			if (result.HasTemporaryReceiveError())
+				break;
+			else if (result.HasSizeError())
+				continue;
+
+			return MULTICAST_FAILED_TO_RECEIVE;
+		}
+		else if (result.GetResult() != static_cast<IPSocket::ResultLength>(sizeof(data)))
+			continue;
+
+		const Packet request = ReadPacket(data);
+
+		if (request.magic != MAGIC)
+			continue;
+
+		if (request.type == PACKET_NAK) {
+			const uint64_t last = request.sequence + (request.count < MAX_RETRANSMIT ? request.count : MAX_RETRANSMIT);
+
+			for (uint64_t sequence = request.sequence; sequence < last && sequence <= _sequence; sequence++) {
+				const uint8_t *slot = _history + static_cast<size_t>(sequence % _historyCount) * _slotSize;
+				const Packet header = ReadPacket(slot);
+
+				if (sequence == 0 || header.sequence != sequence) {
+					if (!SendPacket(_socket, from, PACKET_TOO_OLD, sequence, 0, 0))
+						return MULTICAST_FAILED_TO_SEND;
+
+					break;
+				}
+
+				const IPSocket::MessageResult sent = _socket.Send(slot, static_cast<IPSocket::DataLength>(PACKET_HEADER_SIZE + (header.length & ~RAW_BLOCK)), from);
+
+				if (sent.Failed() && !sent.HasTemporarySendError())
+					return MULTICAST_FAILED_TO_SEND;
+			}
+		}
+		else if (request.type == PACKET_SNAPSHOT_REQUEST) {
+			const uint64_t last = request.index + SNAPSHOT_BURST < _blockCount ? request.index + SNAPSHOT_BURST : _blockCount;
+
+			// Each block is read after the current sequence, so applying the datagrams after that sequence brings the snapshot up to date
+			for (uint64_t index = request.index; index < last; index++) {
+				const size_t blockSize = GetBlockSize(_size, _blockSize, index);
+				const size_t length = WriteBlock(_buffer, PACKET_SNAPSHOT, _sequence, index, _data + static_cast<size_t>(index) * _blockSize, blockSize);
+				const IPSocket::MessageResult sent = _socket.Send(_buffer, static_cast<IPSocket::DataLength>(length), from);
+
+				if (sent.Failed() && !sent.HasTemporarySendError())
+					return MULTICAST_FAILED_TO_SEND;
+			}
+		}
+		else
+			continue;
+
+		count++;
+	}
+
+	if (requestsServed)
+		*requestsServed = count;
+
+	return count ? MULTICAST_SUCCESS : MULTICAST_EMPTY;
+}
+
+// Requests the missing datagrams (up to the specified sequence)
+bool smbb::SharedMemoryMulticast::Subscriber::RequestRetransmit(uint64_t last) {
+	const uint64_t first = _requested >= _next ? _requested + 1 : _next;
+
+	if (last < first)
+		return true;
+
+	_requested = last;
+	_naks++;
+	return SendPacket(_socket, _publisher, PACKET_NAK, first, 0, static_cast<uint32_t>(last - first + 1 < MAX_RETRANSMIT ? last - first + 1 : MAX_RETRANSMIT));
+}
+
+// Requests the blocks of a snapshot starting at the specified block
+bool smbb::SharedMemoryMulticast::Subscriber::RequestSnapshot(uint64_t block) {
+	if (block == 0) {
+		_next = 0;
+		_snapshotSequence = ~uint64_t(0);
+		_snapshots++;
+	}
+
+	_snapshotting = true;
+	_snapshotBlock = block;
+	return SendPacket(_socket, _publisher, PACKET_SNAPSHOT_REQUEST, 0, block, 0);
+}
+
+// Applies the data of a block, returning false if it is corrupt
+bool smbb::SharedMemoryMulticast::Subscriber::Apply(const Packet &packet, size_t length) {
+	if (packet.index >= _blockCount || length != (packet.length & ~RAW_BLOCK))
+		return false;
+
+	const size_t blockSize = GetBlockSize(_size, _blockSize, packet.index);
+	const uint8_t *payload = _buffer + PACKET_HEADER_SIZE;
+	uint8_t *destination = _data + static_cast<size_t>(packet.index) * _blockSize;
+	size_t decompressed = 0;
+
+	if (packet.length & RAW_BLOCK) {
+		if (length != blockSize)
+			return false;
+
+		memcpy(destination, payload, length);
+		return true;
+	}
+
+	return LZCodec::Decompress(payload, length, destination, blockSize, decompressed) && decompressed == blockSize;
+}
+
+// Creates a subscriber for a region with the same size and block size as the publisher
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Subscriber::Create(uint8_t *data, size_t size, const IPSocket &socket, uint32_t blockSize) {
+	_data = NULL;
+
+	if (!data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+	else if (size == 0 || blockSize == 0 || blockSize > MAX_BLOCK_SIZE)
+		return MULTICAST_FAILED_BAD_SIZE;
+
+	_data = data;
+	_size = size;
+	_blockCount = GetBlockCount(size, blockSize);
+	_blockSize = blockSize;
+	_socket = socket;
+	_hasPublisher = false;
+	_snapshotting = false;
+	_next = 0;
+	_latest = 0;
+	_requested = 0;
+	_naks = 0;
+	_snapshots = 0;
+	return MULTICAST_SUCCESS;
+}
+
+// Receives and applies all of the available datagrams, sending any NAKs or snapshot requests, returning the number of blocks applied if requested
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Subscriber::Receive(size_t *blocksApplied) {
+	size_t received = 0;
+	size_t applied = 0;
+	bool sent = true;
+
+	if (blocksApplied)
+		*blocksApplied = 0;
+
+	if (!_data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+
+	for (;;) {
+		IPAddress from;
+		const IPSocket::MessageResult result = _socket.Receive(_buffer, sizeof(_buffer), from);
+
+		if (result.Failed()) {
+			if (result.HasTemporaryReceiveError())
+				break;
+			else if (result.HasSizeError())
+				continue;
+
+			return MULTICAST_FAILED_TO_RECEIVE;
+		}
+		else if (result.GetResult() < static_cast<IPSocket::ResultLength>(PACKET_HEADER_SIZE))
+			continue;
+
+		const Packet packet = ReadPacket(_buffer);
+
+		if (packet.magic != MAGIC)
+			continue;
+
+		// The publisher is the source of the first data or heartbeat datagram
+		if (!_hasPublisher) {
+			if (packet.type != PACKET_DATA && packet.type != PACKET_HEARTBEAT)
+				continue;
+
+			_publisher = from;
+			_hasPublisher = true;
+		}
+		else if (!(from == _publisher))
+			continue;
+
+		const size_t length = static_cast<size_t>(result.GetResult()) - PACKET_HEADER_SIZE;
+
+		received++;
+
+		switch (packet.type) {
+		case PACKET_HEARTBEAT:
+			if (packet.index != _size || packet.count != _blockSize)
+				return MULTICAST_FAILED_MISMATCH;
+
+			_latest = packet.sequence > _latest ? packet.sequence : _latest;
+
+			if (_next == 0 && !_snapshotting)
+				sent = RequestSnapshot(0) && sent;
+			else if (_next != 0 && _latest >= _next)
+				sent = RequestRetransmit(_latest) && sent;
+
+			break;
+
+		case PACKET_DATA:
+			_latest = packet.sequence > _latest ? packet.sequence : _latest;
+
+			if (_next == 0) {
+				if (!_snapshotting)
+					sent = RequestSnapshot(0) && sent;
+			}
+			else if (packet.sequence == _next) {
+				// A corrupt datagram is treated as lost, so it is requested again
+				if (Apply(packet, length)) {
+					_next++;
+					applied++;
+				}
+				else if (_requested >= _next)
+					_requested = _next - 1;
+			}
+			else if (packet.sequence > _next) // Datagrams are only applied in order, so a later datagram is requested again along with the missing datagrams
+				sent = RequestRetransmit(packet.sequence) && sent;
+
+			break;
+
+		case PACKET_TOO_OLD:
+			if (_next != 0 && packet.sequence >= _next)
+				sent = RequestSnapshot(0) && sent;
+
+			break;
+
+		case PACKET_SNAPSHOT:
+			if (!_snapshotting || packet.index != _snapshotBlock || !Apply(packet, length))
+				break;
+
+			_snapshotSequence = packet.sequence < _snapshotSequence ? packet.sequence : _snapshotSequence;
+			_snapshotBlock++;
+			applied++;
+
+			if (_snapshotBlock == _blockCount) {
+				_snapshotting = false;
+				_next = _snapshotSequence + 1;
+				_requested = _snapshotSequence;
+				_latest = _snapshotSequence > _latest ? _snapshotSequence : _latest;
+
+				if (_latest >= _next)
+					sent = RequestRetransmit(_latest) && sent;
+			}
+			else if (_snapshotBlock % SNAPSHOT_BURST == 0)
+				sent = RequestSnapshot(_snapshotBlock) && sent;
+
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (blocksApplied)
+		*blocksApplied = applied;
+
+	if (!sent)
+		return MULTICAST_FAILED_TO_SEND;
+
+	return received ? MULTICAST_SUCCESS : MULTICAST_EMPTY;
+}
+
+// Repeats any outstanding NAK or snapshot request (call when nothing has been received for a while, since requests and retransmits can also be lost)
+smbb::SharedMemoryMulticast::Result smbb::SharedMemoryMulticast::Subscriber::Retry() {
+	if (!_data)
+		return MULTICAST_FAILED_BAD_MEMORY;
+	else if (!_hasPublisher)
+		return MULTICAST_SUCCESS;
+
+	bool sent = true;
+
+	if (_snapshotting)
+		sent = RequestSnapshot(_snapshotBlock);
+	else if (_next == 0)
+		sent = RequestSnapshot(0);
+	else if (_latest >= _next) {
+		_requested = _next - 1;
+		sent = RequestRetransmit(_latest);
+	}
+
+	return sent ? MULTICAST_SUCCESS : MULTICAST_FAILED_TO_SEND;
+}
@@ -0,0 +1,251 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYMULTICAST_H
+#define SMBB_SHAREDMEMORYMULTICAST_H
+
+#include <cstdlib>
+
+#include "utilities/ByteOrder.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "IPAddress.h"
+#include "IPSocket.h"
+#include "LZCodec.h"
+#include "SharedMemoryCheckpoint.h"
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// Replicates a region of shared memory to any number of hosts using UDP multicast.
+//  The publisher multicasts each changed block (compressed using LZCodec) as a datagram with a sequence number, so its cost does not depend on the number of subscribers.
+//  A subscriber that detects a gap in the sequence sends a NAK to the publisher, which retransmits the missing datagrams from its history by unicast.
+//  A subscriber that joins late (or falls behind the history) requests a snapshot of every block by unicast, then catches up from the sequence of the snapshot.
+//  Both sides are driven by the caller (using non-blocking sockets), so they can share a thread with other work.
+//  Datagram headers are sent in network byte order, so the publisher and subscribers can have different byte orders.
+class SharedMemoryMulticast {
+public:
+	enum Result {
+		MULTICAST_SUCCESS = 0,
+		MULTICAST_EMPTY, // No datagrams were available
+		MULTICAST_FAILED_BAD_MEMORY,
+		MULTICAST_FAILED_BAD_SIZE,
+		MULTICAST_FAILED_MISMATCH,
+		MULTICAST_FAILED_TO_SEND,
+		MULTICAST_FAILED_TO_RECEIVE
+	};
+
+	// The default size of each block (so each datagram fits in a typical Ethernet MTU)
+	static const uint32_t DEFAULT_BLOCK_SIZE = 1024;
+
+	// The maximum size of each block
+	static const uint32_t MAX_BLOCK_SIZE = 8192;
+
+	// The number of datagrams sent by each send call
+	static const uint32_t SEND_BATCH = 32;
+
+	// The maximum number of blocks sent in response to each snapshot request
+	static const uint32_t SNAPSHOT_BURST = 64;
+
+	// The maximum number of datagrams retransmitted in response to each NAK
+	static const uint32_t MAX_RETRANSMIT = 256;
+
+private:
+	static const uint32_t MAGIC = 0x534D4247; // "SMBG"
+
+	// The flag on the length of a block that indicates that it is sent uncompressed
+	static const uint32_t RAW_BLOCK = 0x80000000;
+
+	enum PacketType {
+		PACKET_DATA = 1, // A changed block (multicast, or unicast as a retransmit)
+		PACKET_HEARTBEAT, // The last sequence sent, with the size of the region as the index and the block size as the count
+		PACKET_NAK, // A request for count datagrams starting at the sequence
+		PACKET_TOO_OLD, // The requested datagrams are no longer in the history
+		PACKET_SNAPSHOT_REQUEST, // A request for the blocks starting at the index
+		PACKET_SNAPSHOT // A block of a snapshot, with the last sequence sent before it was read
+	};
+
+	// The header of each datagram (followed by the block data for data and snapshot datagrams)
+	struct Packet {
+		uint32_t magic;
+		uint32_t type;
+		uint32_t length;
+		uint32_t count;
+		uint64_t sequence;
+		uint64_t index;
+	};
+
+	// The size of the header of each datagram, which holds the fields of a packet in order, in network byte order
+	static const size_t PACKET_HEADER_SIZE = 32;
+
+	// The maximum size of a datagram
+	static const size_t MAX_PACKET_SIZE = PACKET_HEADER_SIZE + MAX_BLOCK_SIZE;
+
+	// Writes the header of a datagram
+	static void WritePacket(uint8_t *data, const Packet &packet) {
+		StoreNetworkOrder(data, packet.magic);
+		StoreNetworkOrder(data + 4, packet.type);
+		StoreNetworkOrder(data + 8, packet.length);
+		StoreNetworkOrder(data + 12, packet.count);
+		StoreNetworkOrder(data + 16, packet.sequence);
+		StoreNetworkOrder(data + 24, packet.index);
+	}
+
+	// Reads the header of a datagram
+	static Packet ReadPacket(const uint8_t *data) {
+		const Packet packet = { LoadNetworkOrder<uint32_t>(data), LoadNetworkOrder<uint32_t>(data + 4), LoadNetworkOrder<uint32_t>(data + 8),
+			LoadNetworkOrder<uint32_t>(data + 12), LoadNetworkOrder<uint64_t>(data + 16), LoadNetworkOrder<uint64_t>(data + 24) };
+
+		return packet;
+	}
+
+	// Gets the size of a block (the last block may be partial)
+	static size_t GetBlockSize(size_t size, uint32_t blockSize, uint64_t index) {
+		const size_t offset = static_cast<size_t>(index) * blockSize;
+		return size - offset < blockSize ? size - offset : blockSize;
+	}
+
+	// Writes a block into a packet, returning the size of the packet
+	static SMBB_INLINE size_t WriteBlock(uint8_t *packet, PacketType type, uint64_t sequence, uint64_t index, const uint8_t *block, size_t blockSize);
+
+	// Sends a packet without data
+	static SMBB_INLINE bool SendPacket(IPSocket socket, const IPAddress &address, PacketType type, uint64_t sequence, uint64_t index, uint32_t count);
+
+public:
+	// Gets the number of blocks (and block hashes) required for a region of the specified size
+	static size_t GetBlockCount(size_t size, uint32_t blockSize = DEFAULT_BLOCK_SIZE) { return blockSize ? (size + blockSize - 1) / blockSize : 0; }
+
+	// Gets the size of the history required to retransmit the specified number of datagrams
+	static size_t GetHistorySize(uint32_t datagrams, uint32_t blockSize = DEFAULT_BLOCK_SIZE) { return ((PACKET_HEADER_SIZE + blockSize + 7) & ~size_t(7)) * datagrams; }
+
+	// Multicasts the changed blocks of a region, and serves retransmits and snapshots to subscribers
+	class Publisher {
+		const uint8_t *_data;
+		size_t _size;
+		uint64_t *_hashes;
+		size_t _blockCount;
+		uint8_t *_history;
+		size_t _historyCount;
+		size_t _slotSize;
+		uint32_t _blockSize;
+		uint64_t _sequence;
+		IPSocket _socket;
+		IPAddress _group;
+		uint8_t _buffer[MAX_PACKET_SIZE]; // Holds a copy of each block being published, or a snapshot datagram
+
+	public:
+		Publisher() : _data(), _size(), _hashes(), _blockCount(), _history(), _historyCount(), _slotSize(), _blockSize(), _sequence(), _socket(), _group() { }
+
+		// Creates a publisher for a region, using the specified array (of GetBlockCount() hashes) to track the blocks from the previous update and a history of GetHistorySize() bytes
+		//  (the socket should be non-blocking, and the group can be any address, though it is normally a multicast address)
+		SMBB_INLINE Result Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint8_t *history, size_t historySize,
+			const IPSocket &socket, const IPAddress &group, uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+
+		// Creates a publisher for the shared memory section
+		Result Create(const SharedMemorySection &section, uint64_t *hashes, size_t hashCount, uint8_t *history, size_t historySize,
+				const IPSocket &socket, const IPAddress &group, uint32_t blockSize = DEFAULT_BLOCK_SIZE) {
+			return Create(section.Data(), section.Size(), hashes, hashCount, history, historySize, socket, group, blockSize);
+		}
+
+		// Returns true if the publisher has been created
+		bool Valid() const { return _data != NULL; }
+
+		// Gets the sequence of the last datagram sent
+		uint64_t GetSequence() const { return _sequence; }
+
+		// Multicasts the blocks that changed since the previous update followed by a heartbeat, returning the number of blocks sent if requested
+		SMBB_INLINE Result Publish(size_t *blocksSent = NULL);
+
+		// Multicasts a heartbeat, so subscribers can detect lost datagrams while no blocks change
+		Result Heartbeat() { return !_data ? MULTICAST_FAILED_BAD_MEMORY : SendPacket(_socket, _group, PACKET_HEARTBEAT, _sequence, _size, _blockSize) ? MULTICAST_SUCCESS : MULTICAST_FAILED_TO_SEND; }
+
+		// Serves the NAKs and snapshot requests that have been received from subscribers, returning the number of requests served if requested
+		SMBB_INLINE Result Serve(size_t *requestsServed = NULL);
+	};
+
+	// Receives the blocks multicast by a publisher into a copy of the region
+	class Subscriber {
+		uint8_t *_data;
+		size_t _size;
+		size_t _blockCount;
+		uint32_t _blockSize;
+		IPSocket _socket;
+		IPAddress _publisher;
+		bool _hasPublisher;
+		bool _snapshotting;
+		uint64_t _next; // The next sequence to apply (0 until a snapshot has completed)
+		uint64_t _latest; // The latest sequence known to be sent
+		uint64_t _requested; // The latest sequence requested by a NAK
+		uint64_t _snapshotSequence;
+		uint64_t _snapshotBlock;
+		uint64_t _naks;
+		uint64_t _snapshots;
+		uint8_t _buffer[MAX_PACKET_SIZE];
+
+		// Requests the missing datagrams (up to the specified sequence)
+		SMBB_INLINE bool RequestRetransmit(uint64_t last);
+
+		// Requests the blocks of a snapshot starting at the specified block
+		SMBB_INLINE bool RequestSnapshot(uint64_t block);
+
+		// Applies the data of a block, returning false if it is corrupt
+		SMBB_INLINE bool Apply(const Packet &packet, size_t length);
+
+	public:
+		Subscriber() : _data(), _size(), _blockCount(), _blockSize(), _socket(), _publisher(), _hasPublisher(), _snapshotting(),
+			_next(), _latest(), _requested(), _snapshotSequence(), _snapshotBlock(), _naks(), _snapshots() { }
+
+		// Creates a subscriber for a region with the same size and block size as the publisher
+		//  (the socket should be non-blocking, and bound or subscribed to the group of the publisher)
+		SMBB_INLINE Result Create(uint8_t *data, size_t size, const IPSocket &socket, uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+
+		// Creates a subscriber for the shared memory section
+		Result Create(const SharedMemorySection &section, const IPSocket &socket, uint32_t blockSize = DEFAULT_BLOCK_SIZE) {
+			return section.ReadOnly() ? MULTICAST_FAILED_BAD_MEMORY : Create(section.Data(), section.Size(), socket, blockSize);
+		}
+
+		// Returns true if the subscriber has been created
+		bool Valid() const { return _data != NULL; }
+
+		// Returns true if the copy of the region is up to date with all of the datagrams known to be sent
+		bool IsSynchronized() const { return _next != 0 && _next > _latest; }
+
+		// Gets the sequence of the last datagram applied (0 if not yet synchronized)
+		uint64_t GetSequence() const { return _next ? _next - 1 : 0; }
+
+		// Gets the number of NAKs sent and the number of snapshots started
+		uint64_t GetNAKs() const { return _naks; }
+		uint64_t GetSnapshots() const { return _snapshots; }
+
+		// Receives and applies all of the available datagrams, sending any NAKs or snapshot requests, returning the number of blocks applied if requested
+		SMBB_INLINE Result Receive(size_t *blocksApplied = NULL);
+
+		// Repeats any outstanding NAK or snapshot request (call when nothing has been received for a while, since requests and retransmits can also be lost)
+		SMBB_INLINE Result Retry();
+	};
+};
+
+}
+
+#endif
@@ -0,0 +1,218 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryReplicator.h"
+
+#include <cstring>
+
+// Creates a receiver for a region with the same size and block size as the sender, using a workspace of GetWorkspaceSize() bytes
+smbb::SharedMemoryReplicator::Result smbb::SharedMemoryReplicator::Receiver::Create(uint8_t *data, size_t size, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize) {
+	_data = NULL;
+
+	if (!data)
+		return REPLICATOR_FAILED_BAD_MEMORY;
+	else if (size == 0 || blockSize == 0 || blockSize > MAX_BLOCK_SIZE || !workspace || workspaceSize < GetWorkspaceSize(blockSize))
+		return REPLICATOR_FAILED_BAD_SIZE;
+
+	_data = data;
+	_size = size;
+	_workspace = workspace;
+	_blockSize = blockSize;
+	_sequence = 0;
+	return REPLICATOR_SUCCESS;
+}
+
+// Receives and applies the next update, returning the number of blocks that changed if requested
+smbb::SharedMemoryReplicator::Result smbb::SharedMemoryReplicator::Receiver::Receive(const Endpoint &source, size_t *blocksReceived) {
+	const size_t blockCount = GetBlockCount(_size, _blockSize);
+	uint8_t header[UPDATE_HEADER_SIZE];
+	size_t count = 0;
+
+	if (blocksReceived)
+		*blocksReceived = 0;
+
+	if (!_data)
+		return REPLICATOR_FAILED_BAD_MEMORY;
+	else if (!source.Read(header, sizeof(header)))
+		return REPLICATOR_FAILED_TO_READ;
+
+	const uint64_t sequence = LoadNetworkOrder<uint64_t>(header + 8);
+
+	if (LoadNetworkOrder<uint32_t>(header) != MAGIC || LoadNetworkOrder<uint32_t>(header + 4) != VERSION)
+		return REPLICATOR_FAILED_BAD_DATA;
+	else if (LoadNetworkOrder<uint64_t>(header + 16) != _size || LoadNetworkOrder<uint32_t>(header + 24) != _blockSize)
+		return REPLICATOR_FAILED_MISMATCH;
+	else if ((LoadNetworkOrder<uint32_t>(header + 28) & FULL_UPDATE) == 0 && sequence != _sequence + 1)
+		return REPLICATOR_FAILED_OUT_OF_ORDER;
+
+	for (;;) {
+		uint8_t block[BLOCK_HEADER_SIZE];
+
+		if (!source.Read(block, sizeof(block)))
+			return REPLICATOR_FAILED_TO_READ;
+
+		const uint64_t index = LoadNetworkOrder<uint64_t>(block);
+		const uint32_t blockLength = LoadNetworkOrder<uint32_t>(block + 8);
+
+		if (index == END_INDEX) {
+			if (blockLength != count)
+				return REPLICATOR_FAILED_BAD_DATA;
+
+			break;
+		}
+		else if (index >= blockCount)
+			return REPLICATOR_FAILED_BAD_DATA;
+
+		uint8_t *destination = _data + static_cast<size_t>(index) * _blockSize;
+		const size_t blockSize = GetBlockSize(_size, _blockSize, index);
+		const uint32_t length = blockLength & ~RAW_BLOCK;
+
+		if (blockLength & RAW_BLOCK) {
+			if (length != blockSize)
+				return REPLICATOR_FAILED_BAD_DATA;
+			else if (!source.Read(destination, length))
+				return REPLICATOR_FAILED_TO_READ;
+		}
+		else {
+			size_t decompressed = 0;
+
+			if (length > LZCodec::GetMaxCompressedSize(_blockSize))
+				return REPLICATOR_FAILED_BAD_DATA;
+			else if (!source.Read(_workspace, length))
+				return REPLICATOR_FAILED_TO_READ;
+			else if (!LZCodec::Decompress(_workspace, length, destination, blockSize, decompressed) || decompressed != blockSize)
+				return REPLICATOR_FAILED_BAD_DATA;
+		}
+
+		count++;
+	}
+
+	if (blocksReceived)
+		*blocksReceived = count;
+
+	_sequence = sequence;
+	return REPLICATOR_SUCCESS;
+}
+
+// Creates a replicator for a region, using the specified array (of GetBlockCount() hashes) to track the blocks from the previous update and a workspace of GetWorkspaceSize() bytes
+smbb::SharedMemoryReplicator::Result smbb::SharedMemoryReplicator::Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize) {
+	_data = NULL;
+
+	if (!data)
+		return REPLICATOR_FAILED_BAD_MEMORY;
+	else if (size == 0 || !hashes || blockSize == 0 || blockSize > MAX_BLOCK_SIZE || hashCount < GetBlockCount(size, blockSize) || !workspace || workspaceSize < GetWorkspaceSize(blockSize))
+		return REPLICATOR_FAILED_BAD_SIZE;
+
+	_data = data;
+	_size = size;
+	_hashes = hashes;
+	_blockCount = GetBlockCount(size, blockSize);
+	_workspace = workspace;
+	_blockSize = blockSize;
+	_sequence = 0;
+	Invalidate();
+	return REPLICATOR_SUCCESS;
+}
+
+// Forgets the previous update, so that the next update sends every block (e.g. for a new connection)
+void smbb::SharedMemoryReplicator::Invalidate() {
+	if (_hashes)
+		memset(_hashes, 0, sizeof(uint64_t) * _blockCount);
+
+	_full = true;
+}
+
+// Sends an update of the blocks that changed since the previous update, returning the number of blocks sent if requested (after a failure, the next update sends every block)
+smbb::SharedMemoryReplicator::Result smbb::SharedMemoryReplicator::Send(const Endpoint &destination, size_t *blocksSent) {
+	uint8_t *copy = _workspace;
+	uint8_t *message = _workspace + _blockSize;
+	const size_t messageSize = BLOCK_HEADER_SIZE + LZCodec::GetMaxCompressedSize(_blockSize);
+	uint8_t header[UPDATE_HEADER_SIZE];
+	uint32_t count = 0;
+
+	if (blocksSent)
+		*blocksSent = 0;
+
+	if (!_data)
+		return REPLICATOR_FAILED_BAD_MEMORY;
+
+	StoreNetworkOrder(header, MAGIC);
+	StoreNetworkOrder(header + 4, VERSION);
+	StoreNetworkOrder(header + 8, _sequence + 1);
+	StoreNetworkOrder(header + 16, static_cast<uint64_t>(_size));
+	StoreNetworkOrder(header + 24, _blockSize);
+	StoreNetworkOrder(header + 28, _full ? FULL_UPDATE : uint32_t(0));
+
+	if (!destination.Write(header, sizeof(header))) {
+		Invalidate();
+		return REPLICATOR_FAILED_TO_WRITE;
+	}
+
+	for (size_t i = 0; i < _blockCount; i++) {
+		const uint8_t *block = _data + i * _blockSize;
+		const size_t blockSize = GetBlockSize(_size, _blockSize, i);
+
+		if (SharedMemoryCheckpoint::GetPageHash(block, blockSize) == _hashes[i])
+			continue;
+
+		// The block is copied, so the sent data and the saved hash match even if the block is being modified
+		uint8_t *compressed = message + BLOCK_HEADER_SIZE;
+		const size_t compressedSize = LZCodec::Compress(static_cast<const uint8_t *>(memcpy(copy, block, blockSize)), blockSize, compressed, messageSize - BLOCK_HEADER_SIZE);
+		uint32_t length;
+
+		// Data that does not compress is sent as is
+		if (compressedSize == 0 || compressedSize >= blockSize) {
+			length = static_cast<uint32_t>(blockSize);
+			memcpy(compressed, copy, blockSize);
+			SetBlockHeader(message, i, length | RAW_BLOCK);
+		}
+		else {
+			length = static_cast<uint32_t>(compressedSize);
+			SetBlockHeader(message, i, length);
+		}
+
+		if (!destination.Write(message, BLOCK_HEADER_SIZE + length)) {
+			Invalidate();
+			return REPLICATOR_FAILED_TO_WRITE;
+		}
+
+		_hashes[i] = SharedMemoryCheckpoint::GetPageHash(copy, blockSize);
+		count++;
+	}
+
+	uint8_t end[BLOCK_HEADER_SIZE];
+
+	SetBlockHeader(end, END_INDEX, count);
+
+	if (!destination.Write(end, sizeof(end))) {
+		Invalidate();
+		return REPLICATOR_FAILED_TO_WRITE;
+	}
+
+	if (blocksSent)
+		*blocksSent = count;
+
+	_sequence++;
+	_full = false;
+	return REPLICATOR_SUCCESS;
+}
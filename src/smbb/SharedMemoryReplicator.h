@@ -0,0 +1,170 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYREPLICATOR_H
+#define SMBB_SHAREDMEMORYREPLICATOR_H
+
+#include <cstdlib>
+
+#include "utilities/ByteOrder.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "LZCodec.h"
+#include "SharedMemoryCheckpoint.h"
+#include "SharedMemorySection.h"
+#include "SharedMemoryStream.h"
+
+namespace smbb {
+
+// Replicates a region of shared memory to a copy on another host (e.g. a hot standby) over a TCP connection.
+//  The sender keeps the hash of each block from the previous update, so each update only sends the blocks that changed (compressed using LZCodec).
+//  Each update has a sequence number, and the first update on a connection (or after Invalidate()) sends every block.
+//  The receiver applies blocks as they arrive, so its copy is only consistent with the sender after an update completes.
+//  The headers are sent in network byte order, so the sender and receiver can have different byte orders.
+class SharedMemoryReplicator {
+public:
+	enum Result {
+		REPLICATOR_SUCCESS = 0,
+		REPLICATOR_FAILED_BAD_MEMORY,
+		REPLICATOR_FAILED_BAD_SIZE,
+		REPLICATOR_FAILED_BAD_DATA,
+		REPLICATOR_FAILED_MISMATCH,
+		REPLICATOR_FAILED_OUT_OF_ORDER,
+		REPLICATOR_FAILED_TO_READ,
+		REPLICATOR_FAILED_TO_WRITE
+	};
+
+	// The default size of each block
+	static const uint32_t DEFAULT_BLOCK_SIZE = 4096;
+
+	// The maximum size of each block
+	static const uint32_t MAX_BLOCK_SIZE = 1U << 24;
+
+	// The destination or source of updates
+	typedef SharedMemoryStream::Endpoint Endpoint;
+
+private:
+	static const uint32_t MAGIC = 0x534D4255; // "SMBU"
+	static const uint32_t VERSION = 1;
+
+	// The flag on an update that sends every block
+	static const uint32_t FULL_UPDATE = 1;
+
+	// The flag on the length of a block that indicates that it is sent uncompressed
+	static const uint32_t RAW_BLOCK = 0x80000000;
+
+	// The block index that marks the end of an update
+	static const uint64_t END_INDEX = ~uint64_t(0);
+
+	// The size of the header of each update (the magic, version, 64-bit sequence, 64-bit region size, block size, then flags)
+	static const size_t UPDATE_HEADER_SIZE = 32;
+
+	// The size of the header of each block (the 64-bit index, length, then a reserved word), followed by the block data.
+	//  The end of an update is marked by a block header with END_INDEX and the number of blocks as the length.
+	static const size_t BLOCK_HEADER_SIZE = 16;
+
+	const uint8_t *_data;
+	size_t _size;
+	uint64_t *_hashes;
+	size_t _blockCount;
+	uint8_t *_workspace;
+	uint32_t _blockSize;
+	uint64_t _sequence;
+	bool _full;
+
+	// Writes the header of a block
+	static void SetBlockHeader(uint8_t *header, uint64_t index, uint32_t length) {
+		StoreNetworkOrder(header, index);
+		StoreNetworkOrder(header + 8, length);
+		StoreNetworkOrder(header + 12, uint32_t(0));
+	}
+
+	// Gets the size of a block (the last block may be partial)
+	static size_t GetBlockSize(size_t size, uint32_t blockSize, uint64_t index) {
+		const size_t offset = static_cast<size_t>(index) * blockSize;
+		return size - offset < blockSize ? size - offset : blockSize;
+	}
+
+public:
+	// Receives updates from a replicator into a copy of the region
+	class Receiver {
+		uint8_t *_data;
+		size_t _size;
+		uint8_t *_workspace;
+		uint32_t _blockSize;
+		uint64_t _sequence;
+
+	public:
+		Receiver() : _data(), _size(), _workspace(), _blockSize(), _sequence() { }
+
+		// Creates a receiver for a region with the same size and block size as the sender, using a workspace of GetWorkspaceSize() bytes
+		SMBB_INLINE Result Create(uint8_t *data, size_t size, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+
+		// Creates a receiver for the shared memory section
+		Result Create(const SharedMemorySection &section, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize = DEFAULT_BLOCK_SIZE) {
+			return section.ReadOnly() ? REPLICATOR_FAILED_BAD_MEMORY : Create(section.Data(), section.Size(), workspace, workspaceSize, blockSize);
+		}
+
+		// Returns true if the receiver has been created
+		bool Valid() const { return _data != NULL; }
+
+		// Gets the sequence number of the last complete update (0 if no update has completed)
+		uint64_t GetSequence() const { return _sequence; }
+
+		// Receives and applies the next update, returning the number of blocks that changed if requested
+		SMBB_INLINE Result Receive(const Endpoint &source, size_t *blocksReceived = NULL);
+	};
+
+	// Gets the number of blocks (and block hashes) required for a region of the specified size
+	static size_t GetBlockCount(size_t size, uint32_t blockSize = DEFAULT_BLOCK_SIZE) { return blockSize ? (size + blockSize - 1) / blockSize : 0; }
+
+	// Gets the size of the workspace required by a sender or receiver
+	static size_t GetWorkspaceSize(uint32_t blockSize = DEFAULT_BLOCK_SIZE) { return blockSize + BLOCK_HEADER_SIZE + LZCodec::GetMaxCompressedSize(blockSize); }
+
+	SharedMemoryReplicator() : _data(), _size(), _hashes(), _blockCount(), _workspace(), _blockSize(), _sequence(), _full() { }
+
+	// Creates a replicator for a region, using the specified array (of GetBlockCount() hashes) to track the blocks from the previous update and a workspace of GetWorkspaceSize() bytes
+	SMBB_INLINE Result Create(const uint8_t *data, size_t size, uint64_t *hashes, size_t hashCount, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize = DEFAULT_BLOCK_SIZE);
+
+	// Creates a replicator for the shared memory section
+	Result Create(const SharedMemorySection &section, uint64_t *hashes, size_t hashCount, uint8_t *workspace, size_t workspaceSize, uint32_t blockSize = DEFAULT_BLOCK_SIZE) {
+		return Create(section.Data(), section.Size(), hashes, hashCount, workspace, workspaceSize, blockSize);
+	}
+
+	// Returns true if the replicator has been created
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the sequence number of the last update sent (0 if no update has been sent)
+	uint64_t GetSequence() const { return _sequence; }
+
+	// Forgets the previous update, so that the next update sends every block (e.g. for a new connection)
+	SMBB_INLINE void Invalidate();
+
+	// Sends an update of the blocks that changed since the previous update, returning the number of blocks sent if requested (after a failure, the next update sends every block)
+	SMBB_INLINE Result Send(const Endpoint &destination, size_t *blocksSent = NULL);
+};
+
+}
+
+#endif
@@ -0,0 +1,501 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryRing.h"
+
+#include <cstring>
+
+// Attaches to an initialized ring
+void smbb::SharedMemoryRing::Attach(uint8_t *data, bool readOnly) {
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	_data = data;
+	_slotSize = header->slotSize;
+	_slotCount = header->slotCount;
+	_payloads = data + sizeof(Header) + sizeof(Slot) * _slotCount;
+	_owner = 0;
+	_readOnly = readOnly;
+}
+
+// Moves an overrun position forward to the oldest position that could still be available
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Overrun(uint64_t &position) const {
+	const uint64_t claim = GetHeader()->claim.Load(MEMORY_ORDER_ACQUIRE);
+
+	if (claim > _slotCount && claim - _slotCount > position)
+		position = claim - _slotCount;
+	else
+		position++;
+
+	return RING_OVERRUN;
+}
+
+// Creates a new ring in the specified memory (which should be cache-line aligned), overwriting any existing content
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Create(uint8_t *data, size_t size, uint32_t slotSize, uint32_t slotCount) {
+	_data = NULL;
+
+	if (!data || !ValidSlots(slotSize, slotCount) || slotCount > size / (sizeof(Slot) + slotSize) || size < GetRequiredSize(slotSize, slotCount))
+		return RING_FAILED_BAD_SIZE;
+
+	Header *header = reinterpret_cast<Header *>(data);
+
+	memset(data, 0, sizeof(Header) + sizeof(Slot) * slotCount);
+	header->version = VERSION;
+	header->slotSize = slotSize;
+	header->slotCount = slotCount;
+	header->ownedFrom.Store(NOT_OWNED, MEMORY_ORDER_RELAXED);
+
+	// Publish the ring last, so that it is never seen partially initialized
+	header->magic.Store(MAGIC, MEMORY_ORDER_RELEASE);
+
+	Attach(data, false);
+	return RING_SUCCESS;
+}
+
+// Opens an existing ring in the specified memory
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Open(uint8_t *data, size_t size, bool readOnly) {
+	_data = NULL;
+
+	if (!data || size < sizeof(Header))
+		return RING_FAILED_BAD_MEMORY;
+
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	if (header->magic.Load(MEMORY_ORDER_ACQUIRE) != MAGIC || header->version != VERSION || !ValidSlots(header->slotSize, header->slotCount) ||
+			header->slotCount > size / (sizeof(Slot) + header->slotSize) || size < GetRequiredSize(header->slotSize, header->slotCount))
+		return RING_FAILED_BAD_MEMORY;
+
+	Attach(data, readOnly);
+	return RING_SUCCESS;
+}
+
+// Claims a number of consecutive positions for writing, waiting for any slow producer still writing to the slots a full ring earlier
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Claim(uint64_t &position, uint32_t count) {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return RING_FAILED_READ_ONLY;
+	else if (count == 0 || count > _slotCount)
+		return RING_FAILED_TOO_LARGE;
+
+	Header *header = GetHeader();
+	Slot *slots = GetSlots();
+
+	if (!CanClaim(header->owner.Load(MEMORY_ORDER_ACQUIRE)))
+		return RING_FAILED_OWNED;
+
+	position = header->claim.FetchAdd(count, MEMORY_ORDER_SEQUENTIAL);
+
+	// The ring may have been owned since it was checked, in which case the owner does not wait for these positions so they are aborted instead
+	const bool owned = !CanClaim(header->owner.Load(MEMORY_ORDER_SEQUENTIAL));
+
+	for (uint64_t i = position; i < position + count; i++) {
+		Atomic<uint64_t> &sequence = slots[GetIndex(i)].sequence;
+		const uint64_t previous = i < _slotCount ? 0 : GetPublishedSequence(i - _slotCount);
+		uint64_t current;
+
+		while ((current = sequence.Load(MEMORY_ORDER_ACQUIRE)) < previous)
+			CpuRelax();
+
+		if (owned) {
+			// The position may already have been aborted by a process recovering the ring
+			if (current == previous)
+				(void)AbortSlot(i, previous);
+		}
+		else {
+			// Mark the slot as being written before any of the payload is modified
+			sequence.Store(GetPublishedSequence(i) - 1, MEMORY_ORDER_RELAXED);
+			AtomicFence(MEMORY_ORDER_RELEASE);
+		}
+	}
+
+	return owned ? RING_FAILED_OWNED : RING_SUCCESS;
+}
+
+// Publishes a claimed position with the length of the payload and all flags
+void smbb::SharedMemoryRing::PublishSlot(uint64_t position, uint32_t length, uint32_t flags) {
+	Header *header = GetHeader();
+	Slot &slot = GetSlots()[GetIndex(position)];
+
+	slot.length = length < _slotSize ? length : _slotSize;
+	slot.flags = flags;
+	slot.sequence.Store(GetPublishedSequence(position), MEMORY_ORDER_RELEASE);
+	(void)header->notifier.value.FetchAdd(1, MEMORY_ORDER_RELEASE);
+}
+
+// Writes a message to a single slot
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Write(const void *data, uint32_t length, uint32_t flags) {
+	uint64_t position;
+
+	if (_data && length > _slotSize)
+		return RING_FAILED_TOO_LARGE;
+
+	Result result = Claim(position);
+
+	if (result != RING_SUCCESS)
+		return result;
+
+	memcpy(GetPayload(position), data, length);
+	Publish(position, length, flags);
+	return RING_SUCCESS;
+}
+
+// Writes a message of any size (up to the size of the ring), fragmenting it across consecutive slots if it is larger than a slot
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::WriteMessage(const void *data, uint32_t length, uint32_t flags) {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+
+	const uint64_t slots = length == 0 ? 1 : (static_cast<uint64_t>(length) + _slotSize - 1) / _slotSize;
+
+	if (slots > _slotCount)
+		return RING_FAILED_TOO_LARGE;
+
+	uint64_t position;
+	Result result = Claim(position, static_cast<uint32_t>(slots));
+
+	if (result != RING_SUCCESS)
+		return result;
+
+	const uint8_t *source = static_cast<const uint8_t *>(data);
+
+	flags &= USER_FLAGS_MASK;
+
+	// Every fragment except the last is a full slot, so the fragments of a message that does not wrap are contiguous
+	for (uint32_t i = 0, offset = 0; i < slots; i++, offset += _slotSize) {
+		const uint32_t fragmentLength = length - offset < _slotSize ? length - offset : _slotSize;
+
+		memcpy(GetPayload(position + i), source + offset, fragmentLength);
+		PublishSlot(position + i, fragmentLength, flags | (i + 1 < slots ? FLAG_CONTINUED : 0) | (i > 0 ? FLAG_CONTINUATION : 0));
+	}
+
+	return RING_SUCCESS;
+}
+
+// Peeks at the message at a position without copying it (the message must be checked with Validate() after it is used)
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Peek(uint64_t &position, const uint8_t *&data, uint32_t &length, uint32_t &flags) const {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+
+	const Slot &slot = GetSlots()[GetIndex(position)];
+	const uint64_t sequence = slot.sequence.Load(MEMORY_ORDER_ACQUIRE);
+	const uint64_t published = GetPublishedSequence(position);
+
+	if (sequence == published) {
+		const uint32_t slotLength = slot.length;
+
+		data = GetPayload(position);
+		length = slotLength < _slotSize ? slotLength : _slotSize;
+		flags = slot.flags;
+
+		if ((flags & FLAG_ABORTED) != 0) {
+			position++;
+			return RING_ABORTED;
+		}
+
+		return RING_SUCCESS;
+	}
+	else if (sequence < published)
+		return RING_EMPTY;
+
+	return Overrun(position);
+}
+
+// Reads the message at a position into the buffer, moving the position to the next message
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Read(uint64_t &position, void *buffer, uint32_t bufferSize, uint32_t &length, uint32_t *flags) const {
+	const uint8_t *data;
+	uint32_t slotFlags;
+	Result result = Peek(position, data, length, slotFlags);
+
+	if (result != RING_SUCCESS)
+		return result;
+	else if (length > bufferSize)
+		return RING_FAILED_TOO_LARGE;
+
+	memcpy(buffer, data, length);
+
+	// The slot was overwritten while it was being copied
+	if (!Validate(position))
+		return Overrun(position);
+
+	if (flags)
+		*flags = slotFlags;
+
+	position++;
+	return RING_SUCCESS;
+}
+
+// Peeks at a complete (possibly fragmented) message without copying it if its fragments do not wrap, otherwise the fragments are reassembled into the buffer
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::PeekMessage(uint64_t &position, const uint8_t *&data, uint32_t &length, uint32_t &flags, uint32_t &slots, void *buffer, uint32_t bufferSize) const {
+	const uint8_t *fragment;
+	uint32_t fragmentLength;
+	uint32_t fragmentFlags;
+	Result result = Peek(position, fragment, fragmentLength, fragmentFlags);
+
+	if (result != RING_SUCCESS)
+		return result;
+
+	// The position is in the middle of a message (after an overrun), so skip the fragment
+	if ((fragmentFlags & FLAG_CONTINUATION) != 0) {
+		position++;
+		return RING_OVERRUN;
+	}
+
+	data = fragment;
+	length = fragmentLength;
+	flags = fragmentFlags & USER_FLAGS_MASK;
+	slots = 1;
+
+	while ((fragmentFlags & FLAG_CONTINUED) != 0) {
+		uint64_t next = position + slots;
+
+		// Every fragment except the last fills its slot, so a shorter length was torn by a producer overwriting the slot
+		if (slots >= _slotCount || fragmentLength != _slotSize)
+			return Overrun(position);
+
+		result = Peek(next, fragment, fragmentLength, fragmentFlags);
+
+		// The remaining fragments have not been published yet
+		if (result == RING_EMPTY)
+			return RING_EMPTY;
+		else if (result == RING_ABORTED) { // The producer died while writing the message, so skip the published fragments
+			position = next;
+			return RING_ABORTED;
+		}
+		else if (result != RING_SUCCESS || (fragmentFlags & FLAG_CONTINUATION) == 0)
+			return Overrun(position);
+
+		length += fragmentLength;
+		slots++;
+	}
+
+	// Reassemble the fragments if they wrap around the end of the ring
+	if (GetIndex(position) + slots > _slotCount) {
+		if (!buffer || length > bufferSize)
+			return RING_FAILED_TOO_LARGE;
+
+		uint8_t *destination = static_cast<uint8_t *>(buffer);
+
+		for (uint32_t i = 0, offset = 0; i < slots && offset < length; i++, offset += _slotSize)
+			memcpy(destination + offset, GetPayload(position + i), length - offset < _slotSize ? length - offset : _slotSize);
+
+		data = destination;
+	}
+
+	return RING_SUCCESS;
+}
+
+// Reads the complete (possibly fragmented) message at a position into the buffer, moving the position to the next message
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::ReadMessage(uint64_t &position, void *buffer, uint32_t bufferSize, uint32_t &length, uint32_t *flags) const {
+	const uint8_t *data;
+	uint32_t messageFlags;
+	uint32_t slots;
+	Result result = PeekMessage(position, data, length, messageFlags, slots, buffer, bufferSize);
+
+	if (result != RING_SUCCESS)
+		return result;
+	else if (length > bufferSize)
+		return RING_FAILED_TOO_LARGE;
+
+	if (data != buffer)
+		memcpy(buffer, data, length);
+
+	// One of the slots was overwritten while it was being copied
+	if (!ValidateMessage(position, slots))
+		return Overrun(position);
+
+	if (flags)
+		*flags = messageFlags;
+
+	position += slots;
+	return RING_SUCCESS;
+}
+
+// Wakes any consumers parked on the notifier (only needed if consumers use a WaitStrategy that parks, and only makes a system call if one is parked)
+void smbb::SharedMemoryRing::Wake() {
+	if (_data)
+		WaitStrategy::Wake(GetHeader()->notifier);
+}
+
+// Returns true if the position has been claimed by a producer that is no longer running
+bool smbb::SharedMemoryRing::IsStalled(uint64_t position) const {
+	const Header *header = GetHeader();
+	const ProcessOwner::Owner owner = header->owner.Load(MEMORY_ORDER_ACQUIRE);
+	const uint32_t index = GetIndex(position);
+
+	// Only the oldest unpublished position of a slot is stalled; later positions using the slot are waiting for it
+	return owner != 0 && position >= header->ownedFrom.Load(MEMORY_ORDER_ACQUIRE) && position < header->claim.Load(MEMORY_ORDER_ACQUIRE) &&
+		GetUnpublishedPosition(index, GetSlots()[index].sequence.Load(MEMORY_ORDER_ACQUIRE)) == position && !ProcessOwner::IsAlive(owner);
+}
+
+// Publishes an empty aborted message at a claimed position, returning false if the slot was changed by another producer first
+bool smbb::SharedMemoryRing::AbortSlot(uint64_t position, uint64_t sequence) {
+	Slot &slot = GetSlots()[GetIndex(position)];
+	uint64_t writing = GetPublishedSequence(position) - 1;
+
+	// Mark the slot as being written before it is modified, as consumers may still be reading the message a full ring earlier
+	if (sequence != writing) {
+		if (!slot.sequence.CompareExchange(sequence, writing, MEMORY_ORDER_ACQUIRE_RELEASE))
+			return false;
+
+		AtomicFence(MEMORY_ORDER_RELEASE);
+	}
+
+	// A recovering process and a producer aborting its own claim write the same values, so either one can complete the abort
+	slot.length = 0;
+	slot.flags = FLAG_ABORTED;
+
+	if (!slot.sequence.CompareExchange(writing, GetPublishedSequence(position), MEMORY_ORDER_RELEASE))
+		return false;
+
+	(void)GetHeader()->notifier.value.FetchAdd(1, MEMORY_ORDER_RELEASE);
+	return true;
+}
+
+// Aborts the oldest unpublished position of each slot while it was claimed by the owner, returning the number of aborted slots
+uint32_t smbb::SharedMemoryRing::AbortOwned() {
+	Header *header = GetHeader();
+	const uint64_t ownedFrom = header->ownedFrom.Load(MEMORY_ORDER_ACQUIRE);
+	const uint64_t claim = header->claim.Load(MEMORY_ORDER_ACQUIRE);
+	uint32_t count = 0;
+
+	if (ownedFrom == NOT_OWNED)
+		return 0;
+
+	// The position held by each slot is known from its sequence, so a position is never aborted on behalf of the position a full ring earlier.
+	//  Every position before the owner took ownership was published, so any later unpublished position was claimed by the owner (or by a producer aborting its own claim).
+	for (uint32_t index = 0; index < _slotCount; index++) {
+		Atomic<uint64_t> &sequence = GetSlots()[index].sequence;
+
+		for (;;) {
+			const uint64_t current = sequence.Load(MEMORY_ORDER_ACQUIRE);
+			const uint64_t position = GetUnpublishedPosition(index, current);
+
+			if (position < ownedFrom || position >= claim)
+				break;
+			else if (AbortSlot(position, current))
+				count++;
+		}
+	}
+
+	return count;
+}
+
+// Waits until every position before the end has been published
+void smbb::SharedMemoryRing::WaitForPublished(uint64_t end) const {
+	for (uint32_t index = 0; index < _slotCount; index++) {
+		const Atomic<uint64_t> &sequence = GetSlots()[index].sequence;
+
+		while (GetUnpublishedPosition(index, sequence.Load(MEMORY_ORDER_ACQUIRE)) < end)
+			CpuRelax();
+	}
+}
+
+// Takes ownership of the ring for the current process, recovering the ring first if the previous owner is no longer running
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::TakeOwnership() {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return RING_FAILED_READ_ONLY;
+
+	Header *header = GetHeader();
+	const ProcessOwner::Owner current = ProcessOwner::GetCurrent();
+	ProcessOwner::Owner previous = header->owner.Load(MEMORY_ORDER_ACQUIRE);
+
+	if (previous != current) {
+		if ((previous != 0 && ProcessOwner::IsAlive(previous)) || !header->owner.CompareExchange(previous, current, MEMORY_ORDER_SEQUENTIAL))
+			return RING_FAILED_OWNED;
+
+		// Any later claim by a producer that has not taken ownership sees the new owner and is aborted by that producer
+		const uint64_t claim = header->claim.Load(MEMORY_ORDER_SEQUENTIAL);
+
+		// Abort the claims of the previous owner so that no earlier claims are blocked behind them, then wait for the remaining earlier claims to be published
+		(void)AbortOwned();
+		header->ownedFrom.Store(NOT_OWNED, MEMORY_ORDER_RELEASE);
+		WaitForPublished(claim);
+		header->ownedFrom.Store(claim, MEMORY_ORDER_RELEASE);
+	}
+
+	_owner = current;
+	return RING_SUCCESS;
+}
+
+// Releases ownership of the ring, if it is owned by the current process
+void smbb::SharedMemoryRing::ReleaseOwnership() {
+	if (_data && !_readOnly) {
+		Header *header = GetHeader();
+		ProcessOwner::Owner current = ProcessOwner::GetCurrent();
+
+		if (header->owner.Load(MEMORY_ORDER_ACQUIRE) == current) {
+			header->ownedFrom.Store(NOT_OWNED, MEMORY_ORDER_RELEASE);
+			(void)header->owner.CompareExchange(current, 0, MEMORY_ORDER_RELEASE);
+		}
+
+		_owner = 0;
+	}
+}
+
+// Aborts any slots that were claimed but never published by an owner that is no longer running, returning the number of aborted slots
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::Recover(uint32_t *aborted) {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return RING_FAILED_READ_ONLY;
+
+	Header *header = GetHeader();
+	ProcessOwner::Owner owner = header->owner.Load(MEMORY_ORDER_ACQUIRE);
+
+	if (aborted)
+		*aborted = 0;
+
+	// Slots can only be safely aborted if the owner is no longer running
+	if (owner == 0)
+		return RING_SUCCESS;
+	else if (ProcessOwner::IsAlive(owner))
+		return RING_FAILED_OWNED;
+
+	// The ring is owned while it is recovered, so that no other process can recover it or take ownership at the same time
+	const ProcessOwner::Owner current = ProcessOwner::GetCurrent();
+
+	if (!header->owner.CompareExchange(owner, current, MEMORY_ORDER_SEQUENTIAL))
+		return RING_FAILED_OWNED;
+
+	const uint32_t count = AbortOwned();
+
+	header->ownedFrom.Store(NOT_OWNED, MEMORY_ORDER_RELEASE);
+	header->owner.Store(0, MEMORY_ORDER_RELEASE);
+
+	if (aborted)
+		*aborted = count;
+
+	return RING_SUCCESS;
+}
+
+// Skips the message at a position if it was claimed by an owner that is no longer running and was never published (for consumers that can not recover the ring)
+smbb::SharedMemoryRing::Result smbb::SharedMemoryRing::SkipStalled(uint64_t &position) const {
+	if (!_data)
+		return RING_FAILED_BAD_MEMORY;
+	else if (!IsStalled(position))
+		return RING_EMPTY;
+
+	position++;
+	return RING_ABORTED;
+}
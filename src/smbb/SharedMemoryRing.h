@@ -0,0 +1,263 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYRING_H
+#define SMBB_SHAREDMEMORYRING_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "ProcessOwner.h"
+#include "WaitStrategy.h"
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// A broadcast ring of fixed-size slots stored in shared memory.
+//  Any number of producers can write to the ring, and any number of consumers (which can use a read-only mapping) read it independently using their own position.
+//  Producers never wait for consumers; a consumer that falls more than a full ring behind is told that it was overrun and skips ahead.
+//  The slot payloads are stored contiguously, so consecutive slots that do not wrap can be read as a single block.
+//  Messages larger than a slot are fragmented across consecutive slots, and are read in place unless they wrap around the end of the ring.
+//  A producer can take ownership of the ring, so that if it dies in the middle of a write, consumers can skip the unpublished slots and a new producer can take over.
+//  While the ring is owned, only producers that have taken ownership (which is per process) can claim positions, so that recovery never aborts a claim of a running producer.
+class SharedMemoryRing {
+public:
+	enum Result {
+		RING_SUCCESS = 0,
+		RING_EMPTY, // No message is available at the position yet
+		RING_OVERRUN, // The message at the position was overwritten; the position was moved forward to the oldest available message
+		RING_ABORTED, // The message at the position was abandoned by a producer that died; the position was moved past it
+		RING_FAILED_BAD_MEMORY,
+		RING_FAILED_BAD_SIZE,
+		RING_FAILED_OWNED,
+		RING_FAILED_READ_ONLY,
+		RING_FAILED_TOO_LARGE
+	};
+
+	// The size that slot sizes must be a multiple of
+	static const uint32_t SLOT_ALIGNMENT = 8;
+
+	// The flags available to users (the remaining flags are used for fragmentation)
+	static const uint32_t USER_FLAGS_MASK = 0x1FFFFFFF;
+
+private:
+	static const uint32_t MAGIC = 0x534D4252; // "SMBR"
+	static const uint32_t VERSION = 1;
+
+	static const uint32_t FLAG_CONTINUED = 0x80000000; // More fragments of the message follow this slot
+	static const uint32_t FLAG_CONTINUATION = 0x40000000; // The slot is not the first fragment of a message
+	static const uint32_t FLAG_ABORTED = 0x20000000; // The slot was claimed by a producer that died before publishing it
+
+	static const uint64_t NOT_OWNED = ~uint64_t(0);
+
+	// The layout of the ring header in shared memory (the claim position is on its own cache line)
+	struct Header {
+		Atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t slotSize;
+		uint32_t slotCount;
+		Atomic<uint64_t> owner;
+		Atomic<uint64_t> ownedFrom; // The first position that can be claimed by the owner (or NOT_OWNED)
+		uint32_t reserved[8];
+
+		Atomic<uint64_t> claim;
+		WaitStrategy::Signal notifier;
+		uint32_t reserved2[12];
+	};
+
+	// The state of a slot in shared memory (the sequence is odd while the slot is being written, and even once it is published)
+	struct Slot {
+		Atomic<uint64_t> sequence;
+		uint32_t length;
+		uint32_t flags;
+	};
+
+	uint8_t *_data;
+	uint8_t *_payloads;
+	uint32_t _slotSize;
+	uint32_t _slotCount;
+	ProcessOwner::Owner _owner;
+	bool _readOnly;
+
+	// Gets the header and slots of the ring
+	Header *GetHeader() const { return reinterpret_cast<Header *>(_data); }
+	Slot *GetSlots() const { return reinterpret_cast<Slot *>(_data + sizeof(Header)); }
+
+	// Gets the slot index of a position
+	uint32_t GetIndex(uint64_t position) const { return static_cast<uint32_t>(position) & (_slotCount - 1); }
+
+	// Gets the sequence of a published position
+	static uint64_t GetPublishedSequence(uint64_t position) { return position * 2 + 2; }
+
+	// Gets the oldest unpublished position that uses a slot, based on the sequence of the slot
+	//  (A slot being written holds the position being written; otherwise the next position to use it is a full ring after the last one published.)
+	uint64_t GetUnpublishedPosition(uint32_t index, uint64_t sequence) const {
+		return (sequence & 1) ? sequence / 2 : sequence == 0 ? index : sequence / 2 - 1 + _slotCount;
+	}
+
+	// Checks if a slot size and count is valid
+	static bool ValidSlots(uint32_t slotSize, uint32_t slotCount) {
+		return slotSize != 0 && slotSize % SLOT_ALIGNMENT == 0 && slotCount != 0 && (slotCount & (slotCount - 1)) == 0;
+	}
+
+	// Checks if this producer can claim positions in a ring with the specified owner
+	bool CanClaim(ProcessOwner::Owner owner) const { return owner == 0 || owner == _owner; }
+
+	// Attaches to an initialized ring
+	SMBB_INLINE void Attach(uint8_t *data, bool readOnly);
+
+	// Moves an overrun position forward to the oldest position that could still be available
+	SMBB_INLINE Result Overrun(uint64_t &position) const;
+
+	// Publishes a claimed position with the length of the payload and all flags
+	SMBB_INLINE void PublishSlot(uint64_t position, uint32_t length, uint32_t flags);
+
+	// Returns true if the position has been claimed by a producer that is no longer running
+	SMBB_INLINE bool IsStalled(uint64_t position) const;
+
+	// Publishes an empty aborted message at a claimed position, returning false if the slot was changed by another producer first
+	SMBB_INLINE bool AbortSlot(uint64_t position, uint64_t sequence);
+
+	// Aborts the oldest unpublished position of each slot while it was claimed by the owner, returning the number of aborted slots
+	SMBB_INLINE uint32_t AbortOwned();
+
+	// Waits until every position before the end has been published
+	SMBB_INLINE void WaitForPublished(uint64_t end) const;
+
+public:
+	// Gets the size required for a ring with the specified slot size (a multiple of SLOT_ALIGNMENT) and slot count (a power of 2)
+	static size_t GetRequiredSize(uint32_t slotSize, uint32_t slotCount) {
+		return sizeof(Header) + (sizeof(Slot) + static_cast<size_t>(slotSize)) * slotCount;
+	}
+
+	SharedMemoryRing() : _data(), _payloads(), _slotSize(), _slotCount(), _owner(), _readOnly() { }
+
+	// Creates a new ring in the specified memory (which should be cache-line aligned), overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t slotSize, uint32_t slotCount);
+
+	// Creates a new ring at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t slotSize, uint32_t slotCount) {
+		return section.ReadOnly() ? RING_FAILED_READ_ONLY : Create(section.Data(), section.Size(), slotSize, slotCount);
+	}
+
+	// Opens an existing ring in the specified memory
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing ring at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the ring has been created or opened
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the size of each slot
+	uint32_t GetSlotSize() const { return _slotSize; }
+
+	// Gets the number of slots
+	uint32_t GetSlotCount() const { return _slotCount; }
+
+	// Gets the next position that will be claimed by a producer (a new consumer starts here to receive only new messages)
+	uint64_t GetWritePosition() const { return _data ? GetHeader()->claim.Load(MEMORY_ORDER_ACQUIRE) : 0; }
+
+	// Gets a signal whose value changes each time a message is published (for use with WaitStrategy)
+	//  (A consumer with a read-only mapping can only wait on the value, so it is not woken by Wake() until its park timeout expires.)
+	WaitStrategy::Signal &GetNotifier() const { return GetHeader()->notifier; }
+
+	// Claims a number of consecutive positions for writing, waiting for any slow producer still writing to the slots a full ring earlier
+	//  (Fails with RING_FAILED_OWNED if the ring is owned by another process.)
+	SMBB_INLINE Result Claim(uint64_t &position, uint32_t count = 1);
+
+	// Gets the payload of a claimed position
+	uint8_t *GetPayload(uint64_t position) const { return _payloads + static_cast<size_t>(_slotSize) * GetIndex(position); }
+
+	// Publishes a claimed position with the length of the payload (which must be no larger than the slot size) and user flags
+	void Publish(uint64_t position, uint32_t length, uint32_t flags = 0) { PublishSlot(position, length, flags & USER_FLAGS_MASK); }
+
+	// Writes a message to a single slot
+	SMBB_INLINE Result Write(const void *data, uint32_t length, uint32_t flags = 0);
+
+	// Writes a message of any size (up to the size of the ring), fragmenting it across consecutive slots if it is larger than a slot
+	SMBB_INLINE Result WriteMessage(const void *data, uint32_t length, uint32_t flags = 0);
+
+	// Peeks at the message at a position without copying it (the message must be checked with Validate() after it is used)
+	SMBB_INLINE Result Peek(uint64_t &position, const uint8_t *&data, uint32_t &length, uint32_t &flags) const;
+
+	// Returns true if the message at the position has not been overwritten since it was peeked
+	bool Validate(uint64_t position) const {
+		AtomicFence(MEMORY_ORDER_ACQUIRE);
+		return GetSlots()[GetIndex(position)].sequence.Load(MEMORY_ORDER_RELAXED) == GetPublishedSequence(position);
+	}
+
+	// Reads the message at a position into the buffer, moving the position to the next message
+	SMBB_INLINE Result Read(uint64_t &position, void *buffer, uint32_t bufferSize, uint32_t &length, uint32_t *flags = NULL) const;
+
+	// Peeks at a complete (possibly fragmented) message without copying it if its fragments do not wrap, otherwise the fragments are reassembled into the buffer.
+	//  The number of slots used by the message is returned, and the message must be checked with ValidateMessage() after it is used.
+	SMBB_INLINE Result PeekMessage(uint64_t &position, const uint8_t *&data, uint32_t &length, uint32_t &flags, uint32_t &slots, void *buffer = NULL, uint32_t bufferSize = 0) const;
+
+	// Returns true if none of the slots of the message at the position have been overwritten since it was peeked
+	bool ValidateMessage(uint64_t position, uint32_t slots) const {
+		const Slot *slotArray = GetSlots();
+
+		AtomicFence(MEMORY_ORDER_ACQUIRE);
+
+		for (uint32_t i = 0; i < slots; i++) {
+			if (slotArray[GetIndex(position + i)].sequence.Load(MEMORY_ORDER_RELAXED) != GetPublishedSequence(position + i))
+				return false;
+		}
+
+		return true;
+	}
+
+	// Reads the complete (possibly fragmented) message at a position into the buffer, moving the position to the next message
+	SMBB_INLINE Result ReadMessage(uint64_t &position, void *buffer, uint32_t bufferSize, uint32_t &length, uint32_t *flags = NULL) const;
+
+	// Wakes any consumers parked on the notifier (only needed if consumers use a WaitStrategy that parks, and only makes a system call if one is parked)
+	SMBB_INLINE void Wake();
+
+	// Gets the producer that owns the ring (or 0 if the ring is not owned)
+	ProcessOwner::Owner GetOwner() const { return _data ? GetHeader()->owner.Load(MEMORY_ORDER_ACQUIRE) : 0; }
+
+	// Takes ownership of the ring for the current process, recovering the ring first if the previous owner is no longer running
+	//  (Producers that do not take ownership can only write to the ring while it is not owned, and can not be recovered if they die.
+	//   Taking ownership waits for any such producer to finish publishing its claims.)
+	SMBB_INLINE Result TakeOwnership();
+
+	// Releases ownership of the ring, if it is owned by the current process
+	SMBB_INLINE void ReleaseOwnership();
+
+	// Aborts any slots that were claimed but never published by an owner that is no longer running, returning the number of aborted slots
+	//  (The ring is no longer owned once it has been recovered.)
+	SMBB_INLINE Result Recover(uint32_t *aborted = NULL);
+
+	// Skips the message at a position if it was claimed by an owner that is no longer running and was never published (for consumers that can not recover the ring)
+	SMBB_INLINE Result SkipStalled(uint64_t &position) const;
+};
+
+}
+
+#endif
@@ -31,6 +31,10 @@ SOFTWARE.
 #else
 #include <unistd.h>
 #include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
 #endif
 #endif
 
@@ -83,18 +87,89 @@ private:
 	size_t _size;
 	SharedMemory::Size _offset;
 	bool _readOnly;
+	bool _mirrored;
+
+#if !defined(SMBB_NO_SHARED_MEMORY)
+	// Maps the section twice, back to back, so that the second mapping mirrors the first
+	void MapMirrored(const SharedMemory &sharedMemory) {
+		if (_size % GetOffsetSize() != 0 || _size > size_t(-1) / 2)
+			return;
+
+#if defined(_WIN32)
+		// Reserve the address space for both mappings and release it immediately, since another thread may take the space before it is mapped (so retry a few times)
+		for (int i = 0; i < 16 && !_data; i++) {
+			uint8_t *address = (uint8_t *)VirtualAlloc(NULL, _size * 2, MEM_RESERVE, PAGE_NOACCESS);
+
+			if (!address || !VirtualFree(address, 0, MEM_RELEASE))
+				return;
+
+			const DWORD access = _readOnly ? FILE_MAP_READ : FILE_MAP_WRITE;
+			uint8_t *first = (uint8_t *)MapViewOfFileEx(sharedMemory._mapHandle, access, (DWORD)(_offset >> 32), (DWORD)_offset, (SIZE_T)_size, address);
+
+			if (first != address)
+				continue;
+
+			if ((uint8_t *)MapViewOfFileEx(sharedMemory._mapHandle, access, (DWORD)(_offset >> 32), (DWORD)_offset, (SIZE_T)_size, address + _size) != address + _size) {
+				(void)UnmapViewOfFile(first);
+				continue;
+			}
+
+			_data = address;
+		}
+#else
+		// Reserve the address space for both mappings, then replace each half with a mapping of the shared memory
+		const int protection = PROT_READ | (_readOnly ? 0 : PROT_WRITE);
+		uint8_t *address = (uint8_t *)mmap(NULL, _size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (address == MAP_FAILED)
+			return;
+
+		if (mmap(address, _size, protection, MAP_SHARED | MAP_FIXED, sharedMemory._handle, _offset) == MAP_FAILED ||
+				mmap(address + _size, _size, protection, MAP_SHARED | MAP_FIXED, sharedMemory._handle, _offset) == MAP_FAILED) {
+			(void)munmap(address, _size * 2);
+			return;
+		}
+
+		_data = address;
+#endif
+	}
+#endif
 
 	// Disable copying
 	SharedMemorySection(const SharedMemorySection &) { }
 	SharedMemorySection &operator=(const SharedMemorySection &) { return *this; }
 
 public:
+	// Creates an unmapped section
+	SharedMemorySection() : _data(), _size(), _offset(), _readOnly(), _mirrored() { }
+
 	// Maps a new section from shared memory (Note that the section is still valid even if the shared memory is closed)
-	SharedMemorySection(const SharedMemory &sharedMemory, size_t size, SharedMemory::Size offset = 0) :
-		_data(), _size(size), _offset(offset), _readOnly(sharedMemory._readOnly) {
+	//  A mirrored section is mapped twice, back to back, so any access of up to the section size starting within the section is contiguous, even across the end.
+	//  (The size of a mirrored section must be a multiple of GetOffsetSize(), and Data() is valid for twice the size.)
+	SharedMemorySection(const SharedMemory &sharedMemory, size_t size, SharedMemory::Size offset = 0, bool mirrored = false) :
+			_data(), _size(), _offset(), _readOnly(), _mirrored() {
+		(void)Map(sharedMemory, size, offset, mirrored);
+	}
+
+	~SharedMemorySection() { Unmap(); }
+
+	// Maps the section from shared memory, replacing any existing mapping, returning true if successful (see the constructor for details)
+	bool Map(const SharedMemory &sharedMemory, size_t size, SharedMemory::Size offset = 0, bool mirrored = false) {
+		Unmap();
+
+		_size = size;
+		_offset = offset;
+		_readOnly = sharedMemory._readOnly;
+		_mirrored = mirrored;
+
 #if !defined(SMBB_NO_SHARED_MEMORY)
 		if (!_size)
-			return;
+			return false;
+
+		if (_mirrored) {
+			MapMirrored(sharedMemory);
+			return _data != NULL;
+		}
 
 #if defined(_WIN32)
 		_data = (uint8_t *)MapViewOfFile(sharedMemory._mapHandle, _readOnly ? FILE_MAP_READ : FILE_MAP_WRITE, (DWORD)(_offset >> 32), (DWORD)_offset, (SIZE_T)_size);
@@ -105,18 +180,25 @@ public:
 			_data = NULL;
 #endif
 #endif
+		return _data != NULL;
 	}
 
-	~SharedMemorySection() {
+	// Unmaps the section
+	void Unmap() {
 #if !defined(SMBB_NO_SHARED_MEMORY)
 #if defined(_WIN32)
-		if (_data)
+		if (_data) {
 			(void)UnmapViewOfFile(_data);
+
+			if (_mirrored)
+				(void)UnmapViewOfFile(_data + _size);
+		}
 #else
 		if (_data)
-			(void)munmap(_data, _size);
+			(void)munmap(_data, _mirrored ? _size * 2 : _size);
 #endif
 #endif
+		_data = NULL;
 	}
 
 	// Returns true if the section is valid
@@ -133,6 +215,9 @@ public:
 
 	// Returns true if the mapped data is read only
 	bool ReadOnly() const { return _readOnly; }
+
+	// Returns true if the section is mirrored (the mapped data is followed by a second mapping of the same data)
+	bool Mirrored() const { return _mirrored; }
 };
 
 }
@@ -0,0 +1,457 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMemoryStream.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// The threads that process the jobs of a stream, which are started once and fed the jobs of each batch through a queue
+class smbb::SharedMemoryStream::Workers {
+	// The queue holds the jobs of both batches
+	static const uint32_t QUEUE_SIZE = 2 * MAX_THREADS;
+
+#if defined(_WIN32)
+	HANDLE _threads[MAX_THREADS];
+	SRWLOCK _lock;
+	CONDITION_VARIABLE _queued;
+	CONDITION_VARIABLE _done;
+
+	static DWORD WINAPI Main(LPVOID workers) { static_cast<Workers *>(workers)->Process(); return 0; }
+
+	void Lock() { AcquireSRWLockExclusive(&_lock); }
+	void Unlock() { ReleaseSRWLockExclusive(&_lock); }
+	void Wait(CONDITION_VARIABLE &condition) { (void)SleepConditionVariableSRW(&condition, &_lock, INFINITE, 0); }
+	void WakeAll(CONDITION_VARIABLE &condition) { WakeAllConditionVariable(&condition); }
+#else
+	pthread_t _threads[MAX_THREADS];
+	pthread_mutex_t _lock;
+	pthread_cond_t _queued;
+	pthread_cond_t _done;
+
+	static void *Main(void *workers) { static_cast<Workers *>(workers)->Process(); return NULL; }
+
+	void Lock() { (void)pthread_mutex_lock(&_lock); }
+	void Unlock() { (void)pthread_mutex_unlock(&_lock); }
+	void Wait(pthread_cond_t &condition) { (void)pthread_cond_wait(&condition, &_lock); }
+	void WakeAll(pthread_cond_t &condition) { (void)pthread_cond_broadcast(&condition); }
+#endif
+	Job *_queue[QUEUE_SIZE];
+	uint32_t _head;
+	uint32_t _tail;
+	uint32_t _count;
+	bool _stopping;
+
+	// Disable copying
+	Workers(const Workers &);
+	Workers &operator=(const Workers &);
+
+	// Runs queued jobs until the workers are stopped and the queue is empty
+	void Process() {
+		Lock();
+
+		for (;;) {
+			while (_head == _tail && !_stopping)
+				Wait(_queued);
+
+			if (_head == _tail)
+				break;
+
+			Job &job = *_queue[_head++ % QUEUE_SIZE];
+
+			Unlock();
+			Run(job);
+			Lock();
+
+			job.done = true;
+			WakeAll(_done);
+		}
+
+		Unlock();
+	}
+
+public:
+	// Starts the worker threads (a single thread is the calling thread, so no workers are started)
+	explicit Workers(uint32_t threads) : _threads(), _queue(), _head(), _tail(), _count(), _stopping() {
+#if defined(_WIN32)
+		InitializeSRWLock(&_lock);
+		InitializeConditionVariable(&_queued);
+		InitializeConditionVariable(&_done);
+
+		while (threads > 1 && _count < threads && (_threads[_count] = CreateThread(NULL, 0, Main, this, 0, NULL)) != NULL)
+			_count++;
+#else
+		(void)pthread_mutex_init(&_lock, NULL);
+		(void)pthread_cond_init(&_queued, NULL);
+		(void)pthread_cond_init(&_done, NULL);
+
+		while (threads > 1 && _count < threads && pthread_create(&_threads[_count], NULL, Main, this) == 0)
+			_count++;
+#endif
+	}
+
+	// Stops the worker threads once the queued jobs are complete
+	~Workers() {
+		Lock();
+		_stopping = true;
+		WakeAll(_queued);
+		Unlock();
+
+		for (uint32_t i = 0; i < _count; i++) {
+#if defined(_WIN32)
+			(void)WaitForSingleObject(_threads[i], INFINITE);
+			(void)CloseHandle(_threads[i]);
+#else
+			(void)pthread_join(_threads[i], NULL);
+#endif
+		}
+
+#if !defined(_WIN32)
+		(void)pthread_cond_destroy(&_done);
+		(void)pthread_cond_destroy(&_queued);
+		(void)pthread_mutex_destroy(&_lock);
+#endif
+	}
+
+	// Starts the jobs of a batch (the jobs are run immediately if there are no worker threads)
+	void Start(Batch &batch) {
+		if (_count == 0) {
+			for (uint32_t i = 0; i < batch.count; i++) {
+				Run(batch.jobs[i]);
+				batch.jobs[i].done = true;
+			}
+
+			return;
+		}
+
+		Lock();
+
+		for (uint32_t i = 0; i < batch.count; i++) {
+			batch.jobs[i].done = false;
+			_queue[_tail++ % QUEUE_SIZE] = &batch.jobs[i];
+		}
+
+		WakeAll(_queued);
+		Unlock();
+	}
+
+	// Waits for the jobs of a batch to complete
+	void Join(const Batch &batch) {
+		if (_count == 0)
+			return;
+
+		Lock();
+
+		for (uint32_t i = 0; i < batch.count; i++) {
+			while (!batch.jobs[i].done)
+				Wait(_done);
+		}
+
+		Unlock();
+	}
+};
+
+// Reads all of the requested data, returning false on failure or end of stream
+bool smbb::SharedMemoryStream::Endpoint::Read(void *data, size_t size) const {
+	uint8_t *next = static_cast<uint8_t *>(data);
+
+	while (size > 0) {
+		const size_t length = size < 0x40000000 ? size : 0x40000000;
+
+		if (_descriptor < 0) {
+			IPSocket::MessageResult result = IPSocket(_socket).Receive(next, static_cast<IPSocket::DataLength>(length));
+
+			if (result.Failed() && result.HasTemporaryReceiveError())
+				continue;
+			else if (result.GetResult() <= 0)
+				return false;
+
+			next += result.GetResult();
+			size -= static_cast<size_t>(result.GetResult());
+		}
+		else {
+#if defined(_WIN32)
+			const int result = _read(_descriptor, next, static_cast<unsigned int>(length));
+#else
+			const ssize_t result = read(_descriptor, next, length);
+
+			if (result < 0 && errno == EINTR)
+				continue;
+#endif
+			if (result <= 0)
+				return false;
+
+			next += result;
+			size -= static_cast<size_t>(result);
+		}
+	}
+
+	return true;
+}
+
+// Writes all of the data, returning false on failure
+bool smbb::SharedMemoryStream::Endpoint::Write(const void *data, size_t size) const {
+	const uint8_t *next = static_cast<const uint8_t *>(data);
+
+	while (size > 0) {
+		const size_t length = size < 0x40000000 ? size : 0x40000000;
+
+		if (_descriptor < 0) {
+			IPSocket::MessageResult result = IPSocket(_socket).Send(next, static_cast<IPSocket::DataLength>(length));
+
+			if (result.Failed() && result.HasTemporarySendError())
+				continue;
+			else if (result.GetResult() <= 0)
+				return false;
+
+			next += result.GetResult();
+			size -= static_cast<size_t>(result.GetResult());
+		}
+		else {
+#if defined(_WIN32)
+			const int result = _write(_descriptor, next, static_cast<unsigned int>(length));
+#else
+			const ssize_t result = write(_descriptor, next, length);
+
+			if (result < 0 && errno == EINTR)
+				continue;
+#endif
+			if (result <= 0)
+				return false;
+
+			next += result;
+			size -= static_cast<size_t>(result);
+		}
+	}
+
+	return true;
+}
+
+// Runs a job
+void smbb::SharedMemoryStream::Run(Job &job) {
+	if (!job.source)
+		job.result = 0;
+	else if (job.compress) {
+		const size_t length = LZCodec::Compress(job.source, job.sourceSize, job.destination, job.destinationSize);
+
+		// Data that does not compress is stored as is
+		job.result = length == 0 || length >= job.sourceSize ? job.sourceSize | RAW_CHUNK : static_cast<uint32_t>(length);
+	}
+	else {
+		size_t length = 0;
+
+		job.result = LZCodec::Decompress(job.source, job.sourceSize, job.destination, job.destinationSize, length) && length == job.destinationSize ? 0 : 1;
+	}
+}
+
+// Exports a region to a stream, compressing the chunks using the specified number of threads (the calling thread compresses if threads is 1)
+smbb::SharedMemoryStream::Result smbb::SharedMemoryStream::Export(const Endpoint &destination, const uint8_t *data, size_t size, uint8_t *workspace, size_t workspaceSize,
+		uint32_t chunkSize, uint32_t threads) {
+	if (!data && size)
+		return STREAM_FAILED_BAD_MEMORY;
+
+	threads = threads ? threads : 1;
+
+	if (threads > MAX_THREADS || chunkSize == 0 || chunkSize > MAX_CHUNK_SIZE || !workspace || workspaceSize < GetWorkspaceSize(chunkSize, threads))
+		return STREAM_FAILED_BAD_SIZE;
+
+	const size_t bufferSize = GetBufferSize(chunkSize);
+	uint8_t header[HEADER_SIZE];
+	Batch batches[2];
+	Workers workers(threads);
+	size_t offset = 0;
+	uint32_t current = 0;
+
+	StoreNetworkOrder(header, MAGIC);
+	StoreNetworkOrder(header + 4, VERSION);
+	StoreNetworkOrder(header + 8, chunkSize);
+	StoreNetworkOrder(header + 12, uint32_t(0));
+	StoreNetworkOrder(header + 16, static_cast<uint64_t>(size));
+
+	if (!destination.Write(header, sizeof(header)))
+		return STREAM_FAILED_TO_WRITE;
+
+	do {
+		// Compress the next set of chunks while the previous set is written
+		Batch &batch = batches[current];
+
+		workers.Join(batch);
+		batch.count = 0;
+
+		for (; batch.count < threads && offset < size; batch.count++) {
+			Job &job = batch.jobs[batch.count];
+
+			job.source = data + offset;
+			job.sourceSize = static_cast<uint32_t>(size - offset < chunkSize ? size - offset : chunkSize);
+			job.destination = workspace + (current * threads + batch.count) * bufferSize;
+			job.destinationSize = static_cast<uint32_t>(bufferSize);
+			job.compress = true;
+			offset += job.sourceSize;
+		}
+
+		workers.Start(batch);
+
+		Batch &previous = batches[current ^ 1];
+
+		workers.Join(previous);
+
+		for (uint32_t i = 0; i < previous.count; i++) {
+			const Job &job = previous.jobs[i];
+			uint8_t length[sizeof(job.result)];
+
+			StoreNetworkOrder(length, job.result);
+
+			if (!destination.Write(length, sizeof(length)) ||
+					!destination.Write((job.result & RAW_CHUNK) ? job.source : job.destination, job.result & ~RAW_CHUNK))
+				return STREAM_FAILED_TO_WRITE;
+		}
+
+		previous.count = 0;
+		current ^= 1;
+	} while (batches[current ^ 1].count > 0);
+
+	return STREAM_SUCCESS;
+}
+
+// Reads the header of a stream, getting the size of the region and the chunk size
+smbb::SharedMemoryStream::Result smbb::SharedMemoryStream::ReadHeader(const Endpoint &source, uint64_t &size, uint32_t &chunkSize) {
+	uint8_t header[HEADER_SIZE];
+
+	if (!source.Read(header, sizeof(header)))
+		return STREAM_FAILED_TO_READ;
+
+	const uint32_t headerChunkSize = LoadNetworkOrder<uint32_t>(header + 8);
+
+	if (LoadNetworkOrder<uint32_t>(header) != MAGIC || LoadNetworkOrder<uint32_t>(header + 4) != VERSION || headerChunkSize == 0 || headerChunkSize > MAX_CHUNK_SIZE)
+		return STREAM_FAILED_BAD_DATA;
+
+	size = LoadNetworkOrder<uint64_t>(header + 16);
+	chunkSize = headerChunkSize;
+	return STREAM_SUCCESS;
+}
+
+// Imports the chunks of a stream (following the header) into a region of the size from the header
+smbb::SharedMemoryStream::Result smbb::SharedMemoryStream::Import(const Endpoint &source, uint8_t *data, size_t size, uint32_t chunkSize, uint8_t *workspace, size_t workspaceSize, uint32_t threads) {
+	if (!data && size)
+		return STREAM_FAILED_BAD_MEMORY;
+
+	threads = threads ? threads : 1;
+
+	if (threads > MAX_THREADS || chunkSize == 0 || chunkSize > MAX_CHUNK_SIZE || !workspace || workspaceSize < GetWorkspaceSize(chunkSize, threads))
+		return STREAM_FAILED_BAD_SIZE;
+
+	const size_t bufferSize = GetBufferSize(chunkSize);
+	Batch batches[2];
+	Workers workers(threads);
+	size_t offset = 0;
+	uint32_t current = 0;
+
+	do {
+		// Read the next set of chunks while the previous set is decompressed
+		Batch &batch = batches[current];
+
+		workers.Join(batch);
+		batch.count = 0;
+
+		for (; batch.count < threads && offset < size; batch.count++) {
+			Job &job = batch.jobs[batch.count];
+			uint8_t lengthData[sizeof(uint32_t)];
+
+			job.destination = data + offset;
+			job.destinationSize = static_cast<uint32_t>(size - offset < chunkSize ? size - offset : chunkSize);
+			job.compress = false;
+			offset += job.destinationSize;
+
+			if (!source.Read(lengthData, sizeof(lengthData)))
+				return STREAM_FAILED_TO_READ;
+
+			const uint32_t length = LoadNetworkOrder<uint32_t>(lengthData);
+
+			if (length & RAW_CHUNK) {
+				// Uncompressed chunks are read directly into the region
+				job.source = NULL;
+				job.sourceSize = 0;
+
+				if ((length & ~RAW_CHUNK) != job.destinationSize)
+					return STREAM_FAILED_BAD_DATA;
+				else if (!source.Read(job.destination, job.destinationSize))
+					return STREAM_FAILED_TO_READ;
+			}
+			else {
+				job.source = workspace + (current * threads + batch.count) * bufferSize;
+				job.sourceSize = length;
+
+				if (length > bufferSize)
+					return STREAM_FAILED_BAD_DATA;
+				else if (!source.Read(workspace + (current * threads + batch.count) * bufferSize, length))
+					return STREAM_FAILED_TO_READ;
+			}
+		}
+
+		Batch &previous = batches[current ^ 1];
+
+		workers.Join(previous);
+
+		for (uint32_t i = 0; i < previous.count; i++) {
+			if (previous.jobs[i].result != 0)
+				return STREAM_FAILED_BAD_DATA;
+		}
+
+		previous.count = 0;
+		workers.Start(batch);
+		current ^= 1;
+	} while (batches[current ^ 1].count > 0);
+
+	return STREAM_SUCCESS;
+}
+
+// Creates a shared memory region for importing a stream, and imports the stream into it
+smbb::SharedMemoryStream::Result smbb::SharedMemoryStream::Import(const Endpoint &source, SharedMemory &memory, const char *name, const char *filename,
+		uint8_t *workspace, size_t workspaceSize, uint32_t threads) {
+	uint64_t size = 0;
+	uint32_t chunkSize = 0;
+	Result result = ReadHeader(source, size, chunkSize);
+
+	if (result != STREAM_SUCCESS)
+		return result;
+	else if (size == 0 || size != static_cast<size_t>(size) || static_cast<uint64_t>(static_cast<SharedMemory::Size>(size)) != size)
+		return STREAM_FAILED_BAD_SIZE;
+
+	const SharedMemory::LoadResult loadResult = name ? memory.CreateNamed(name, static_cast<SharedMemory::Size>(size)) : memory.CreateFileBacked(filename, static_cast<SharedMemory::Size>(size));
+
+	if (loadResult != SharedMemory::LOAD_SUCCESS)
+		return STREAM_FAILED_TO_CREATE;
+
+	SharedMemorySection section(memory, static_cast<size_t>(size));
+
+	if (!section.Valid())
+		return STREAM_FAILED_TO_CREATE;
+
+	return Import(source, section.Data(), section.Size(), chunkSize, workspace, workspaceSize, threads);
+}
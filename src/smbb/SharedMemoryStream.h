@@ -0,0 +1,157 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMEMORYSTREAM_H
+#define SMBB_SHAREDMEMORYSTREAM_H
+
+#include <cstdlib>
+
+#include "utilities/ByteOrder.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "IPSocket.h"
+#include "LZCodec.h"
+#include "SharedMemory.h"
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// Exports and imports shared memory regions as a compressed stream (e.g. to move a snapshot between hosts or to cold storage).
+//  The region is split into chunks that are compressed independently using LZCodec, so several threads can compress or decompress chunks in parallel
+//  while the calling thread writes or reads the previous chunks. All buffers are taken from a caller-provided workspace of a fixed size.
+//  The worker threads are started once for each export or import, and the stream is written in network byte order so it can be imported on any host.
+class SharedMemoryStream {
+public:
+	enum Result {
+		STREAM_SUCCESS = 0,
+		STREAM_FAILED_BAD_MEMORY,
+		STREAM_FAILED_BAD_SIZE,
+		STREAM_FAILED_BAD_DATA,
+		STREAM_FAILED_TO_CREATE,
+		STREAM_FAILED_TO_READ,
+		STREAM_FAILED_TO_WRITE
+	};
+
+	// The default size of each chunk
+	static const uint32_t DEFAULT_CHUNK_SIZE = 1U << 20;
+
+	// The maximum size of each chunk
+	static const uint32_t MAX_CHUNK_SIZE = 1U << 30;
+
+	// The maximum number of compression threads
+	static const uint32_t MAX_THREADS = 16;
+
+	// The source or destination of a stream (a file descriptor or a connected socket)
+	class Endpoint {
+		IPSocket _socket;
+		int _descriptor;
+
+	public:
+		// Uses a file descriptor (e.g. a file or pipe)
+		Endpoint(int descriptor) : _socket(), _descriptor(descriptor) { }
+
+		// Uses a connected, blocking socket
+		Endpoint(const IPSocket &socket) : _socket(socket), _descriptor(-1) { }
+
+		// Reads all of the requested data, returning false on failure or end of stream
+		SMBB_INLINE bool Read(void *data, size_t size) const;
+
+		// Writes all of the data, returning false on failure
+		SMBB_INLINE bool Write(const void *data, size_t size) const;
+	};
+
+private:
+	static const uint32_t MAGIC = 0x534D425A; // "SMBZ"
+	static const uint32_t VERSION = 1;
+
+	// The flag on the length of a chunk that indicates that it is stored uncompressed
+	static const uint32_t RAW_CHUNK = 0x80000000;
+
+	// The size of the stream header (the magic, version, chunk size, a reserved word, then the 64-bit region size; each chunk follows, as its length and data)
+	static const size_t HEADER_SIZE = 24;
+
+	// A chunk to compress or decompress on a worker thread
+	struct Job {
+		const uint8_t *source;
+		uint8_t *destination;
+		uint32_t sourceSize;
+		uint32_t destinationSize;
+		uint32_t result; // The compressed length (with RAW_CHUNK if not compressed) when compressing, or zero on success when decompressing
+		bool compress;
+		bool done;
+	};
+
+	// A set of chunks that are processed in parallel
+	struct Batch {
+		Job jobs[MAX_THREADS];
+		uint32_t count;
+
+		Batch() : jobs(), count() { }
+	};
+
+	// The threads that process the jobs of a stream
+	class Workers;
+
+	// Gets the size of the buffer for each compressed chunk
+	static size_t GetBufferSize(uint32_t chunkSize) { return (LZCodec::GetMaxCompressedSize(chunkSize) + 7) & ~size_t(7); }
+
+	// Runs a job
+	static SMBB_INLINE void Run(Job &job);
+
+	// Creates a shared memory region for importing a stream, and imports the stream into it
+	static SMBB_INLINE Result Import(const Endpoint &source, SharedMemory &memory, const char *name, const char *filename, uint8_t *workspace, size_t workspaceSize, uint32_t threads);
+
+public:
+	// Gets the size of the workspace required to export or import using chunks of the specified size
+	static size_t GetWorkspaceSize(uint32_t chunkSize = DEFAULT_CHUNK_SIZE, uint32_t threads = 1) { return 2 * (threads ? threads : 1) * GetBufferSize(chunkSize); }
+
+	// Exports a region to a stream, compressing the chunks using the specified number of threads (the calling thread compresses if threads is 1)
+	static SMBB_INLINE Result Export(const Endpoint &destination, const uint8_t *data, size_t size, uint8_t *workspace, size_t workspaceSize,
+		uint32_t chunkSize = DEFAULT_CHUNK_SIZE, uint32_t threads = 1);
+
+	// Exports a shared memory section to a stream
+	static Result Export(const Endpoint &destination, const SharedMemorySection &section, uint8_t *workspace, size_t workspaceSize, uint32_t chunkSize = DEFAULT_CHUNK_SIZE, uint32_t threads = 1) {
+		return Export(destination, section.Data(), section.Size(), workspace, workspaceSize, chunkSize, threads);
+	}
+
+	// Reads the header of a stream, getting the size of the region and the chunk size
+	static SMBB_INLINE Result ReadHeader(const Endpoint &source, uint64_t &size, uint32_t &chunkSize);
+
+	// Imports the chunks of a stream (following the header) into a region of the size from the header
+	static SMBB_INLINE Result Import(const Endpoint &source, uint8_t *data, size_t size, uint32_t chunkSize, uint8_t *workspace, size_t workspaceSize, uint32_t threads = 1);
+
+	// Imports a stream into a new named shared memory entity
+	static Result ImportNamed(const Endpoint &source, SharedMemory &memory, const char *name, uint8_t *workspace, size_t workspaceSize, uint32_t threads = 1) {
+		return Import(source, memory, name, NULL, workspace, workspaceSize, threads);
+	}
+
+	// Imports a stream into a new shared memory file
+	static Result ImportFileBacked(const Endpoint &source, SharedMemory &memory, const char *filename, uint8_t *workspace, size_t workspaceSize, uint32_t threads = 1) {
+		return Import(source, memory, NULL, filename, workspace, workspaceSize, threads);
+	}
+};
+
+}
+
+#endif
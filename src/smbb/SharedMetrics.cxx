@@ -0,0 +1,201 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedMetrics.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#endif
+
+// Gets a hint for the current stripe (the current CPU if available, otherwise a per-thread value)
+uint32_t smbb::SharedMetrics::GetStripeHint() {
+#if defined(_WIN32)
+	return static_cast<uint32_t>(GetCurrentProcessorNumber());
+#else
+#if defined(__linux__)
+	int cpu = sched_getcpu();
+
+	if (cpu >= 0)
+		return static_cast<uint32_t>(cpu);
+#endif
+#if defined(__GNUC__)
+	static Atomic<uint32_t> nextThreadHint;
+	static __thread uint32_t threadHint = 0;
+
+	if (threadHint == 0)
+		threadHint = nextThreadHint.FetchAdd(1, MEMORY_ORDER_RELAXED) + 1;
+
+	return threadHint;
+#else
+	return 0;
+#endif
+#endif
+}
+
+// Finds the metric with the specified name among the first count metrics
+bool smbb::SharedMetrics::FindMetric(const char *name, uint32_t hash, uint32_t count, uint32_t &index) const {
+	const Descriptor *descriptors = GetDescriptors();
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (descriptors[i].hash == hash && strncmp(descriptors[i].name, name, MAX_SHARED_METRICS_NAME_SIZE) == 0) {
+			index = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Attaches to an initialized block
+void smbb::SharedMetrics::Attach(uint8_t *data, bool readOnly) {
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	_data = data;
+	_stripes = header->stripes;
+	_maxMetrics = header->maxMetrics;
+	_maxWritable = readOnly ? 0 : _maxMetrics;
+	_rowSize = GetRowSize(_maxMetrics);
+	_cells = data + sizeof(Header) + sizeof(Descriptor) * _maxMetrics;
+}
+
+// Gets the recommended number of stripes (the number of CPUs)
+uint32_t smbb::SharedMetrics::GetRecommendedStripes() {
+	static uint32_t stripes = 0;
+
+	if (stripes == 0) {
+#if defined(_WIN32)
+		SYSTEM_INFO sinfo;
+
+		GetSystemInfo(&sinfo);
+		stripes = static_cast<uint32_t>(sinfo.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_CONF)
+		long processors = sysconf(_SC_NPROCESSORS_CONF);
+		stripes = processors > 0 ? static_cast<uint32_t>(processors) : 1;
+#else
+		stripes = 1;
+#endif
+	}
+
+	return stripes;
+}
+
+// Creates a new metrics block in the specified memory (which should be cache-line aligned), overwriting any existing content
+smbb::SharedMetrics::Result smbb::SharedMetrics::Create(uint8_t *data, size_t size, uint32_t maxMetrics, uint32_t stripes) {
+	_data = NULL;
+
+	if (!data || maxMetrics == 0 || stripes == 0 || maxMetrics > size / sizeof(Descriptor) || stripes > size / GetRowSize(maxMetrics) || size < GetRequiredSize(maxMetrics, stripes))
+		return METRICS_FAILED_BAD_SIZE;
+
+	Header *header = reinterpret_cast<Header *>(data);
+
+	memset(data, 0, GetRequiredSize(maxMetrics, stripes));
+	header->version = VERSION;
+	header->maxMetrics = maxMetrics;
+	header->stripes = stripes;
+
+	// Publish the block last, so that it is never seen partially initialized
+	header->magic.Store(MAGIC, MEMORY_ORDER_RELEASE);
+
+	Attach(data, false);
+	return METRICS_SUCCESS;
+}
+
+// Opens an existing metrics block in the specified memory
+smbb::SharedMetrics::Result smbb::SharedMetrics::Open(uint8_t *data, size_t size, bool readOnly) {
+	_data = NULL;
+
+	if (!data || size < sizeof(Header))
+		return METRICS_FAILED_BAD_MEMORY;
+
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	if (header->magic.Load(MEMORY_ORDER_ACQUIRE) != MAGIC || header->version != VERSION || header->maxMetrics == 0 || header->stripes == 0 ||
+			header->maxMetrics > size / sizeof(Descriptor) || header->stripes > size / GetRowSize(header->maxMetrics) || size < GetRequiredSize(header->maxMetrics, header->stripes))
+		return METRICS_FAILED_BAD_MEMORY;
+
+	Attach(data, readOnly);
+	return METRICS_SUCCESS;
+}
+
+// Registers a new metric, returning its index
+smbb::SharedMetrics::Result smbb::SharedMetrics::Register(const char *name, MetricType type, uint32_t &index) {
+	uint32_t hash;
+	size_t length;
+
+	if (!_data)
+		return METRICS_FAILED_BAD_MEMORY;
+	else if (!HashName(name, MAX_SHARED_METRICS_NAME_SIZE, hash, length))
+		return METRICS_FAILED_BAD_NAME;
+	else if (type != METRIC_COUNTER && type != METRIC_GAUGE)
+		return METRICS_FAILED_BAD_TYPE;
+	else if (_maxWritable == 0)
+		return METRICS_FAILED_READ_ONLY;
+
+	Header *header = GetHeader();
+	Result result = METRICS_SUCCESS;
+
+	// Registration is rare, so a simple spin lock is sufficient to serialize registrations across processes
+	for (uint32_t unlocked = 0; !header->lock.CompareExchange(unlocked, 1, MEMORY_ORDER_ACQUIRE); unlocked = 0)
+		CpuRelax();
+
+	uint32_t count = header->count.Load(MEMORY_ORDER_RELAXED);
+
+	if (FindMetric(name, hash, count, index))
+		result = GetDescriptors()[index].type == static_cast<uint32_t>(type) ? METRICS_ALREADY_EXISTS : METRICS_FAILED_BAD_TYPE;
+	else if (count >= header->maxMetrics)
+		result = METRICS_FAILED_FULL;
+	else {
+		Descriptor &descriptor = GetDescriptors()[count];
+
+		memcpy(descriptor.name, name, length + 1);
+		descriptor.hash = hash;
+		descriptor.type = static_cast<uint32_t>(type);
+		index = count;
+
+		// Publish the metric only after it is completely written
+		header->count.Store(count + 1, MEMORY_ORDER_RELEASE);
+	}
+
+	header->lock.Store(0, MEMORY_ORDER_RELEASE);
+	return result;
+}
+
+// Finds the index of an existing metric
+smbb::SharedMetrics::Result smbb::SharedMetrics::Find(const char *name, uint32_t &index) const {
+	uint32_t hash;
+	size_t length;
+
+	if (!_data)
+		return METRICS_FAILED_BAD_MEMORY;
+	else if (!HashName(name, MAX_SHARED_METRICS_NAME_SIZE, hash, length))
+		return METRICS_FAILED_BAD_NAME;
+
+	return FindMetric(name, hash, Count(), index) ? METRICS_SUCCESS : METRICS_FAILED_NOT_FOUND;
+}
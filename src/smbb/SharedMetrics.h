@@ -0,0 +1,203 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDMETRICS_H
+#define SMBB_SHAREDMETRICS_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+#include "utilities/NameHash.h"
+
+#include "SharedMemorySection.h"
+
+#ifndef MAX_SHARED_METRICS_NAME_SIZE
+#define MAX_SHARED_METRICS_NAME_SIZE 48U
+#endif
+
+namespace smbb {
+
+// A block of named counters and gauges stored in shared memory.
+//  Each metric is striped across a number of cache-line aligned rows (one per CPU by default), so writers on different CPUs never share a cache line.
+//  Readers (which can use a read-only mapping) sum the stripes on demand, and never write to the block.
+class SharedMetrics {
+public:
+	enum Result {
+		METRICS_SUCCESS = 0,
+		METRICS_ALREADY_EXISTS, // The name already exists; the existing metric is returned
+		METRICS_FAILED_BAD_MEMORY,
+		METRICS_FAILED_BAD_NAME,
+		METRICS_FAILED_BAD_SIZE,
+		METRICS_FAILED_BAD_TYPE,
+		METRICS_FAILED_READ_ONLY,
+		METRICS_FAILED_NOT_FOUND,
+		METRICS_FAILED_FULL
+	};
+
+	enum MetricType {
+		METRIC_NONE = 0,
+		METRIC_COUNTER, // A monotonically increasing unsigned value
+		METRIC_GAUGE // A signed value that can be increased or decreased
+	};
+
+	// The size of a cache line used to separate stripes
+	static const size_t CACHE_LINE_SIZE = 64;
+
+private:
+	static const uint32_t MAGIC = 0x534D424D; // "SMBM"
+	static const uint32_t VERSION = 1;
+
+	// The layout of the metrics header in shared memory (one cache line)
+	struct Header {
+		Atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t maxMetrics;
+		uint32_t stripes;
+		Atomic<uint32_t> lock;
+		Atomic<uint32_t> count;
+		uint32_t reserved[10];
+	};
+
+	// Fails to compile if the name does not leave room for the rest of a descriptor in one cache line
+	typedef char MAX_SHARED_METRICS_NAME_SIZE_must_be_a_multiple_of_4_less_than_56[(MAX_SHARED_METRICS_NAME_SIZE % 4 == 0 && MAX_SHARED_METRICS_NAME_SIZE < 56) ? 1 : -1];
+
+	// The layout of a metric descriptor in shared memory (one cache line)
+	struct Descriptor {
+		char name[MAX_SHARED_METRICS_NAME_SIZE];
+		uint32_t hash;
+		uint32_t type;
+		uint32_t reserved[16 - MAX_SHARED_METRICS_NAME_SIZE / 4 - 2];
+	};
+
+	uint8_t *_data;
+	uint8_t *_cells;
+	size_t _rowSize;
+	uint32_t _stripes;
+	uint32_t _maxMetrics;
+	uint32_t _maxWritable;
+
+	// Gets the header and descriptors of the block
+	Header *GetHeader() const { return reinterpret_cast<Header *>(_data); }
+	Descriptor *GetDescriptors() const { return reinterpret_cast<Descriptor *>(_data + sizeof(Header)); }
+
+	// Gets the size of a row of metrics (one per stripe)
+	static size_t GetRowSize(uint32_t maxMetrics) { return (sizeof(uint64_t) * maxMetrics + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1); }
+
+	// Gets a hint for the current stripe (the current CPU if available, otherwise a per-thread value)
+	static SMBB_INLINE uint32_t GetStripeHint();
+
+	// Finds the metric with the specified name among the first count metrics
+	SMBB_INLINE bool FindMetric(const char *name, uint32_t hash, uint32_t count, uint32_t &index) const;
+
+	// Attaches to an initialized block
+	SMBB_INLINE void Attach(uint8_t *data, bool readOnly);
+
+	// Gets the cell for the current stripe
+	Atomic<uint64_t> *GetCell(uint32_t index) const {
+		uint32_t stripe = GetStripeHint();
+
+		stripe = (_stripes & (_stripes - 1)) == 0 ? stripe & (_stripes - 1) : stripe % _stripes;
+		return reinterpret_cast<Atomic<uint64_t> *>(_cells + _rowSize * stripe) + index;
+	}
+
+	// Sums the cells of a metric across all stripes
+	uint64_t Sum(uint32_t index) const {
+		uint64_t sum = 0;
+
+		if (index < _maxMetrics) {
+			for (uint32_t i = 0; i < _stripes; i++)
+				sum += reinterpret_cast<const Atomic<uint64_t> *>(_cells + _rowSize * i)[index].Load(MEMORY_ORDER_RELAXED);
+		}
+
+		return sum;
+	}
+
+public:
+	// Gets the recommended number of stripes (the number of CPUs)
+	static SMBB_INLINE uint32_t GetRecommendedStripes();
+
+	// Gets the size required for a block with the specified number of metrics and stripes
+	static size_t GetRequiredSize(uint32_t maxMetrics, uint32_t stripes = GetRecommendedStripes()) {
+		return sizeof(Header) + sizeof(Descriptor) * maxMetrics + GetRowSize(maxMetrics) * stripes;
+	}
+
+	SharedMetrics() : _data(), _cells(), _rowSize(), _stripes(), _maxMetrics(), _maxWritable() { }
+
+	// Creates a new metrics block in the specified memory (which should be cache-line aligned), overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t maxMetrics, uint32_t stripes = GetRecommendedStripes());
+
+	// Creates a new metrics block at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t maxMetrics, uint32_t stripes = GetRecommendedStripes()) {
+		return section.ReadOnly() ? METRICS_FAILED_READ_ONLY : Create(section.Data(), section.Size(), maxMetrics, stripes);
+	}
+
+	// Opens an existing metrics block in the specified memory
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing metrics block at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the block has been created or opened
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the number of stripes in the block
+	uint32_t GetStripes() const { return _stripes; }
+
+	// Gets the number of registered metrics
+	uint32_t Count() const { return _data ? GetHeader()->count.Load(MEMORY_ORDER_ACQUIRE) : 0; }
+
+	// Gets the name of the metric at the specified index (or NULL if the index is out of range)
+	const char *GetName(uint32_t index) const { return index < Count() ? GetDescriptors()[index].name : NULL; }
+
+	// Gets the type of the metric at the specified index
+	MetricType GetType(uint32_t index) const { return index < Count() ? static_cast<MetricType>(GetDescriptors()[index].type) : METRIC_NONE; }
+
+	// Registers a new metric, returning its index
+	SMBB_INLINE Result Register(const char *name, MetricType type, uint32_t &index);
+
+	// Finds the index of an existing metric
+	SMBB_INLINE Result Find(const char *name, uint32_t &index) const;
+
+	// Adds to a counter or gauge (ignored if the block is read-only or the index is out of range)
+	void Add(uint32_t index, uint64_t value = 1) {
+		if (index < _maxWritable)
+			(void)GetCell(index)->FetchAdd(value, MEMORY_ORDER_RELAXED);
+	}
+
+	// Subtracts from a gauge (ignored if the block is read-only or the index is out of range)
+	void Subtract(uint32_t index, uint64_t value = 1) { Add(index, ~value + 1); }
+
+	// Gets the current value of a counter by summing the stripes
+	uint64_t GetCounter(uint32_t index) const { return Sum(index); }
+
+	// Gets the current value of a gauge by summing the stripes
+	int64_t GetGauge(uint32_t index) const { return static_cast<int64_t>(Sum(index)); }
+};
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SharedObjectPool.h"
+
+#include <cstring>
+
+// Attaches to an initialized pool
+void smbb::SharedObjectPool::Attach(uint8_t *data, bool readOnly) {
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	_data = data;
+	_capacity = header->capacity;
+	_stride = GetStride(header->objectSize);
+	_objects = data + GetObjectsOffset(_capacity);
+	_readOnly = readOnly;
+}
+
+// Creates a new pool in the specified memory (which should be cache-line aligned), overwriting any existing content
+smbb::SharedObjectPool::Result smbb::SharedObjectPool::Create(uint8_t *data, size_t size, uint32_t objectSize, uint32_t capacity) {
+	_data = NULL;
+
+	if (!data || objectSize == 0 || capacity == 0 || capacity >= 0xFFFFFFFF || capacity > size / (sizeof(Entry) + GetStride(objectSize)) || size < GetRequiredSize(objectSize, capacity))
+		return POOL_FAILED_BAD_SIZE;
+
+	Header *header = reinterpret_cast<Header *>(data);
+	Entry *entries = reinterpret_cast<Entry *>(data + sizeof(Header));
+
+	memset(data, 0, GetObjectsOffset(capacity));
+	header->version = VERSION;
+	header->objectSize = objectSize;
+	header->capacity = capacity;
+
+	// Link all of the objects into the free list
+	for (uint32_t i = 0; i + 1 < capacity; i++)
+		entries[i].next.Store(i + 2, MEMORY_ORDER_RELAXED);
+
+	header->freeHead.Store(1, MEMORY_ORDER_RELAXED);
+
+	// Publish the pool last, so that it is never seen partially initialized
+	header->magic.Store(MAGIC, MEMORY_ORDER_RELEASE);
+
+	Attach(data, false);
+	return POOL_SUCCESS;
+}
+
+// Opens an existing pool in the specified memory
+smbb::SharedObjectPool::Result smbb::SharedObjectPool::Open(uint8_t *data, size_t size, bool readOnly) {
+	_data = NULL;
+
+	if (!data || size < sizeof(Header))
+		return POOL_FAILED_BAD_MEMORY;
+
+	const Header *header = reinterpret_cast<const Header *>(data);
+
+	if (header->magic.Load(MEMORY_ORDER_ACQUIRE) != MAGIC || header->version != VERSION || header->objectSize == 0 || header->capacity == 0 ||
+			header->capacity > size / (sizeof(Entry) + GetStride(header->objectSize)) || size < GetRequiredSize(header->objectSize, header->capacity))
+		return POOL_FAILED_BAD_MEMORY;
+
+	Attach(data, readOnly);
+	return POOL_SUCCESS;
+}
+
+// Allocates an object, returning its handle (the object is not cleared)
+smbb::SharedObjectPool::Result smbb::SharedObjectPool::Allocate(Handle &handle) {
+	if (!_data)
+		return POOL_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return POOL_FAILED_READ_ONLY;
+
+	Atomic<uint64_t> &freeHead = GetHeader()->freeHead;
+	Entry *entries = GetEntries();
+	uint64_t head = freeHead.Load(MEMORY_ORDER_ACQUIRE);
+	uint32_t index;
+
+	// The tag is incremented on every change to the head, so a head that was popped and pushed back in the meantime is not mistaken for the original
+	do {
+		index = static_cast<uint32_t>(head);
+
+		if (index == 0 || index > _capacity)
+			return POOL_FAILED_FULL;
+	} while (!freeHead.CompareExchange(head, (((head >> 32) + 1) << 32) | entries[index - 1].next.Load(MEMORY_ORDER_RELAXED), MEMORY_ORDER_ACQUIRE_RELEASE));
+
+	const uint32_t generation = entries[index - 1].generation.FetchAdd(1, MEMORY_ORDER_ACQUIRE_RELEASE) + 1;
+
+	handle = (static_cast<uint64_t>(generation) << 32) | (index - 1);
+	return POOL_SUCCESS;
+}
+
+// Frees the object referred to by a handle, invalidating all copies of the handle
+smbb::SharedObjectPool::Result smbb::SharedObjectPool::Free(Handle handle) {
+	if (!_data)
+		return POOL_FAILED_BAD_MEMORY;
+	else if (_readOnly)
+		return POOL_FAILED_READ_ONLY;
+
+	uint32_t generation = GetGeneration(handle);
+	const uint32_t index = GetIndex(handle);
+
+	if (index >= _capacity || (generation & 1) == 0)
+		return POOL_FAILED_BAD_HANDLE;
+
+	Entry &entry = GetEntries()[index];
+
+	// Only one free of a handle can succeed
+	if (!entry.generation.CompareExchange(generation, generation + 1, MEMORY_ORDER_ACQUIRE_RELEASE))
+		return POOL_FAILED_BAD_HANDLE;
+
+	Atomic<uint64_t> &freeHead = GetHeader()->freeHead;
+	uint64_t head = freeHead.Load(MEMORY_ORDER_RELAXED);
+
+	do {
+		entry.next.Store(static_cast<uint32_t>(head), MEMORY_ORDER_RELAXED);
+	} while (!freeHead.CompareExchange(head, (((head >> 32) + 1) << 32) | (index + 1), MEMORY_ORDER_RELEASE));
+
+	return POOL_SUCCESS;
+}
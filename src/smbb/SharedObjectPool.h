@@ -0,0 +1,155 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_SHAREDOBJECTPOOL_H
+#define SMBB_SHAREDOBJECTPOOL_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+#include "SharedMemorySection.h"
+
+namespace smbb {
+
+// A fixed-capacity pool of fixed-size objects stored in shared memory.
+//  Objects are referenced across processes using 64-bit handles that combine the object index with a generation.
+//  The generation changes each time the object is allocated or freed, so a stale handle to a recycled object is detected in constant time.
+//  Allocating and freeing use a lock-free free list with a tagged head, so they never block and are not affected by ABA.
+class SharedObjectPool {
+public:
+	enum Result {
+		POOL_SUCCESS = 0,
+		POOL_FAILED_BAD_MEMORY,
+		POOL_FAILED_BAD_SIZE,
+		POOL_FAILED_BAD_HANDLE,
+		POOL_FAILED_READ_ONLY,
+		POOL_FAILED_FULL
+	};
+
+	typedef uint64_t Handle;
+
+	// A handle that never refers to an object
+	static const Handle INVALID_HANDLE = 0;
+
+	// The alignment of each object (a typical cache line size)
+	static const size_t OBJECT_ALIGNMENT = 64;
+
+private:
+	static const uint32_t MAGIC = 0x534D4250; // "SMBP"
+	static const uint32_t VERSION = 1;
+
+	// The layout of the pool header in shared memory (the free list head is on its own cache line)
+	struct Header {
+		Atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t objectSize;
+		uint32_t capacity;
+		uint32_t reserved[12];
+
+		Atomic<uint64_t> freeHead; // The tag in the upper 32 bits, and the index + 1 of the first free object in the lower 32 bits
+		uint32_t reserved2[14];
+	};
+
+	// The state of an object in shared memory (the generation is odd while the object is allocated)
+	struct Entry {
+		Atomic<uint32_t> generation;
+		Atomic<uint32_t> next; // The index + 1 of the next free object
+	};
+
+	uint8_t *_data;
+	uint8_t *_objects;
+	size_t _stride;
+	uint32_t _capacity;
+	bool _readOnly;
+
+	// Gets the header and entries of the pool
+	Header *GetHeader() const { return reinterpret_cast<Header *>(_data); }
+	Entry *GetEntries() const { return reinterpret_cast<Entry *>(_data + sizeof(Header)); }
+
+	// Gets the offset of the first object for the specified capacity
+	static size_t GetObjectsOffset(uint32_t capacity) { return (sizeof(Header) + sizeof(Entry) * capacity + OBJECT_ALIGNMENT - 1) & ~(OBJECT_ALIGNMENT - 1); }
+
+	// Gets the distance between objects of the specified size
+	static size_t GetStride(uint32_t objectSize) { return (static_cast<size_t>(objectSize) + OBJECT_ALIGNMENT - 1) & ~(OBJECT_ALIGNMENT - 1); }
+
+	// Gets the parts of a handle
+	static uint32_t GetIndex(Handle handle) { return static_cast<uint32_t>(handle); }
+	static uint32_t GetGeneration(Handle handle) { return static_cast<uint32_t>(handle >> 32); }
+
+	// Attaches to an initialized pool
+	SMBB_INLINE void Attach(uint8_t *data, bool readOnly);
+
+public:
+	// Gets the size required for a pool with the specified object size and capacity
+	static size_t GetRequiredSize(uint32_t objectSize, uint32_t capacity) { return GetObjectsOffset(capacity) + GetStride(objectSize) * capacity; }
+
+	SharedObjectPool() : _data(), _objects(), _stride(), _capacity(), _readOnly() { }
+
+	// Creates a new pool in the specified memory (which should be cache-line aligned), overwriting any existing content
+	SMBB_INLINE Result Create(uint8_t *data, size_t size, uint32_t objectSize, uint32_t capacity);
+
+	// Creates a new pool at the start of the shared memory section
+	Result Create(const SharedMemorySection &section, uint32_t objectSize, uint32_t capacity) {
+		return section.ReadOnly() ? POOL_FAILED_READ_ONLY : Create(section.Data(), section.Size(), objectSize, capacity);
+	}
+
+	// Opens an existing pool in the specified memory
+	SMBB_INLINE Result Open(uint8_t *data, size_t size, bool readOnly = true);
+
+	// Opens an existing pool at the start of the shared memory section
+	Result Open(const SharedMemorySection &section) {
+		return Open(section.Data(), section.Size(), section.ReadOnly());
+	}
+
+	// Returns true if the pool has been created or opened
+	bool Valid() const { return _data != NULL; }
+
+	// Gets the number of objects in the pool
+	uint32_t GetCapacity() const { return _capacity; }
+
+	// Gets the size of each object
+	uint32_t GetObjectSize() const { return _data ? GetHeader()->objectSize : 0; }
+
+	// Returns true if the handle refers to an allocated object
+	bool IsValid(Handle handle) const {
+		const uint32_t generation = GetGeneration(handle);
+
+		return GetIndex(handle) < _capacity && (generation & 1) != 0 && GetEntries()[GetIndex(handle)].generation.Load(MEMORY_ORDER_ACQUIRE) == generation;
+	}
+
+	// Gets the object referred to by a handle (or NULL if the handle is stale or invalid)
+	uint8_t *Get(Handle handle) const { return IsValid(handle) ? _objects + _stride * GetIndex(handle) : NULL; }
+
+	// Allocates an object, returning its handle (the object is not cleared)
+	SMBB_INLINE Result Allocate(Handle &handle);
+
+	// Frees the object referred to by a handle, invalidating all copies of the handle
+	SMBB_INLINE Result Free(Handle handle);
+};
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "WaitStrategy.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#include <time.h>
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+// Yields the CPU to other threads
+void smbb::WaitStrategy::YieldThread() {
+#if defined(_WIN32)
+	(void)SwitchToThread();
+#else
+	(void)sched_yield();
+#endif
+}
+
+// Parks the thread until woken or the timeout expires (if the value is not NULL, returns immediately if it does not equal the expected value, and counts the thread in the waiters if not NULL)
+void smbb::WaitStrategy::Park(const Atomic<uint32_t> *value, Atomic<uint32_t> *waiters, uint32_t expected, unsigned long timeoutUs) {
+#if defined(_WIN32)
+	(void)value;
+	(void)waiters;
+	(void)expected;
+
+	// WaitOnAddress() only works within a process, so sleep instead
+	Sleep(timeoutUs / 1000 > 0 ? static_cast<DWORD>(timeoutUs / 1000) : 1);
+#else
+	struct timespec timeout;
+
+	timeout.tv_sec = static_cast<time_t>(timeoutUs / 1000000);
+	timeout.tv_nsec = static_cast<long>(timeoutUs % 1000000) * 1000;
+
+#if defined(__linux__)
+	// The futex is not private, so it can be woken by other processes sharing the memory
+	if (value) {
+		// The waiter is counted before the value is checked (by the futex), so a waker either sees the waiter or the waiter sees the new value
+		if (waiters)
+			(void)waiters->FetchAdd(1, MEMORY_ORDER_SEQUENTIAL);
+
+		(void)syscall(SYS_futex, reinterpret_cast<const uint32_t *>(value), FUTEX_WAIT, expected, &timeout, NULL, 0);
+
+		if (waiters)
+			(void)waiters->FetchSubtract(1, MEMORY_ORDER_RELEASE);
+
+		return;
+	}
+#else
+	(void)value;
+	(void)waiters;
+	(void)expected;
+#endif
+	(void)nanosleep(&timeout, NULL);
+#endif
+}
+
+// Backs off once, parking on the value (if not NULL)
+void smbb::WaitStrategy::Backoff(const Atomic<uint32_t> *value, Atomic<uint32_t> *waiters, uint32_t expected) {
+	Mode mode = _mode;
+
+	if (mode == WAIT_HYBRID) {
+		if (_idleCount < _spinLimit)
+			mode = WAIT_BUSY_SPIN;
+		else if (_idleCount - _spinLimit < _yieldLimit)
+			mode = WAIT_YIELD;
+		else
+			mode = WAIT_PARK;
+
+		if (mode != WAIT_PARK)
+			_idleCount++;
+	}
+
+	switch (mode) {
+	case WAIT_BUSY_SPIN:
+		CpuRelax();
+		_spins++;
+		break;
+
+	case WAIT_YIELD:
+		YieldThread();
+		_yields++;
+		break;
+
+	default:
+		Park(value, waiters, expected, _parkTimeoutUs);
+		_parks++;
+		break;
+	}
+}
+
+// Wakes all threads parked on the value
+void smbb::WaitStrategy::WakeAll(Atomic<uint32_t> &value) {
+#if defined(__linux__)
+	(void)syscall(SYS_futex, reinterpret_cast<uint32_t *>(&value), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+	(void)value;
+#endif
+}
+
+// Wakes all threads (in any process) parked on the signal after its value has been changed, without a system call if no thread is parked
+void smbb::WaitStrategy::Wake(Signal &signal) {
+	// Order the change to the value before checking for waiters (matching the order used by a parking thread)
+	AtomicFence(MEMORY_ORDER_SEQUENTIAL);
+
+	if (signal.waiters.Load(MEMORY_ORDER_RELAXED) != 0)
+		WakeAll(signal.value);
+}
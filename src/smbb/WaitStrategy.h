@@ -0,0 +1,131 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_WAITSTRATEGY_H
+#define SMBB_WAITSTRATEGY_H
+
+#include <cstdlib>
+
+#include "utilities/Atomic.h"
+#include "utilities/Inline.h"
+#include "utilities/IntegerTypes.h"
+
+namespace smbb {
+
+// A configurable strategy for waiting on a value in shared memory (e.g. a ring cursor) to change.
+//  Each consumer owns its own strategy, calling Idle() each time it polls without progress and Reset() once it makes progress.
+//  Parking uses a futex on Linux (which works across processes when the value is in shared memory), otherwise it sleeps for the park timeout.
+class WaitStrategy {
+public:
+	enum Mode {
+		WAIT_BUSY_SPIN = 0, // Spin with a processor pause (lowest latency, uses a full CPU)
+		WAIT_YIELD, // Yield the CPU to other threads between polls
+		WAIT_PARK, // Block until woken or the park timeout expires (highest latency, lowest CPU use)
+		WAIT_HYBRID // Spin, then yield, then park
+	};
+
+	static const uint32_t DEFAULT_SPIN_LIMIT = 1000;
+	static const uint32_t DEFAULT_YIELD_LIMIT = 100;
+	static const unsigned long DEFAULT_PARK_TIMEOUT_US = 1000;
+
+	// A value in shared memory with the number of threads parked on it, so that waking it only makes a system call if a thread is parked
+	//  (Threads parking on a signal must be able to write to it; a thread with a read-only mapping can park on the value alone, but is then only woken by the park timeout.)
+	struct Signal {
+		Atomic<uint32_t> value;
+		Atomic<uint32_t> waiters;
+	};
+
+private:
+	Mode _mode;
+	uint32_t _spinLimit;
+	uint32_t _yieldLimit;
+	unsigned long _parkTimeoutUs;
+	uint32_t _idleCount;
+
+	uint64_t _spins;
+	uint64_t _yields;
+	uint64_t _parks;
+
+	// Yields the CPU to other threads
+	static SMBB_INLINE void YieldThread();
+
+	// Parks the thread until woken or the timeout expires (if the value is not NULL, returns immediately if it does not equal the expected value, and counts the thread in the waiters if not NULL)
+	static SMBB_INLINE void Park(const Atomic<uint32_t> *value, Atomic<uint32_t> *waiters, uint32_t expected, unsigned long timeoutUs);
+
+	// Backs off once, parking on the value (if not NULL)
+	SMBB_INLINE void Backoff(const Atomic<uint32_t> *value, Atomic<uint32_t> *waiters, uint32_t expected);
+
+	// Wakes all threads parked on the value
+	static SMBB_INLINE void WakeAll(Atomic<uint32_t> &value);
+
+	// Waits until the value no longer equals the expected value, counting the thread in the waiters (if not NULL) while it is parked
+	uint32_t Wait(const Atomic<uint32_t> &value, Atomic<uint32_t> *waiters, uint32_t expected) {
+		uint32_t current;
+
+		while ((current = value.Load(MEMORY_ORDER_ACQUIRE)) == expected)
+			Backoff(&value, waiters, expected);
+
+		_idleCount = 0;
+		return current;
+	}
+
+public:
+	// Creates a wait strategy. The spin and yield limits only apply to hybrid mode.
+	explicit WaitStrategy(Mode mode = WAIT_HYBRID, uint32_t spinLimit = DEFAULT_SPIN_LIMIT, uint32_t yieldLimit = DEFAULT_YIELD_LIMIT, unsigned long parkTimeoutUs = DEFAULT_PARK_TIMEOUT_US) :
+		_mode(mode), _spinLimit(spinLimit), _yieldLimit(yieldLimit), _parkTimeoutUs(parkTimeoutUs), _idleCount(), _spins(), _yields(), _parks() { }
+
+	// Gets the mode of the strategy
+	Mode GetMode() const { return _mode; }
+
+	// Gets the number of times the strategy has spun, yielded, or parked
+	uint64_t GetSpins() const { return _spins; }
+	uint64_t GetYields() const { return _yields; }
+	uint64_t GetParks() const { return _parks; }
+
+	// Clears the spin, yield, and park statistics
+	void ClearStatistics() { _spins = 0; _yields = 0; _parks = 0; }
+
+	// Restarts the backoff after progress is made
+	void Reset() { _idleCount = 0; }
+
+	// Backs off once after a poll made no progress (parking sleeps for the park timeout)
+	void Idle() { Backoff(NULL, NULL, 0); }
+
+	// Backs off once after a poll found the value still equal to the expected value (parking returns early if the value changes and Wake() is called)
+	void Idle(const Atomic<uint32_t> &value, uint32_t expected) { Backoff(&value, NULL, expected); }
+	void Idle(Signal &signal, uint32_t expected) { Backoff(&signal.value, &signal.waiters, expected); }
+
+	// Waits until the value no longer equals the expected value, returning the new value
+	uint32_t Wait(const Atomic<uint32_t> &value, uint32_t expected) { return Wait(value, NULL, expected); }
+	uint32_t Wait(Signal &signal, uint32_t expected) { return Wait(signal.value, &signal.waiters, expected); }
+
+	// Wakes all threads (in any process) parked on the value, after it has been changed
+	static void Wake(Atomic<uint32_t> &value) { WakeAll(value); }
+
+	// Wakes all threads (in any process) parked on the signal after its value has been changed, without a system call if no thread is parked
+	static SMBB_INLINE void Wake(Signal &signal);
+};
+
+}
+
+#endif
@@ -0,0 +1,310 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_UTILITIES_ATOMIC_H
+#define SMBB_UTILITIES_ATOMIC_H
+
+// Select the atomic implementation: <atomic> for C++11 and newer, compiler builtins otherwise
+#if !defined(SMBB_NO_STD_ATOMIC) && ((defined(_MSC_VER) && _MSC_VER >= 1700) || __cplusplus >= 201103L)
+#define SMBB_ATOMIC_STD
+#include <atomic>
+#elif defined(__ATOMIC_SEQ_CST)
+#define SMBB_ATOMIC_BUILTIN
+#elif defined(__GNUC__)
+#define SMBB_ATOMIC_SYNC
+#elif defined(_WIN32)
+#define SMBB_ATOMIC_INTERLOCKED
+#else
+#error "No atomic implementation is available for this compiler"
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "IntegerTypes.h"
+
+namespace smbb {
+
+enum MemoryOrder {
+	MEMORY_ORDER_RELAXED = 0,
+	MEMORY_ORDER_ACQUIRE,
+	MEMORY_ORDER_RELEASE,
+	MEMORY_ORDER_ACQUIRE_RELEASE,
+	MEMORY_ORDER_SEQUENTIAL
+};
+
+namespace atomic_detail {
+
+// Restricts an order to those valid for loads
+inline MemoryOrder LoadOrder(MemoryOrder order) {
+	return order == MEMORY_ORDER_RELEASE ? MEMORY_ORDER_RELAXED : order == MEMORY_ORDER_ACQUIRE_RELEASE ? MEMORY_ORDER_ACQUIRE : order;
+}
+
+// Restricts an order to those valid for stores
+inline MemoryOrder StoreOrder(MemoryOrder order) {
+	return order == MEMORY_ORDER_ACQUIRE ? MEMORY_ORDER_RELAXED : order == MEMORY_ORDER_ACQUIRE_RELEASE ? MEMORY_ORDER_RELEASE : order;
+}
+
+#if defined(SMBB_ATOMIC_STD)
+inline std::memory_order Native(MemoryOrder order) {
+	switch (order) {
+	case MEMORY_ORDER_RELAXED: return std::memory_order_relaxed;
+	case MEMORY_ORDER_ACQUIRE: return std::memory_order_acquire;
+	case MEMORY_ORDER_RELEASE: return std::memory_order_release;
+	case MEMORY_ORDER_ACQUIRE_RELEASE: return std::memory_order_acq_rel;
+	default: return std::memory_order_seq_cst;
+	}
+}
+#elif defined(SMBB_ATOMIC_BUILTIN)
+inline int Native(MemoryOrder order) {
+	switch (order) {
+	case MEMORY_ORDER_RELAXED: return __ATOMIC_RELAXED;
+	case MEMORY_ORDER_ACQUIRE: return __ATOMIC_ACQUIRE;
+	case MEMORY_ORDER_RELEASE: return __ATOMIC_RELEASE;
+	case MEMORY_ORDER_ACQUIRE_RELEASE: return __ATOMIC_ACQ_REL;
+	default: return __ATOMIC_SEQ_CST;
+	}
+}
+#endif
+
+}
+
+// Issues a memory fence with the specified ordering
+inline void AtomicFence(MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+	std::atomic_thread_fence(atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+	__atomic_thread_fence(atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_SYNC)
+	if (order != MEMORY_ORDER_RELAXED)
+		__sync_synchronize();
+#else
+	if (order != MEMORY_ORDER_RELAXED)
+		MemoryBarrier();
+#endif
+}
+
+// Hints to the processor that the current thread is spinning (reduces power use and frees resources for a sibling hyper-thread)
+inline void CpuRelax() {
+#if defined(_MSC_VER)
+	YieldProcessor();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7))
+	__asm__ __volatile__("yield" ::: "memory");
+#elif defined(__GNUC__) && (defined(__powerpc__) || defined(__ppc__))
+	__asm__ __volatile__("or 27,27,27" ::: "memory");
+#elif defined(__GNUC__)
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// An atomic integer value that can be placed directly in shared memory (when it is lock-free) to be used across processes.
+//  Zero-initialized memory is a valid atomic value of zero. Loads never write to memory, so they are safe on read-only mappings.
+//  Supported types are 32-bit and 64-bit integers (8-bit and 16-bit integers are also supported, except when using the Interlocked implementation).
+template <typename T> class Atomic {
+#if defined(SMBB_ATOMIC_STD)
+	std::atomic<T> _value;
+#else
+	volatile T _value;
+#endif
+
+	// Disable copying
+	Atomic(const Atomic &);
+	Atomic &operator=(const Atomic &);
+
+#if defined(SMBB_ATOMIC_INTERLOCKED)
+	// Replaces the value, returning the previous value
+	T InterlockedReplace(T expected, T desired) {
+		if (sizeof(T) == sizeof(LONGLONG))
+			return static_cast<T>(InterlockedCompareExchange64(reinterpret_cast<volatile LONGLONG *>(&_value), static_cast<LONGLONG>(desired), static_cast<LONGLONG>(expected)));
+
+		return static_cast<T>(InterlockedCompareExchange(reinterpret_cast<volatile LONG *>(&_value), static_cast<LONG>(desired), static_cast<LONG>(expected)));
+	}
+#endif
+#if defined(SMBB_ATOMIC_SYNC) || defined(SMBB_ATOMIC_INTERLOCKED)
+	// Applies an operation using a compare-exchange loop, returning the previous value
+	template <typename Operation> T Apply(Operation operation, T operand) {
+		T expected = _value;
+
+		while (!CompareExchange(expected, operation(expected, operand)));
+
+		return expected;
+	}
+
+	static T Add(T value, T operand) { return static_cast<T>(value + operand); }
+	static T Subtract(T value, T operand) { return static_cast<T>(value - operand); }
+	static T Or(T value, T operand) { return static_cast<T>(value | operand); }
+	static T And(T value, T operand) { return static_cast<T>(value & operand); }
+	static T Replace(T, T operand) { return operand; }
+#endif
+
+public:
+	Atomic() : _value() { }
+	explicit Atomic(T value) : _value(value) { }
+
+	// Checks if operations on this type are lock-free (required for the value to be shared between processes)
+	static bool IsLockFree() {
+#if defined(SMBB_ATOMIC_STD)
+		static const Atomic instance;
+		return instance._value.is_lock_free();
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_always_lock_free(sizeof(T), 0);
+#elif defined(SMBB_ATOMIC_SYNC)
+		return sizeof(T) <= sizeof(void *);
+#else
+		return sizeof(T) == sizeof(LONG) || sizeof(T) == sizeof(LONGLONG);
+#endif
+	}
+
+	// Loads the value
+	T Load(MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) const {
+		order = atomic_detail::LoadOrder(order);
+#if defined(SMBB_ATOMIC_STD)
+		return _value.load(atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_load_n(&_value, atomic_detail::Native(order));
+#else
+		if (order == MEMORY_ORDER_SEQUENTIAL)
+			AtomicFence();
+
+		T value = _value;
+		AtomicFence(order);
+		return value;
+#endif
+	}
+
+	// Stores the value
+	void Store(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+		order = atomic_detail::StoreOrder(order);
+#if defined(SMBB_ATOMIC_STD)
+		_value.store(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		__atomic_store_n(&_value, value, atomic_detail::Native(order));
+#else
+		AtomicFence(order);
+		_value = value;
+
+		if (order == MEMORY_ORDER_SEQUENTIAL)
+			AtomicFence();
+#endif
+	}
+
+	// Replaces the value, returning the previous value
+	T Exchange(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.exchange(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_exchange_n(&_value, value, atomic_detail::Native(order));
+#else
+		(void)order;
+		return Apply(Replace, value);
+#endif
+	}
+
+	// Replaces the value with the desired value if it matches the expected value, returning true if successful (otherwise the expected value is updated with the current value)
+	bool CompareExchange(T &expected, T desired, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.compare_exchange_strong(expected, desired, atomic_detail::Native(order), atomic_detail::Native(atomic_detail::LoadOrder(order)));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_compare_exchange_n(&_value, &expected, desired, false, atomic_detail::Native(order), atomic_detail::Native(atomic_detail::LoadOrder(order)));
+#else
+		(void)order;
+#if defined(SMBB_ATOMIC_SYNC)
+		T previous = __sync_val_compare_and_swap(&_value, expected, desired);
+#else
+		T previous = InterlockedReplace(expected, desired);
+#endif
+		if (previous == expected)
+			return true;
+
+		expected = previous;
+		return false;
+#endif
+	}
+
+	// Adds to the value, returning the previous value
+	T FetchAdd(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.fetch_add(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_fetch_add(&_value, value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_SYNC)
+		(void)order;
+		return __sync_fetch_and_add(&_value, value);
+#else
+		(void)order;
+		return Apply(Add, value);
+#endif
+	}
+
+	// Subtracts from the value, returning the previous value
+	T FetchSubtract(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.fetch_sub(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_fetch_sub(&_value, value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_SYNC)
+		(void)order;
+		return __sync_fetch_and_sub(&_value, value);
+#else
+		(void)order;
+		return Apply(Subtract, value);
+#endif
+	}
+
+	// Performs a bitwise or on the value, returning the previous value
+	T FetchOr(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.fetch_or(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_fetch_or(&_value, value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_SYNC)
+		(void)order;
+		return __sync_fetch_and_or(&_value, value);
+#else
+		(void)order;
+		return Apply(Or, value);
+#endif
+	}
+
+	// Performs a bitwise and on the value, returning the previous value
+	T FetchAnd(T value, MemoryOrder order = MEMORY_ORDER_SEQUENTIAL) {
+#if defined(SMBB_ATOMIC_STD)
+		return _value.fetch_and(value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_BUILTIN)
+		return __atomic_fetch_and(&_value, value, atomic_detail::Native(order));
+#elif defined(SMBB_ATOMIC_SYNC)
+		(void)order;
+		return __sync_fetch_and_and(&_value, value);
+#else
+		(void)order;
+		return Apply(And, value);
+#endif
+	}
+};
+
+}
+
+#endif
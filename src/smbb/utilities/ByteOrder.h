@@ -0,0 +1,53 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_UTILITIES_BYTEORDER_H
+#define SMBB_UTILITIES_BYTEORDER_H
+
+#include <cstddef>
+
+#include "IntegerTypes.h"
+
+namespace smbb {
+
+// Stores an unsigned integer in network byte order (big-endian), so that it can be read on a host of any byte order
+template <typename T> inline void StoreNetworkOrder(uint8_t *data, T value) {
+	for (size_t i = sizeof(T); i > 0; i--) {
+		data[i - 1] = static_cast<uint8_t>(value);
+		value = static_cast<T>(value >> 8);
+	}
+}
+
+// Loads an unsigned integer stored in network byte order (big-endian)
+template <typename T> inline T LoadNetworkOrder(const uint8_t *data) {
+	T value = 0;
+
+	for (size_t i = 0; i < sizeof(T); i++)
+		value = static_cast<T>((value << 8) | data[i]);
+
+	return value;
+}
+
+}
+
+#endif
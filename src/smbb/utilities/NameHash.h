@@ -0,0 +1,48 @@
+
+/**
+Copyright (c) 2019-2020 Nick Little
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SMBB_UTILITIES_NAMEHASH_H
+#define SMBB_UTILITIES_NAMEHASH_H
+
+#include <cstddef>
+
+#include "IntegerTypes.h"
+
+namespace smbb {
+
+// Hashes a null-terminated name (FNV-1a) for quick comparison, returning false if the name is not valid (null, empty, or not shorter than maxSize)
+inline bool HashName(const char *name, size_t maxSize, uint32_t &hash, size_t &length) {
+	if (!name)
+		return false;
+
+	hash = 0x811c9dc5;
+
+	for (length = 0; name[length]; length++)
+		hash = (hash ^ static_cast<unsigned char>(name[length])) * 16777619;
+
+	return length > 0 && length < maxSize;
+}
+
+}
+
+#endif
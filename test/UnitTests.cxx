@@ -27,11 +27,28 @@ SOFTWARE.
 #include <iostream>
 #include <string>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
 #define SMBB_HEADER_ONLY
 #include "smbb/SMBB.h"
 
 using namespace smbb;
 
+#if !defined(_WIN32)
+// Claims a single position of a ring (used to block a thread behind an unpublished slot)
+static void *ClaimRingPosition(void *ring) {
+	uint64_t position = 0;
+
+	(void)static_cast<SharedMemoryRing *>(ring)->Claim(position);
+	return NULL;
+}
+#endif
+
 SCENARIO ("Shared Memory Utilities Test", "[SharedMemory], [Utilities]") {
 	GIVEN ("Some file-backed shared memory") {
 		SharedMemory testFile, testFileAutoDelete;
@@ -92,54 +109,1701 @@ SCENARIO ("Shared Memory Utilities Test", "[SharedMemory], [Utilities]") {
 	GIVEN ("Some named shared memory") {
 		SharedMemory testFile, testFileAutoDelete;
 
-		REQUIRE(testFile.CreateNamed("Test 1", SharedMemorySection::GetOffsetSize() + 4096, false) == SharedMemory::LOAD_SUCCESS);
-		REQUIRE(testFileAutoDelete.CreateNamed("Test 1-autodelete", SharedMemorySection::GetOffsetSize() + 4096, true) == SharedMemory::LOAD_SUCCESS);
+		REQUIRE(testFile.CreateNamed("Test 1", SharedMemorySection::GetOffsetSize() + 4096, false) == SharedMemory::LOAD_SUCCESS);
+		REQUIRE(testFileAutoDelete.CreateNamed("Test 1-autodelete", SharedMemorySection::GetOffsetSize() + 4096, true) == SharedMemory::LOAD_SUCCESS);
+
+		WHEN ("The shared memory is opened and the data modified") {
+			SharedMemorySection section1(testFile, SharedMemorySection::GetOffsetSize() + 4096);
+			SharedMemory testFile2;
+
+			REQUIRE(!section1.ReadOnly());
+			REQUIRE(testFile2.OpenNamed("Test 1") == SharedMemory::LOAD_SUCCESS);
+
+			THEN ("The memory in the created shared memory section matches the memory in the opened shared memory section") {
+				SharedMemorySection section2(testFile2, 4096, SharedMemorySection::GetOffsetSize());
+				SharedMemorySection section21(testFile2, 4096);
+
+				REQUIRE(section2.ReadOnly());
+				REQUIRE(section21.ReadOnly());
+
+				REQUIRE(section21.Size() == 4096);
+				REQUIRE(section21.Valid());
+
+				strcpy((char *)section1.Data(), "Test String 1");
+				strcpy((char *)section1.Data() + SharedMemorySection::GetOffsetSize(), "Test String 1");
+
+				REQUIRE(std::string((const char *)section2.Data()) == "Test String 1");
+
+				strcpy((char *)section1.Data() + SharedMemorySection::GetOffsetSize(), "Test String 2");
+
+				REQUIRE(std::string((const char *)section21.Data()) == "Test String 1");
+				REQUIRE(std::string((const char *)section2.Data()) == "Test String 2");
+			}
+		}
+
+		WHEN ("A mirrored shared memory section is mapped") {
+			const size_t size = SharedMemorySection::GetOffsetSize();
+			SharedMemorySection mirrored(testFile, size, SharedMemorySection::GetOffsetSize(), true);
+			SharedMemorySection unaligned(testFile, size - 8, 0, true);
+			SharedMemorySection section(testFile, size, SharedMemorySection::GetOffsetSize());
+
+			THEN ("Data written across the end of the section wraps to the start") {
+				REQUIRE(mirrored.Valid());
+				REQUIRE(mirrored.Mirrored());
+				REQUIRE(mirrored.Size() == size);
+				REQUIRE(!unaligned.Valid());
+
+				memcpy(mirrored.Data() + size - 4, "Wrapped!", 8);
+
+				REQUIRE(memcmp(section.Data(), "ped!", 4) == 0);
+				REQUIRE(memcmp(section.Data() + size - 4, "Wrap", 4) == 0);
+				REQUIRE(memcmp(mirrored.Data(), "ped!", 4) == 0);
+
+				section.Data()[10] = 'X';
+				REQUIRE(mirrored.Data()[size + 10] == 'X');
+			}
+		}
+
+		testFile.Close();
+		REQUIRE(SharedMemory::DeleteNamed("Test 1"));
+	}
+
+#if defined(__linux__)
+	GIVEN ("Some sealed anonymous shared memory") {
+		const size_t size = SharedMemorySection::GetOffsetSize();
+		SharedMemory memory;
+
+		REQUIRE(memory.CreateAnonymous("Test anonymous", size) == SharedMemory::LOAD_SUCCESS);
+		REQUIRE(memory.GetDescriptor() != -1);
+		REQUIRE(memory.GetSize() == SharedMemory::Size(size));
+		REQUIRE(memory.GetSeals() == 0);
+		REQUIRE(!memory.IsImmutable());
+
+		{
+			SharedMemorySection writer(memory, size);
+
+			REQUIRE(!writer.ReadOnly());
+			strcpy((char *)writer.Data(), "Sealed String");
+
+			// The content can not be sealed while it is writable
+			REQUIRE(!memory.AddSeals(SharedMemory::SEAL_WRITE));
+		}
+
+		WHEN ("The memory is sealed and opened from its descriptor") {
+			REQUIRE(memory.AddSeals(SharedMemory::SEAL_IMMUTABLE));
+
+			SharedMemory reader;
+
+			REQUIRE(reader.OpenDescriptor(memory.GetDescriptor(), false) == SharedMemory::LOAD_SUCCESS);
+
+			THEN ("The memory is immutable and can only be mapped read-only") {
+				SharedMemorySection section(reader, size);
+
+				REQUIRE(memory.IsImmutable());
+				REQUIRE(reader.IsImmutable());
+				REQUIRE(reader.GetSeals() == SharedMemory::SEAL_IMMUTABLE);
+				REQUIRE(reader.GetDescriptor() != memory.GetDescriptor());
+
+				REQUIRE(section.Valid());
+				REQUIRE(section.ReadOnly());
+				REQUIRE(std::string((const char *)section.Data()) == "Sealed String");
+
+				REQUIRE(!memory.AddSeals(SharedMemory::SEAL_GROW));
+				REQUIRE(ftruncate(memory.GetDescriptor(), size / 2) == -1);
+				REQUIRE(ftruncate(memory.GetDescriptor(), size * 2) == -1);
+				REQUIRE(reader.GetSize() == SharedMemory::Size(size));
+			}
+		}
+
+		WHEN ("The memory is created without sealing") {
+			SharedMemory unsealable;
+
+			REQUIRE(unsealable.CreateAnonymous("Test unsealable", size, false) == SharedMemory::LOAD_SUCCESS);
+
+			THEN ("No seals can be added") {
+				REQUIRE(!unsealable.AddSeals(SharedMemory::SEAL_SHRINK));
+				REQUIRE(!unsealable.IsImmutable());
+				REQUIRE(unsealable.CreateAnonymous(NULL, size) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(unsealable.CreateAnonymous("Test unsealable", 0) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(unsealable.OpenDescriptor(-1) != SharedMemory::LOAD_SUCCESS);
+			}
+		}
+	}
+#endif
+
+	GIVEN ("Bad attempts to create or open shared memory") {
+		WHEN ("The create or open calls are made") {
+			SharedMemory testFile;
+
+			THEN ("The requests fail") {
+				REQUIRE(testFile.CreateFileBacked(NULL, SharedMemorySection::GetOffsetSize() + 4096, true) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(testFile.CreateFileBacked(NULL, -1, true) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(testFile.OpenFileBacked(NULL) != SharedMemory::LOAD_SUCCESS);
+
+				REQUIRE(testFile.CreateNamed(NULL, SharedMemorySection::GetOffsetSize() + 4096) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(testFile.CreateNamed(NULL, -1) != SharedMemory::LOAD_SUCCESS);
+				REQUIRE(testFile.OpenNamed(NULL) != SharedMemory::LOAD_SUCCESS);
+			}
+		}
+	}
+}
+
+SCENARIO ("Shared Memory Mapping Pool Test", "[SharedMemory], [SharedMemoryMappingPool]") {
+	GIVEN ("A pool of mappings of some shared memory") {
+		const size_t pageSize = SharedMemorySection::GetOffsetSize();
+		SharedMemory memory;
+		SharedMemory::DeleteNamed("Test Mapping Pool");
+		REQUIRE(memory.CreateNamed("Test Mapping Pool", static_cast<SharedMemory::Size>(pageSize * 8), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(memory, pageSize * 8);
+		SharedMemoryMappingPool pool(pageSize * 4);
+		SharedMemoryMappingPool::Mapping first, second, third;
+
+		REQUIRE(section.Valid());
+		strcpy(reinterpret_cast<char *>(section.Data()) + pageSize + 10, "Pooled");
+
+		WHEN ("Overlapping ranges are mapped") {
+			REQUIRE(pool.Acquire(memory, 0, 0, first) == SharedMemoryMappingPool::MAPPING_FAILED_BAD_SIZE);
+			REQUIRE(pool.Acquire(memory, pageSize * 2, static_cast<SharedMemory::Size>(pageSize), first) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+			REQUIRE(pool.Acquire(memory, 6, static_cast<SharedMemory::Size>(pageSize + 10), second) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+
+			THEN ("The existing mapping is reused") {
+				REQUIRE(pool.GetMisses() == 1);
+				REQUIRE(pool.GetHits() == 1);
+				REQUIRE(pool.GetMappedSize() == pageSize * 2);
+				REQUIRE(second.Data() == first.Data() + 10);
+				REQUIRE(std::string(reinterpret_cast<const char *>(second.Data())) == "Pooled");
+
+				pool.Release(second);
+				REQUIRE(!second.Valid());
+			}
+
+			THEN ("Unreferenced mappings are evicted to stay within the size limit") {
+				REQUIRE(pool.Acquire(memory, pageSize * 3, 0, third) == SharedMemoryMappingPool::MAPPING_FAILED_FULL);
+
+				pool.Release(first);
+				REQUIRE(pool.Acquire(memory, pageSize * 3, 0, third) == SharedMemoryMappingPool::MAPPING_FAILED_FULL);
+
+				pool.Release(second);
+				REQUIRE(pool.Acquire(memory, pageSize * 3, 0, third) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+				REQUIRE(pool.GetMappedSize() == pageSize * 3);
+				REQUIRE(std::string(reinterpret_cast<const char *>(third.Data()) + pageSize + 10) == "Pooled");
+				REQUIRE(pool.Acquire(memory, 1, static_cast<SharedMemory::Size>(pageSize * 5), first) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+				REQUIRE(!pool.Remove(memory));
+
+				pool.Release(first);
+				pool.Release(third);
+				REQUIRE(pool.Remove(memory));
+				REQUIRE(pool.GetMappedSize() == 0);
+			}
+		}
+
+		WHEN ("The shared memory is closed and other shared memory is opened in its place") {
+			REQUIRE(pool.Acquire(memory, 6, static_cast<SharedMemory::Size>(pageSize + 10), first) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+			pool.Release(first);
+			section.Unmap();
+			memory.Close();
+
+			REQUIRE(memory.CreateNamed("Test Mapping Pool", static_cast<SharedMemory::Size>(pageSize * 8), true) == SharedMemory::LOAD_SUCCESS);
+			REQUIRE(section.Map(memory, pageSize * 8));
+			strcpy(reinterpret_cast<char *>(section.Data()) + pageSize + 10, "Reopen");
+
+			THEN ("The stale mapping is not reused") {
+				REQUIRE(pool.Acquire(memory, 6, static_cast<SharedMemory::Size>(pageSize + 10), second) == SharedMemoryMappingPool::MAPPING_SUCCESS);
+				REQUIRE(pool.GetMisses() == 2);
+				REQUIRE(pool.GetHits() == 0);
+				REQUIRE(std::string(reinterpret_cast<const char *>(second.Data()), 6) == "Reopen");
+
+				pool.Release(second);
+				pool.Clear();
+				REQUIRE(pool.GetMappedSize() == 0);
+			}
+		}
+	}
+}
+
+#if !defined(_WIN32)
+SCENARIO ("Shared Memory Channel Test", "[SharedMemory], [SharedMemoryChannel]") {
+	GIVEN ("A connected pair of channels") {
+		const size_t size = SharedMemorySection::GetOffsetSize();
+		SharedMemoryChannel sender, receiver;
+		SharedMemory memory;
+
+		REQUIRE(SharedMemoryChannel::CreatePair(sender, receiver) == SharedMemoryChannel::CHANNEL_SUCCESS);
+		REQUIRE(sender.Valid());
+		REQUIRE(receiver.Valid());
+		REQUIRE(memory.CreateNamed("Test channel", size, true) == SharedMemory::LOAD_SUCCESS);
+
+		{
+			SharedMemorySection section(memory, size);
+			strcpy((char *)section.Data(), "Channel String");
+		}
+
+		WHEN ("Shared memory is sent to the peer") {
+			SharedMemory received;
+			SharedMemory::Size receivedSize = 0;
+			uint64_t tag = 0;
+
+			REQUIRE(sender.Send(memory, 42) == SharedMemoryChannel::CHANNEL_SUCCESS);
+			REQUIRE(receiver.Receive(received, receivedSize, tag) == SharedMemoryChannel::CHANNEL_SUCCESS);
+
+			THEN ("The peer maps the same memory with the same size and access") {
+				SharedMemorySection section(received, static_cast<size_t>(receivedSize));
+				SharedMemorySection original(memory, size);
+
+				REQUIRE(receivedSize == SharedMemory::Size(size));
+				REQUIRE(tag == 42);
+				REQUIRE(!section.ReadOnly());
+				REQUIRE(std::string((const char *)section.Data()) == "Channel String");
+
+				section.Data()[0] = 'c';
+				REQUIRE(original.Data()[0] == 'c');
+			}
+		}
+
+		WHEN ("Nothing or an invalid memory is sent") {
+			SharedMemory received, invalid;
+			SharedMemory::Size receivedSize = 0;
+
+			REQUIRE(sender.Send(invalid) == SharedMemoryChannel::CHANNEL_FAILED_BAD_MEMORY);
+
+			THEN ("Receiving fails once the sender is closed") {
+				sender.Close();
+				REQUIRE(sender.Send(memory) == SharedMemoryChannel::CHANNEL_FAILED_BAD_SOCKET);
+				REQUIRE(receiver.Receive(received, receivedSize) == SharedMemoryChannel::CHANNEL_CLOSED);
+				REQUIRE(received.GetDescriptor() == -1);
+			}
+		}
+
+		WHEN ("Part of a message is received on a non-blocking socket") {
+			SharedMemory received;
+			SharedMemory::Size receivedSize = 0;
+			uint64_t tag = 0;
+			const uint32_t start[2] = { 0x534D4246, 0 };
+			const uint64_t rest[2] = { size, 9 };
+			const int descriptor = memory.GetDescriptor();
+			union { struct cmsghdr header; char data[CMSG_SPACE(sizeof(int))]; } control;
+			struct iovec buffer = { const_cast<uint32_t *>(start), sizeof(start) };
+			struct msghdr header;
+
+			memset(&control, 0, sizeof(control));
+			memset(&header, 0, sizeof(header));
+			header.msg_iov = &buffer;
+			header.msg_iovlen = 1;
+			header.msg_control = control.data;
+			header.msg_controllen = CMSG_SPACE(sizeof(int));
+			CMSG_FIRSTHDR(&header)->cmsg_level = SOL_SOCKET;
+			CMSG_FIRSTHDR(&header)->cmsg_type = SCM_RIGHTS;
+			CMSG_FIRSTHDR(&header)->cmsg_len = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(CMSG_FIRSTHDR(&header)), &descriptor, sizeof(int));
+
+			REQUIRE(fcntl(receiver.GetHandle(), F_SETFL, fcntl(receiver.GetHandle(), F_GETFL) | O_NONBLOCK) == 0);
+			REQUIRE(receiver.Receive(received, receivedSize) == SharedMemoryChannel::CHANNEL_EMPTY);
+			REQUIRE(sendmsg(sender.GetHandle(), &header, 0) == ssize_t(sizeof(start)));
+
+			THEN ("Receiving would block until the rest of the message arrives") {
+				REQUIRE(receiver.Receive(received, receivedSize, tag) == SharedMemoryChannel::CHANNEL_WOULD_BLOCK);
+				REQUIRE(receiver.Receive(received, receivedSize, tag) == SharedMemoryChannel::CHANNEL_WOULD_BLOCK);
+				REQUIRE(send(sender.GetHandle(), rest, sizeof(rest), 0) == ssize_t(sizeof(rest)));
+				REQUIRE(receiver.Receive(received, receivedSize, tag) == SharedMemoryChannel::CHANNEL_SUCCESS);
+				REQUIRE(receivedSize == SharedMemory::Size(size));
+				REQUIRE(tag == 9);
+
+				SharedMemorySection section(received, static_cast<size_t>(receivedSize));
+				REQUIRE(std::string((const char *)section.Data()) == "Channel String");
+			}
+		}
+
+#if defined(__linux__)
+		WHEN ("Sealed anonymous memory is sent to a worker process") {
+			SharedMemory session;
+
+			REQUIRE(session.CreateAnonymous("Test session", size) == SharedMemory::LOAD_SUCCESS);
+
+			{
+				SharedMemorySection section(session, size);
+				strcpy((char *)section.Data(), "Session String");
+			}
+
+			REQUIRE(session.AddSeals(SharedMemory::SEAL_IMMUTABLE));
+
+			const pid_t pid = fork();
+
+			if (pid == 0) {
+				SharedMemory received;
+				SharedMemory::Size receivedSize = 0;
+				uint64_t tag = 0;
+
+				sender.Close();
+
+				if (receiver.Receive(received, receivedSize, tag) != SharedMemoryChannel::CHANNEL_SUCCESS || tag != 7 || !received.IsImmutable())
+					_exit(1);
+
+				SharedMemorySection section(received, static_cast<size_t>(receivedSize));
+				_exit(section.ReadOnly() && strcmp((const char *)section.Data(), "Session String") == 0 ? 0 : 2);
+			}
+
+			REQUIRE(pid > 0);
+			REQUIRE(sender.Send(session, 7) == SharedMemoryChannel::CHANNEL_SUCCESS);
+
+			THEN ("The worker maps the immutable memory without a name") {
+				int status = 0;
+
+				REQUIRE(waitpid(pid, &status, 0) == pid);
+				REQUIRE(WIFEXITED(status));
+				REQUIRE(WEXITSTATUS(status) == 0);
+			}
+		}
+#endif
+	}
+}
+#endif
+
+SCENARIO ("Atomic Test", "[SharedMemory], [Atomic]") {
+	GIVEN ("Atomic values in plain shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMemorySection::GetOffsetSize();
+
+		REQUIRE(Atomic<uint32_t>::IsLockFree());
+		REQUIRE(Atomic<uint64_t>::IsLockFree());
+		REQUIRE(sizeof(Atomic<uint32_t>) == sizeof(uint32_t));
+		REQUIRE(sizeof(Atomic<uint64_t>) == sizeof(uint64_t));
+
+		SharedMemory::DeleteNamed("Test Atomic");
+		REQUIRE(testFile.CreateNamed("Test Atomic", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		Atomic<uint32_t> *value32 = reinterpret_cast<Atomic<uint32_t> *>(section.Data());
+		Atomic<uint64_t> *value64 = reinterpret_cast<Atomic<uint64_t> *>(section.Data() + 8);
+
+		WHEN ("Atomic operations are performed") {
+			uint32_t expected = 1;
+
+			REQUIRE(value32->Load() == 0);
+			REQUIRE(!value32->CompareExchange(expected, 5, MEMORY_ORDER_ACQUIRE_RELEASE));
+			REQUIRE(expected == 0);
+			REQUIRE(value32->CompareExchange(expected, 5, MEMORY_ORDER_ACQUIRE_RELEASE));
+			REQUIRE(value32->FetchAdd(3, MEMORY_ORDER_RELAXED) == 5);
+			REQUIRE(value32->FetchSubtract(2) == 8);
+			REQUIRE(value32->FetchOr(0x10) == 6);
+			REQUIRE(value32->FetchAnd(0x12) == 0x16);
+			REQUIRE(value32->Exchange(7, MEMORY_ORDER_ACQUIRE) == 0x12);
+			value64->Store(uint64_t(1) << 40, MEMORY_ORDER_RELEASE);
+			AtomicFence();
+			CpuRelax();
+
+			THEN ("The values are visible through another mapping") {
+				SharedMemory testFile2;
+				REQUIRE(testFile2.OpenNamed("Test Atomic") == SharedMemory::LOAD_SUCCESS);
+
+				SharedMemorySection section2(testFile2, size);
+
+				REQUIRE(reinterpret_cast<const Atomic<uint32_t> *>(section2.Data())->Load(MEMORY_ORDER_ACQUIRE) == 7);
+				REQUIRE(reinterpret_cast<const Atomic<uint64_t> *>(section2.Data() + 8)->Load(MEMORY_ORDER_RELAXED) == uint64_t(1) << 40);
+			}
+		}
+#if !defined(_WIN32)
+		WHEN ("Two processes increment the same value") {
+			const uint64_t increments = 100000;
+			pid_t child = fork();
+
+			REQUIRE(child >= 0);
+
+			for (uint64_t i = 0; i < increments; i++)
+				value64->FetchAdd(1, MEMORY_ORDER_RELAXED);
+
+			if (child == 0)
+				_exit(0);
+
+			int status = 0;
+			REQUIRE(waitpid(child, &status, 0) == child);
+
+			THEN ("No increments are lost") {
+				REQUIRE(value64->Load() == 2 * increments);
+			}
+		}
+#endif
+	}
+}
+
+SCENARIO ("Wait Strategy Test", "[SharedMemory], [WaitStrategy]") {
+	GIVEN ("A hybrid wait strategy") {
+		WaitStrategy strategy(WaitStrategy::WAIT_HYBRID, 3, 2, 100);
+
+		WHEN ("The strategy is idled repeatedly") {
+			for (int i = 0; i < 7; i++)
+				strategy.Idle();
+
+			THEN ("It spins, then yields, then parks") {
+				REQUIRE(strategy.GetSpins() == 3);
+				REQUIRE(strategy.GetYields() == 2);
+				REQUIRE(strategy.GetParks() == 2);
+			}
+
+			THEN ("It spins again after being reset") {
+				strategy.Reset();
+				strategy.Idle();
+
+				REQUIRE(strategy.GetSpins() == 4);
+				REQUIRE(strategy.GetParks() == 2);
+
+				strategy.ClearStatistics();
+				REQUIRE(strategy.GetSpins() == 0);
+				REQUIRE(strategy.GetYields() == 0);
+				REQUIRE(strategy.GetParks() == 0);
+			}
+		}
+	}
+
+	GIVEN ("Fixed wait strategies") {
+		WaitStrategy spin(WaitStrategy::WAIT_BUSY_SPIN), yield(WaitStrategy::WAIT_YIELD), park(WaitStrategy::WAIT_PARK, 0, 0, 100);
+		Atomic<uint32_t> value(1);
+
+		WHEN ("Each strategy is idled on a value that has already changed") {
+			for (int i = 0; i < 3; i++) {
+				spin.Idle(value, 0);
+				yield.Idle(value, 0);
+				park.Idle(value, 0);
+			}
+
+			THEN ("Each strategy only uses its own mode") {
+				REQUIRE(spin.GetSpins() == 3);
+				REQUIRE(spin.GetYields() + spin.GetParks() == 0);
+				REQUIRE(yield.GetYields() == 3);
+				REQUIRE(yield.GetSpins() + yield.GetParks() == 0);
+				REQUIRE(park.GetParks() == 3);
+				REQUIRE(park.GetSpins() + park.GetYields() == 0);
+				REQUIRE(park.Wait(value, 0) == 1);
+			}
+		}
+	}
+#if !defined(_WIN32)
+	GIVEN ("A value in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMemorySection::GetOffsetSize();
+
+		SharedMemory::DeleteNamed("Test Wait");
+		REQUIRE(testFile.CreateNamed("Test Wait", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		Atomic<uint32_t> *value = reinterpret_cast<Atomic<uint32_t> *>(section.Data());
+
+		WHEN ("Another process changes the value and wakes the waiter") {
+			pid_t child = fork();
+
+			REQUIRE(child >= 0);
+
+			if (child == 0) {
+				usleep(20000);
+				value->Store(5, MEMORY_ORDER_RELEASE);
+				WaitStrategy::Wake(*value);
+				_exit(0);
+			}
+
+			WaitStrategy strategy(WaitStrategy::WAIT_HYBRID, 10, 10, 1000000);
+			uint32_t result = strategy.Wait(*value, 0);
+			int status = 0;
+
+			REQUIRE(waitpid(child, &status, 0) == child);
+
+			THEN ("The waiter sees the new value") {
+				REQUIRE(result == 5);
+				REQUIRE(strategy.GetSpins() == 10);
+				REQUIRE(strategy.GetYields() == 10);
+				REQUIRE(strategy.GetParks() >= 1);
+			}
+		}
+
+		WHEN ("Another process changes a signal and wakes the waiter") {
+			WaitStrategy::Signal *signal = reinterpret_cast<WaitStrategy::Signal *>(section.Data());
+			pid_t child = fork();
+
+			REQUIRE(child >= 0);
+
+			if (child == 0) {
+				// Wait for the parent to park, so that the wake is not skipped
+				while (signal->waiters.Load(MEMORY_ORDER_ACQUIRE) == 0)
+					usleep(1000);
+
+				signal->value.Store(7, MEMORY_ORDER_RELEASE);
+				WaitStrategy::Wake(*signal);
+				_exit(0);
+			}
+
+			WaitStrategy strategy(WaitStrategy::WAIT_PARK, 0, 0, 10000000);
+			uint32_t result = strategy.Wait(*signal, 0);
+			int status = 0;
+
+			REQUIRE(waitpid(child, &status, 0) == child);
+
+			THEN ("The waiter is woken before its park timeout and is no longer counted") {
+				REQUIRE(result == 7);
+				REQUIRE(strategy.GetParks() == 1);
+				REQUIRE(signal->waiters.Load() == 0);
+			}
+		}
+	}
+#endif
+}
+
+SCENARIO ("Shared Memory Directory Test", "[SharedMemory], [SharedMemoryDirectory]") {
+	GIVEN ("A directory in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMemoryDirectory::GetRequiredSize(4, 4096);
+
+		SharedMemory::DeleteNamed("Test Directory");
+		REQUIRE(testFile.CreateNamed("Test Directory", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMemoryDirectory directory;
+
+		REQUIRE(directory.Create(section, 4) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+
+		WHEN ("Sub-regions are allocated") {
+			SharedMemoryDirectory::Region first, second, duplicate, third;
+
+			REQUIRE(directory.Allocate("first", 10, first) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+			REQUIRE(directory.Allocate("second", 1000, second, 256) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+			REQUIRE(directory.Allocate("first", 20, duplicate) == SharedMemoryDirectory::DIRECTORY_ALREADY_EXISTS);
+			REQUIRE(directory.Allocate("third", 0, third, 3) == SharedMemoryDirectory::DIRECTORY_FAILED_BAD_SIZE);
+			REQUIRE(directory.Allocate("", 10, third) == SharedMemoryDirectory::DIRECTORY_FAILED_BAD_NAME);
+			REQUIRE(directory.Allocate("third", 4096, third) == SharedMemoryDirectory::DIRECTORY_FAILED_OUT_OF_SPACE);
+
+			strcpy((char *)first.Data(), "First");
+			strcpy((char *)second.Data(), "Second");
+
+			THEN ("The sub-regions are aligned, distinct and can be found by another process") {
+				REQUIRE(directory.Count() == 2);
+				REQUIRE(duplicate.Data() == first.Data());
+				REQUIRE(duplicate.Size() == 10);
+				REQUIRE(first.Offset() % SharedMemoryDirectory::DEFAULT_ALIGNMENT == 0);
+				REQUIRE(second.Offset() % 256 == 0);
+				REQUIRE(second.Offset() >= first.Offset() + first.Size());
+
+				SharedMemory testFile2;
+				REQUIRE(testFile2.OpenNamed("Test Directory") == SharedMemory::LOAD_SUCCESS);
+
+				SharedMemorySection section2(testFile2, size);
+				SharedMemoryDirectory directory2;
+				SharedMemoryDirectory::Region found, missing;
+
+				REQUIRE(directory2.Open(section2) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+				REQUIRE(directory2.Count() == 2);
+				REQUIRE(std::string(directory2.GetName(1)) == "second");
+				REQUIRE(directory2.Find("second", found) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+				REQUIRE(found.Offset() == second.Offset());
+				REQUIRE(found.Size() == 1000);
+				REQUIRE(std::string((const char *)found.Data()) == "Second");
+				REQUIRE(directory2.Find("third", missing) == SharedMemoryDirectory::DIRECTORY_FAILED_NOT_FOUND);
+				REQUIRE(directory2.Allocate("third", 10, missing) == SharedMemoryDirectory::DIRECTORY_FAILED_READ_ONLY);
+			}
+		}
+
+		WHEN ("The directory is filled") {
+			SharedMemoryDirectory::Region region;
+			const char *names[] = { "a", "b", "c", "d" };
+
+			for (size_t i = 0; i < 4; i++)
+				REQUIRE(directory.Allocate(names[i], 8, region) == SharedMemoryDirectory::DIRECTORY_SUCCESS);
+
+			THEN ("No more sub-regions can be allocated") {
+				REQUIRE(directory.Allocate("e", 8, region) == SharedMemoryDirectory::DIRECTORY_FAILED_FULL);
+			}
+		}
+
+		WHEN ("Memory without a directory is opened") {
+			uint8_t empty[256] = { };
+			SharedMemoryDirectory badDirectory;
+
+			THEN ("The open fails") {
+				REQUIRE(badDirectory.Open(empty, sizeof(empty)) == SharedMemoryDirectory::DIRECTORY_FAILED_BAD_MEMORY);
+				REQUIRE(!badDirectory.Valid());
+			}
+		}
+	}
+}
+
+SCENARIO ("Shared Memory Ring Test", "[SharedMemory], [SharedMemoryRing]") {
+	GIVEN ("A ring in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMemoryRing::GetRequiredSize(64, 8);
+
+		SharedMemory::DeleteNamed("Test Ring");
+		REQUIRE(testFile.CreateNamed("Test Ring", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMemoryRing ring;
+
+		REQUIRE(ring.Create(section, 60, 8) == SharedMemoryRing::RING_FAILED_BAD_SIZE);
+		REQUIRE(ring.Create(section, 64, 6) == SharedMemoryRing::RING_FAILED_BAD_SIZE);
+		REQUIRE(ring.Create(section, 64, 16) == SharedMemoryRing::RING_FAILED_BAD_SIZE);
+		REQUIRE(ring.Create(section, 64, 8) == SharedMemoryRing::RING_SUCCESS);
+		REQUIRE(ring.GetSlotSize() == 64);
+		REQUIRE(ring.GetSlotCount() == 8);
+
+		SharedMemory testFile2;
+		REQUIRE(testFile2.OpenNamed("Test Ring") == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section2(testFile2, size);
+		SharedMemoryRing reader;
+
+		REQUIRE(reader.Open(section2) == SharedMemoryRing::RING_SUCCESS);
+
+		WHEN ("Messages are written") {
+			char buffer[64];
+			uint32_t length = 0;
+			uint32_t flags = 0;
+			uint64_t position = reader.GetWritePosition();
+
+			REQUIRE(reader.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_EMPTY);
+			REQUIRE(ring.Write("Message 1", 10, 3) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.Write("Message 2", 10) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.Write(buffer, 65) == SharedMemoryRing::RING_FAILED_TOO_LARGE);
+
+			THEN ("They are read in order from the read-only mapping") {
+				REQUIRE(reader.Write("Message 3", 10) == SharedMemoryRing::RING_FAILED_READ_ONLY);
+				REQUIRE(reader.Read(position, buffer, 4, length) == SharedMemoryRing::RING_FAILED_TOO_LARGE);
+				REQUIRE(reader.Read(position, buffer, sizeof(buffer), length, &flags) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(std::string(buffer) == "Message 1");
+				REQUIRE(flags == 3);
+				REQUIRE(reader.Read(position, buffer, sizeof(buffer), length, &flags) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(std::string(buffer) == "Message 2");
+				REQUIRE(length == 10);
+				REQUIRE(flags == 0);
+				REQUIRE(position == 2);
+				REQUIRE(reader.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_EMPTY);
+			}
+		}
+
+		WHEN ("The reader falls more than a full ring behind") {
+			char buffer[64];
+			uint32_t length = 0;
+			uint64_t position = 0;
+
+			for (uint32_t i = 0; i < 20; i++)
+				REQUIRE(ring.Write(&i, sizeof(i)) == SharedMemoryRing::RING_SUCCESS);
+
+			THEN ("The reader is told it was overrun and skips to the oldest message") {
+				REQUIRE(reader.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_OVERRUN);
+				REQUIRE(position == 12);
+				REQUIRE(reader.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(*reinterpret_cast<uint32_t *>(buffer) == 12);
+			}
+		}
+
+		WHEN ("Consecutive slots are claimed and published") {
+			uint64_t position = 0;
+
+			REQUIRE(ring.Claim(position, 9) == SharedMemoryRing::RING_FAILED_TOO_LARGE);
+			REQUIRE(ring.Claim(position, 3) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(position == 0);
+
+			for (uint32_t i = 0; i < 3; i++) {
+				memset(ring.GetPayload(position + i), 'a' + i, 64);
+				ring.Publish(position + i, 64);
+			}
+
+			THEN ("The payloads can be read in place as one block") {
+				const uint8_t *data = NULL;
+				uint32_t length = 0;
+				uint32_t flags = 0;
+
+				REQUIRE(reader.Peek(position, data, length, flags) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(length == 64);
+				REQUIRE(data[0] == 'a');
+				REQUIRE(data[64] == 'b');
+				REQUIRE(data[191] == 'c');
+				REQUIRE(reader.Validate(position));
+				REQUIRE(reader.GetWritePosition() == 3);
+			}
+		}
+
+		WHEN ("Messages larger than a slot are written") {
+			uint8_t message[200];
+			uint8_t buffer[512];
+			const uint8_t *data = NULL;
+			uint32_t length = 0;
+			uint32_t flags = 0;
+			uint32_t slots = 0;
+			uint64_t position = 0;
+
+			for (size_t i = 0; i < sizeof(message); i++)
+				message[i] = static_cast<uint8_t>(i);
+
+			REQUIRE(ring.WriteMessage(message, 8 * 64 + 1) == SharedMemoryRing::RING_FAILED_TOO_LARGE);
+			REQUIRE(ring.WriteMessage(message, 130) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.WriteMessage(message, 0) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.WriteMessage(message + 10, 100, 5) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.GetWritePosition() == 6);
+			REQUIRE(ring.WriteMessage(message, 200, 6) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.GetWritePosition() == 10);
+
+			THEN ("A message that does not wrap is read in place") {
+				position = 4;
+
+				REQUIRE(reader.PeekMessage(position, data, length, flags, slots) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(slots == 2);
+				REQUIRE(length == 100);
+				REQUIRE(flags == 5);
+				REQUIRE(data == section2.Data() + section2.Size() - 4 * 64);
+				REQUIRE(memcmp(data, message + 10, 100) == 0);
+				REQUIRE(reader.ValidateMessage(position, slots));
+			}
+
+			THEN ("The overwritten message is skipped and a message that wraps is reassembled") {
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_OVERRUN);
+				REQUIRE(position == 2);
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_OVERRUN);
+				REQUIRE(position == 3);
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(length == 0);
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length, &flags) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(length == 100);
+				REQUIRE(flags == 5);
+				REQUIRE(memcmp(buffer, message + 10, 100) == 0);
+				REQUIRE(reader.PeekMessage(position, data, length, flags, slots) == SharedMemoryRing::RING_FAILED_TOO_LARGE);
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length, &flags) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(length == 200);
+				REQUIRE(flags == 6);
+				REQUIRE(memcmp(buffer, message, 200) == 0);
+				REQUIRE(position == 10);
+				REQUIRE(reader.ReadMessage(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_EMPTY);
+			}
+
+			THEN ("A message with a torn middle fragment is reported as overrun without writing past the buffer") {
+				// Shorten the second fragment of the wrapped message (the slot states follow the 128 byte header, and the length follows the 8 byte sequence)
+				const uint32_t torn = 0;
+
+				memcpy(section.Data() + 128 + 7 * 16 + 8, &torn, sizeof(torn));
+				memset(buffer, 0xCC, sizeof(buffer));
+				position = 6;
+
+				REQUIRE(reader.ReadMessage(position, buffer, 200, length) == SharedMemoryRing::RING_OVERRUN);
+
+				for (size_t i = 200; i < sizeof(buffer); i++)
+					REQUIRE(buffer[i] == 0xCC);
+			}
+		}
+	}
+#if !defined(_WIN32)
+	GIVEN ("A ring owned by a producer that dies in the middle of a write") {
+		SharedMemory testFile;
+		const size_t size = SharedMemoryRing::GetRequiredSize(64, 8);
+
+		SharedMemory::DeleteNamed("Test Ring Owner");
+		REQUIRE(testFile.CreateNamed("Test Ring Owner", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMemoryRing ring;
+
+		REQUIRE(ring.Create(section, 64, 8) == SharedMemoryRing::RING_SUCCESS);
+		REQUIRE(ring.GetOwner() == 0);
+		REQUIRE(ProcessOwner::IsAlive(ProcessOwner::GetCurrent()));
+		REQUIRE(!ProcessOwner::IsAlive(0));
+
+		pid_t child = fork();
+
+		REQUIRE(child >= 0);
+
+		if (child == 0) {
+			uint64_t position = 0;
+			bool success = ring.TakeOwnership() == SharedMemoryRing::RING_SUCCESS && ring.Write("Message 1", 10) == SharedMemoryRing::RING_SUCCESS &&
+				ring.Claim(position, 2) == SharedMemoryRing::RING_SUCCESS;
+
+			if (success)
+				ring.Publish(position, 0);
+
+			_exit(success ? 0 : 1);
+		}
+
+		int status = 0;
+		REQUIRE(waitpid(child, &status, 0) == child);
+		REQUIRE(WIFEXITED(status));
+		REQUIRE(WEXITSTATUS(status) == 0);
+
+		const ProcessOwner::Owner owner = ring.GetOwner();
+
+		REQUIRE(ProcessOwner::GetProcessId(owner) == static_cast<uint32_t>(child));
+		REQUIRE(!ProcessOwner::IsAlive(owner));
+		REQUIRE(ring.GetWritePosition() == 3);
+
+		WHEN ("A consumer reaches the unpublished slot") {
+			char buffer[64];
+			uint32_t length = 0;
+			uint64_t position = 0;
+
+			REQUIRE(ring.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(ring.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(length == 0);
+			REQUIRE(ring.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_EMPTY);
+
+			THEN ("The consumer can skip the stalled slot without writing to the ring") {
+				REQUIRE(ring.SkipStalled(position) == SharedMemoryRing::RING_ABORTED);
+				REQUIRE(position == 3);
+				REQUIRE(ring.SkipStalled(position) == SharedMemoryRing::RING_EMPTY);
+			}
+
+			THEN ("A new producer takes over after the unpublished slot is aborted") {
+				uint32_t aborted = 0;
+
+				REQUIRE(ring.Recover(&aborted) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(aborted == 1);
+				REQUIRE(ring.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_ABORTED);
+				REQUIRE(position == 3);
+
+				REQUIRE(ring.TakeOwnership() == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(ring.GetOwner() == ProcessOwner::GetCurrent());
+				REQUIRE(ring.Recover() == SharedMemoryRing::RING_FAILED_OWNED);
+				REQUIRE(ring.Write("Message 2", 10) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(ring.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(std::string(buffer) == "Message 2");
+
+				ring.ReleaseOwnership();
+				REQUIRE(ring.GetOwner() == 0);
+			}
+		}
+	}
+	GIVEN ("A ring owned by a producer that dies while another of its threads waits to reuse an unpublished slot") {
+		SharedMemory testFile;
+		const size_t size = SharedMemoryRing::GetRequiredSize(64, 8);
+
+		SharedMemory::DeleteNamed("Test Ring Owner Threads");
+		REQUIRE(testFile.CreateNamed("Test Ring Owner Threads", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMemoryRing ring;
+		SharedMemoryRing producer;
+
+		REQUIRE(ring.Create(section, 64, 8) == SharedMemoryRing::RING_SUCCESS);
+		REQUIRE(producer.Open(section.Data(), section.Size(), false) == SharedMemoryRing::RING_SUCCESS);
+		REQUIRE(producer.Write("Message 0", 10) == SharedMemoryRing::RING_SUCCESS);
+
+		pid_t child = fork();
+
+		REQUIRE(child >= 0);
+
+		if (child == 0) {
+			uint64_t position = 0;
+			pthread_t thread;
+			bool success = ring.TakeOwnership() == SharedMemoryRing::RING_SUCCESS && ring.Claim(position) == SharedMemoryRing::RING_SUCCESS && position == 1;
+
+			for (int i = 0; success && i < 7; i++)
+				success = ring.Write("Owned", 6) == SharedMemoryRing::RING_SUCCESS;
+
+			// The thread claims position 9, which waits for the unpublished position 1 until the process exits
+			success = success && pthread_create(&thread, NULL, ClaimRingPosition, &ring) == 0;
+
+			while (success && ring.GetWritePosition() < 10)
+				(void)usleep(1000);
+
+			_exit(success ? 0 : 1);
+		}
+
+		int status = 0;
+		REQUIRE(waitpid(child, &status, 0) == child);
+		REQUIRE(WIFEXITED(status));
+		REQUIRE(WEXITSTATUS(status) == 0);
+		REQUIRE(ring.GetWritePosition() == 10);
+
+		WHEN ("The other producer writes to the ring") {
+			THEN ("The write is rejected without claiming a position, as it could not be recovered") {
+				REQUIRE(producer.Write("Message 1", 10) == SharedMemoryRing::RING_FAILED_OWNED);
+				REQUIRE(producer.GetWritePosition() == 10);
+			}
+		}
+
+		WHEN ("The other producer recovers the ring") {
+			char buffer[64];
+			uint32_t length = 0;
+			uint32_t aborted = 0;
+			uint64_t position = 1;
+
+			REQUIRE(producer.Recover(&aborted) == SharedMemoryRing::RING_SUCCESS);
+			REQUIRE(producer.GetOwner() == 0);
+
+			THEN ("Both claims of the slot are aborted in order, and the other producer can write again") {
+				REQUIRE(aborted == 2);
+				REQUIRE(producer.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_OVERRUN);
+				REQUIRE(position == 2);
+
+				for (int i = 0; i < 7; i++) {
+					REQUIRE(producer.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+					REQUIRE(std::string(buffer) == "Owned");
+				}
+
+				REQUIRE(producer.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_ABORTED);
+				REQUIRE(position == 10);
+				REQUIRE(producer.Write("Message 1", 10) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(producer.Read(position, buffer, sizeof(buffer), length) == SharedMemoryRing::RING_SUCCESS);
+				REQUIRE(std::string(buffer) == "Message 1");
+			}
+		}
+	}
+#endif
+}
+
+SCENARIO ("Shared Memory Bus Test", "[SharedMemory], [SharedMemoryBus]") {
+	GIVEN ("A bus in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMemoryBus::GetRequiredSize(4, SharedMemoryBus::GetTopicSize(32, 4) * 4);
+
+		SharedMemory::DeleteNamed("Test Bus");
+		REQUIRE(testFile.CreateNamed("Test Bus", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMemoryBus bus;
+		uint32_t topicA = 0, topicB = 0, topicC = 0, topic = 0;
+
+		REQUIRE(bus.Create(section, 65) == SharedMemoryBus::BUS_FAILED_BAD_SIZE);
+		REQUIRE(bus.Create(section, 4) == SharedMemoryBus::BUS_SUCCESS);
+		REQUIRE(bus.AddTopic("A", 32, 4, topicA) == SharedMemoryBus::BUS_SUCCESS);
+		REQUIRE(bus.AddTopic("B", 32, 4, topicB) == SharedMemoryBus::BUS_SUCCESS);
+		REQUIRE(bus.AddTopic("B", 32, 4, topic) == SharedMemoryBus::BUS_ALREADY_EXISTS);
+		REQUIRE(topic == topicB);
+		REQUIRE(bus.AddTopic("B", 64, 2, topic) == SharedMemoryBus::BUS_FAILED_MISMATCH);
+		REQUIRE(bus.AddTopic("B", 32, 8, topic) == SharedMemoryBus::BUS_FAILED_MISMATCH);
+		REQUIRE(bus.AddTopic("C", 30, 4, topicC) == SharedMemoryBus::BUS_FAILED_BAD_SIZE);
+		REQUIRE(bus.AddTopic("C", 32, 4, topicC) == SharedMemoryBus::BUS_SUCCESS);
+		REQUIRE(bus.GetTopicCount() == 3);
+
+		WHEN ("Another process subscribes to some of the topics") {
+			SharedMemory testFile2;
+			REQUIRE(testFile2.OpenNamed("Test Bus") == SharedMemory::LOAD_SUCCESS);
+
+			SharedMemorySection section2(testFile2, size);
+			SharedMemoryBus reader;
+			SharedMemoryBus::Subscriber subscriber;
+			char buffer[32];
+			uint32_t length = 0;
+
+			REQUIRE(reader.Open(section2) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(reader.FindTopic("C", topic) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(topic == topicC);
+			REQUIRE(reader.FindTopic("D", topic) == SharedMemoryBus::BUS_FAILED_NOT_FOUND);
+			REQUIRE(reader.Subscribe(subscriber, topicA) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(reader.Subscribe(subscriber, topicC) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(reader.Subscribe(subscriber, 3) == SharedMemoryBus::BUS_FAILED_BAD_TOPIC);
+			REQUIRE(subscriber.GetInterest() == ((uint64_t(1) << topicA) | (uint64_t(1) << topicC)));
+			REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_EMPTY);
+			REQUIRE(reader.Publish(topicA, "A1", 3) == SharedMemoryBus::BUS_FAILED_READ_ONLY);
+
+			REQUIRE(bus.Publish(topicA, "A1", 3) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(bus.Publish(topicB, "B1", 3) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(bus.Publish(topicC, "C1", 3) == SharedMemoryBus::BUS_SUCCESS);
+			REQUIRE(bus.Publish(topicA, "A2", 3) == SharedMemoryBus::BUS_SUCCESS);
+
+			THEN ("Only messages on the subscribed topics are received, in turn") {
+				REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(topic == topicA);
+				REQUIRE(std::string(buffer) == "A1");
+				REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(topic == topicC);
+				REQUIRE(std::string(buffer) == "C1");
+				REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(topic == topicA);
+				REQUIRE(std::string(buffer) == "A2");
+				REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_EMPTY);
+				REQUIRE(subscriber.GetLost() == 0);
+
+				subscriber.Unsubscribe(topicA);
+				REQUIRE(!subscriber.IsSubscribed(topicA));
+				REQUIRE(subscriber.IsSubscribed(topicC));
+			}
+
+			THEN ("A subscriber that falls behind counts the lost messages") {
+				for (int i = 0; i < 8; i++)
+					REQUIRE(bus.Publish(topicC, "C2", 3) == SharedMemoryBus::BUS_SUCCESS);
+
+				subscriber.Unsubscribe(topicA);
+				REQUIRE(reader.Receive(subscriber, topic, buffer, sizeof(buffer), length) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(topic == topicC);
+				REQUIRE(subscriber.GetLost() == 1);
+			}
+
+			THEN ("Messages larger than a slot are received whole") {
+				char large[100];
+				char received[100];
+
+				memset(large, 'L', sizeof(large));
+				REQUIRE(bus.Publish(topicC, large, sizeof(large)) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(bus.Publish(topicC, large, 32 * 4 + 1) == SharedMemoryBus::BUS_FAILED_TOO_LARGE);
+
+				subscriber.Unsubscribe(topicA);
+				REQUIRE(reader.Receive(subscriber, topic, received, sizeof(received), length) == SharedMemoryBus::BUS_SUCCESS);
+				REQUIRE(subscriber.GetLost() == 1);
+				REQUIRE(length == sizeof(large));
+				REQUIRE(memcmp(received, large, sizeof(large)) == 0);
+			}
+		}
+	}
+}
+
+SCENARIO ("Shared Histogram Test", "[SharedMemory], [SharedHistogram]") {
+	GIVEN ("A histogram in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedHistogram::GetRequiredSize();
+
+		SharedMemory::DeleteNamed("Test Histogram");
+		REQUIRE(testFile.CreateNamed("Test Histogram", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedHistogram histogram;
+
+		REQUIRE(histogram.Create(section, 17) == SharedHistogram::HISTOGRAM_FAILED_BAD_SIZE);
+		REQUIRE(histogram.Create(section, 6) == SharedHistogram::HISTOGRAM_FAILED_BAD_SIZE);
+		REQUIRE(histogram.Create(section) == SharedHistogram::HISTOGRAM_SUCCESS);
+		REQUIRE(histogram.GetPrecision() == 5);
+
+		WHEN ("The bucket boundaries are checked") {
+			THEN ("Every value is counted in a bucket that contains it, and the buckets are contiguous") {
+				const uint64_t values[] = { 0, 1, 31, 32, 33, 63, 64, 65, 1000, 123456789, uint64_t(1) << 40, ~uint64_t(0) };
+
+				for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+					const uint32_t index = histogram.GetBucketIndex(values[i]);
+
+					REQUIRE(index < SharedHistogram::GetBucketCount(SharedHistogram::DEFAULT_PRECISION));
+					REQUIRE(histogram.GetBucketLowestValue(index) <= values[i]);
+					REQUIRE(histogram.GetBucketHighestValue(index) >= values[i]);
+					REQUIRE(histogram.GetBucketHighestValue(index) - histogram.GetBucketLowestValue(index) <= histogram.GetBucketLowestValue(index) / 16);
+				}
+
+				for (uint32_t i = 1; i < SharedHistogram::GetBucketCount(SharedHistogram::DEFAULT_PRECISION); i++)
+					REQUIRE(histogram.GetBucketLowestValue(i) == histogram.GetBucketHighestValue(i - 1) + 1);
+
+				REQUIRE(histogram.GetBucketIndex(~uint64_t(0)) == SharedHistogram::GetBucketCount(SharedHistogram::DEFAULT_PRECISION) - 1);
+			}
+		}
+
+		WHEN ("Values are recorded") {
+			for (uint64_t i = 1; i <= 1000; i++)
+				histogram.Record(i * 1000);
+
+			histogram.Record(5, 10);
+
+			THEN ("The percentiles are within the precision of the histogram") {
+				REQUIRE(histogram.GetTotalCount() == 1010);
+				REQUIRE(histogram.GetMin() == 5);
+				REQUIRE(histogram.GetMax() >= 1000000);
+				REQUIRE(histogram.GetMax() <= 1000000 + 1000000 / 16);
+				REQUIRE(histogram.GetValueAtPercentile(50.0) >= 495000);
+				REQUIRE(histogram.GetValueAtPercentile(50.0) <= 495000 + 495000 / 16);
+				REQUIRE(histogram.GetValueAtPercentile(99.0) >= 990000);
+				REQUIRE(histogram.GetValueAtPercentile(99.0) <= 990000 + 990000 / 16);
+				REQUIRE(histogram.GetMean() > 490000.0);
+				REQUIRE(histogram.GetMean() < 500000.0);
+			}
+
+			THEN ("An observer can snapshot and reset the histogram") {
+				SharedMemory testFile2;
+				REQUIRE(testFile2.OpenNamed("Test Histogram") == SharedMemory::LOAD_SUCCESS);
+
+				SharedMemorySection section2(testFile2, size);
+				SharedHistogram observed, snapshot, otherPrecision;
+				std::string snapshotData(size, '\0'), otherData(SharedHistogram::GetRequiredSize(4), '\0');
+
+				REQUIRE(observed.Open(section2) == SharedHistogram::HISTOGRAM_SUCCESS);
+				REQUIRE(snapshot.Create(reinterpret_cast<uint8_t *>(&snapshotData[0]), snapshotData.size()) == SharedHistogram::HISTOGRAM_SUCCESS);
+				REQUIRE(otherPrecision.Create(reinterpret_cast<uint8_t *>(&otherData[0]), otherData.size(), 4) == SharedHistogram::HISTOGRAM_SUCCESS);
+
+				REQUIRE(observed.Snapshot(otherPrecision) == SharedHistogram::HISTOGRAM_FAILED_MISMATCH);
+				REQUIRE(observed.Snapshot(snapshot, true) == SharedHistogram::HISTOGRAM_FAILED_READ_ONLY);
+				REQUIRE(observed.Snapshot(snapshot) == SharedHistogram::HISTOGRAM_SUCCESS);
+				REQUIRE(snapshot.GetTotalCount() == 1010);
+				REQUIRE(snapshot.GetValueAtPercentile(50.0) == histogram.GetValueAtPercentile(50.0));
+
+				observed.Record(1);
+				REQUIRE(histogram.GetTotalCount() == 1010);
+
+				REQUIRE(histogram.Snapshot(snapshot, true) == SharedHistogram::HISTOGRAM_SUCCESS);
+				REQUIRE(snapshot.GetTotalCount() == 2020);
+				REQUIRE(histogram.GetTotalCount() == 0);
+				REQUIRE(observed.GetMax() == 0);
+			}
+		}
+	}
+}
+
+SCENARIO ("Shared Object Pool Test", "[SharedMemory], [SharedObjectPool]") {
+	GIVEN ("A pool in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedObjectPool::GetRequiredSize(24, 4);
+
+		SharedMemory::DeleteNamed("Test Pool");
+		REQUIRE(testFile.CreateNamed("Test Pool", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedObjectPool pool;
+
+		REQUIRE(pool.Create(section, 24, 5) == SharedObjectPool::POOL_FAILED_BAD_SIZE);
+		REQUIRE(pool.Create(section, 24, 4) == SharedObjectPool::POOL_SUCCESS);
+		REQUIRE(pool.GetCapacity() == 4);
+		REQUIRE(pool.GetObjectSize() == 24);
+		REQUIRE(!pool.IsValid(SharedObjectPool::INVALID_HANDLE));
+
+		WHEN ("All objects are allocated") {
+			SharedObjectPool::Handle handles[5];
+
+			for (int i = 0; i < 4; i++) {
+				REQUIRE(pool.Allocate(handles[i]) == SharedObjectPool::POOL_SUCCESS);
+				REQUIRE(pool.Get(handles[i]) != NULL);
+				strcpy(reinterpret_cast<char *>(pool.Get(handles[i])), "Object");
+			}
+
+			REQUIRE(pool.Allocate(handles[4]) == SharedObjectPool::POOL_FAILED_FULL);
+
+			THEN ("The handles are visible from another mapping") {
+				SharedMemory testFile2;
+				REQUIRE(testFile2.OpenNamed("Test Pool") == SharedMemory::LOAD_SUCCESS);
+
+				SharedMemorySection section2(testFile2, size);
+				SharedObjectPool reader;
+
+				REQUIRE(reader.Open(section2) == SharedObjectPool::POOL_SUCCESS);
+				REQUIRE(reader.Allocate(handles[4]) == SharedObjectPool::POOL_FAILED_READ_ONLY);
+				REQUIRE(std::string(reinterpret_cast<const char *>(reader.Get(handles[2]))) == "Object");
+
+				REQUIRE(pool.Free(handles[2]) == SharedObjectPool::POOL_SUCCESS);
+				REQUIRE(reader.Get(handles[2]) == NULL);
+			}
+
+			THEN ("A recycled object is not reachable with its stale handle") {
+				REQUIRE(pool.Free(handles[1]) == SharedObjectPool::POOL_SUCCESS);
+				REQUIRE(pool.Free(handles[1]) == SharedObjectPool::POOL_FAILED_BAD_HANDLE);
+				REQUIRE(!pool.IsValid(handles[1]));
+				REQUIRE(pool.Allocate(handles[4]) == SharedObjectPool::POOL_SUCCESS);
+				REQUIRE((handles[4] & 0xFFFFFFFF) == (handles[1] & 0xFFFFFFFF));
+				REQUIRE(handles[4] != handles[1]);
+				REQUIRE(pool.Get(handles[1]) == NULL);
+				REQUIRE(pool.Get(handles[4]) != NULL);
+				REQUIRE(pool.Free(handles[4] + 1) == SharedObjectPool::POOL_FAILED_BAD_HANDLE);
+			}
+		}
+#if !defined(_WIN32)
+		WHEN ("Two processes allocate and free concurrently") {
+			pid_t child = fork();
+
+			REQUIRE(child >= 0);
+
+			bool success = true;
+
+			for (int i = 0; i < 20000 && success; i++) {
+				SharedObjectPool::Handle first, second;
+
+				success = pool.Allocate(first) == SharedObjectPool::POOL_SUCCESS && pool.Allocate(second) == SharedObjectPool::POOL_SUCCESS && first != second &&
+					pool.Free(second) == SharedObjectPool::POOL_SUCCESS && pool.Free(first) == SharedObjectPool::POOL_SUCCESS;
+			}
+
+			if (child == 0)
+				_exit(success ? 0 : 1);
+
+			int status = 0;
+			REQUIRE(waitpid(child, &status, 0) == child);
+
+			THEN ("No object is lost or handed out twice") {
+				SharedObjectPool::Handle handles[5];
+
+				REQUIRE(success);
+				REQUIRE(WIFEXITED(status));
+				REQUIRE(WEXITSTATUS(status) == 0);
+
+				for (int i = 0; i < 4; i++)
+					REQUIRE(pool.Allocate(handles[i]) == SharedObjectPool::POOL_SUCCESS);
+
+				REQUIRE(pool.Allocate(handles[4]) == SharedObjectPool::POOL_FAILED_FULL);
+			}
+		}
+#endif
+	}
+}
+
+SCENARIO ("Shared Memory Checkpoint Test", "[SharedMemory], [SharedMemoryCheckpoint]") {
+	GIVEN ("A region that is checkpointed to a file") {
+		static uint8_t region[10 * 4096 + 100];
+		static uint8_t restored[sizeof(region)];
+		uint64_t hashes[11];
+		SharedMemoryCheckpoint checkpoint;
+		size_t written = 0;
+		uint64_t checkpoints = 0;
+		FILE *file = tmpfile();
+
+		REQUIRE(file);
+		REQUIRE(SharedMemoryCheckpoint::GetPageCount(sizeof(region)) == 11);
+		REQUIRE(checkpoint.Create(region, sizeof(region), hashes, 10) == SharedMemoryCheckpoint::CHECKPOINT_FAILED_BAD_SIZE);
+		REQUIRE(checkpoint.Create(region, sizeof(region), hashes, 11, 4095) == SharedMemoryCheckpoint::CHECKPOINT_FAILED_BAD_SIZE);
+
+		for (size_t i = 0; i < sizeof(region); i++)
+			region[i] = static_cast<uint8_t>(i * 7);
+
+		REQUIRE(checkpoint.Create(region, sizeof(region), hashes, 11) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+		REQUIRE(checkpoint.Write(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_FAILED_BAD_FILE);
+		REQUIRE(checkpoint.Begin(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+		REQUIRE(written == 11);
+		REQUIRE(checkpoint.GetSequence() == 2);
+
+		WHEN ("Only a few pages change between checkpoints") {
+			REQUIRE(checkpoint.Write(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+			REQUIRE(written == 0);
+
+			region[5000] = 1;
+			region[5001] = 2;
+			region[sizeof(region) - 1] = 3;
+			REQUIRE(checkpoint.Write(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+			REQUIRE(written == 2);
+
+			region[0] = 4;
+			REQUIRE(checkpoint.Write(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+			REQUIRE(written == 1);
+
+			THEN ("Restoring applies every checkpoint") {
+				rewind(file);
+				REQUIRE(SharedMemoryCheckpoint::Restore(file, restored, sizeof(restored) - 1) == SharedMemoryCheckpoint::CHECKPOINT_FAILED_MISMATCH);
+
+				rewind(file);
+				REQUIRE(SharedMemoryCheckpoint::Restore(file, restored, sizeof(restored), &checkpoints) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+				REQUIRE(checkpoints == 4);
+				REQUIRE(memcmp(region, restored, sizeof(region)) == 0);
+			}
+
+			THEN ("A partially written checkpoint is ignored") {
+				region[100] = 5;
+				region[9000] = 6;
+				REQUIRE(checkpoint.Write(file, &written) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+				REQUIRE(written == 2);
+
+				// Copy the file without the end of the last checkpoint
+				const long size = ftell(file);
+				FILE *truncated = tmpfile();
+				uint8_t buffer[4096];
+
+				REQUIRE(truncated);
+				rewind(file);
+
+				for (long remaining = size - 100; remaining > 0; ) {
+					const size_t length = remaining < static_cast<long>(sizeof(buffer)) ? static_cast<size_t>(remaining) : sizeof(buffer);
+
+					REQUIRE(fread(buffer, length, 1, file) == 1);
+					REQUIRE(fwrite(buffer, length, 1, truncated) == 1);
+					remaining -= static_cast<long>(length);
+				}
+
+				rewind(truncated);
+				REQUIRE(SharedMemoryCheckpoint::Restore(truncated, restored, sizeof(restored), &checkpoints) == SharedMemoryCheckpoint::CHECKPOINT_SUCCESS);
+				REQUIRE(checkpoints == 4);
+				REQUIRE(restored[100] != 5);
+				REQUIRE(restored[0] == 4);
+				REQUIRE(restored[sizeof(restored) - 1] == 3);
+				fclose(truncated);
+			}
+		}
+
+		fclose(file);
+	}
+}
+
+SCENARIO ("LZ Codec Test", "[LZCodec]") {
+	GIVEN ("Compressible and incompressible data") {
+		static uint8_t data[100000];
+		static uint8_t compressed[100000 + 100000 / 255 + 16];
+		static uint8_t decompressed[100000];
+		uint32_t random = 12345;
+		size_t length = 0;
+
+		for (size_t i = 0; i < 50000; i++)
+			data[i] = static_cast<uint8_t>("The quick brown fox jumps over the lazy dog. "[i % 45] + (i / 1000) % 3);
+
+		for (size_t i = 50000; i < sizeof(data); i++) {
+			random = random * 1103515245 + 12345;
+			data[i] = static_cast<uint8_t>(random >> 16);
+		}
+
+		REQUIRE(LZCodec::GetMaxCompressedSize(sizeof(data)) == sizeof(compressed));
+
+		THEN ("The data round trips") {
+			const size_t compressedSize = LZCodec::Compress(data, 50000, compressed, sizeof(compressed));
+
+			REQUIRE(compressedSize > 0);
+			REQUIRE(compressedSize < 5000);
+			REQUIRE(LZCodec::Decompress(compressed, compressedSize, decompressed, sizeof(decompressed), length));
+			REQUIRE(length == 50000);
+			REQUIRE(memcmp(data, decompressed, length) == 0);
+
+			const size_t mixedSize = LZCodec::Compress(data, sizeof(data), compressed, sizeof(compressed));
+
+			REQUIRE(mixedSize > 50000);
+			REQUIRE(LZCodec::Decompress(compressed, mixedSize, decompressed, sizeof(decompressed), length));
+			REQUIRE(length == sizeof(data));
+			REQUIRE(memcmp(data, decompressed, length) == 0);
+
+			REQUIRE(LZCodec::Compress(data, 0, compressed, sizeof(compressed)) == 1);
+			REQUIRE(LZCodec::Decompress(compressed, 1, decompressed, sizeof(decompressed), length));
+			REQUIRE(length == 0);
+		}
+
+		THEN ("Corrupt or oversized data is rejected") {
+			const size_t compressedSize = LZCodec::Compress(data, 50000, compressed, sizeof(compressed));
+
+			REQUIRE(LZCodec::Compress(data, 50000, compressed, 100) == 0);
+			REQUIRE(!LZCodec::Decompress(compressed, compressedSize, decompressed, 49999, length));
+			REQUIRE((!LZCodec::Decompress(compressed, compressedSize / 2, decompressed, sizeof(decompressed), length) || length < 50000));
+
+			compressed[1] = 0xFF;
+			compressed[2] = 0xFF;
+			REQUIRE(!LZCodec::Decompress(compressed, 3, decompressed, sizeof(decompressed), length));
+		}
+	}
+}
+
+#if !defined(_WIN32)
+SCENARIO ("Shared Memory Stream Test", "[SharedMemory], [SharedMemoryStream]") {
+	GIVEN ("A region exported to a file") {
+		static uint8_t region[300000];
+		static uint8_t imported[sizeof(region)];
+		static uint8_t workspace[4 * 65536 * 3];
+		uint64_t size = 0;
+		uint32_t chunkSize = 0;
+		uint32_t random = 54321;
+		FILE *file = tmpfile();
+
+		REQUIRE(file);
+
+		for (size_t i = 0; i < sizeof(region); i++) {
+			random = random * 1103515245 + 12345;
+			region[i] = i < 200000 ? static_cast<uint8_t>(i / 100) : static_cast<uint8_t>(random >> 16);
+		}
+
+		REQUIRE(SharedMemoryStream::GetWorkspaceSize(65536, 4) <= sizeof(workspace));
+		REQUIRE(SharedMemoryStream::Export(fileno(file), region, sizeof(region), workspace, 1000, 65536) == SharedMemoryStream::STREAM_FAILED_BAD_SIZE);
+
+		WHEN ("The region is exported and imported using a single thread") {
+			REQUIRE(SharedMemoryStream::Export(fileno(file), region, sizeof(region), workspace, sizeof(workspace), 65536) == SharedMemoryStream::STREAM_SUCCESS);
+			REQUIRE(ftell(file) < static_cast<long>(sizeof(region) / 2));
+			rewind(file);
+
+			// The header is written in network byte order
+			char magic[4];
+
+			REQUIRE(pread(fileno(file), magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)));
+			REQUIRE(std::string(magic, sizeof(magic)) == "SMBZ");
+
+			REQUIRE(SharedMemoryStream::ReadHeader(fileno(file), size, chunkSize) == SharedMemoryStream::STREAM_SUCCESS);
+			REQUIRE(size == sizeof(region));
+			REQUIRE(chunkSize == 65536);
+			REQUIRE(SharedMemoryStream::Import(fileno(file), imported, sizeof(imported), chunkSize, workspace, sizeof(workspace)) == SharedMemoryStream::STREAM_SUCCESS);
+			REQUIRE(memcmp(region, imported, sizeof(region)) == 0);
+		}
+
+		WHEN ("The region is exported and imported into shared memory using multiple threads") {
+			REQUIRE(SharedMemoryStream::Export(fileno(file), region, sizeof(region), workspace, sizeof(workspace), 65536, 4) == SharedMemoryStream::STREAM_SUCCESS);
+			rewind(file);
+
+			SharedMemory memory;
+
+			SharedMemory::DeleteNamed("Test Stream Import");
+			REQUIRE(SharedMemoryStream::ImportNamed(fileno(file), memory, "Test Stream Import", workspace, sizeof(workspace), 4) == SharedMemoryStream::STREAM_SUCCESS);
+
+			SharedMemorySection section(memory, sizeof(region));
+
+			REQUIRE(section.Valid());
+			REQUIRE(memcmp(region, section.Data(), sizeof(region)) == 0);
+			SharedMemory::DeleteNamed("Test Stream Import");
+		}
+
+		WHEN ("A truncated stream is imported") {
+			REQUIRE(SharedMemoryStream::Export(fileno(file), region, sizeof(region), workspace, sizeof(workspace), 65536, 2) == SharedMemoryStream::STREAM_SUCCESS);
+			REQUIRE(ftruncate(fileno(file), ftell(file) - 10) == 0);
+			rewind(file);
+
+			REQUIRE(SharedMemoryStream::ReadHeader(fileno(file), size, chunkSize) == SharedMemoryStream::STREAM_SUCCESS);
+			REQUIRE(SharedMemoryStream::Import(fileno(file), imported, sizeof(imported), chunkSize, workspace, sizeof(workspace), 2) == SharedMemoryStream::STREAM_FAILED_TO_READ);
+		}
+
+		fclose(file);
+	}
+}
+#endif
+
+#if !defined(_WIN32)
+SCENARIO ("Shared Memory Replicator Test", "[SharedMemory], [SharedMemoryReplicator]") {
+	GIVEN ("A region replicated over a TCP connection") {
+		static uint8_t region[16 * 4096 + 10];
+		static uint8_t standby[sizeof(region)];
+		static uint8_t senderWorkspace[4096 + 16 + 4096 + 4096 / 255 + 16];
+		static uint8_t receiverWorkspace[sizeof(senderWorkspace)];
+		uint64_t hashes[17];
+		size_t blocks = 0;
+
+		AutoCloseIPSocket listener(IPAddress::Loopback(IPV4), TCP, IPSocket::OPEN_AND_BIND);
+		REQUIRE(listener.Listen(1));
+
+		AutoCloseIPSocket connection(IPV4, TCP);
+		REQUIRE(connection.Connect(listener.GetAddress()) == IPSocket::CONNECT_SUCCESS);
+
+		AutoCloseIPSocket accepted(listener.Accept());
+		REQUIRE(accepted.IsValid());
+
+		for (size_t i = 0; i < sizeof(region); i++)
+			region[i] = static_cast<uint8_t>(i / 64);
+
+		SharedMemoryReplicator replicator;
+		SharedMemoryReplicator::Receiver receiver;
+
+		REQUIRE(SharedMemoryReplicator::GetBlockCount(sizeof(region)) == 17);
+		REQUIRE(SharedMemoryReplicator::GetWorkspaceSize() == sizeof(senderWorkspace));
+		REQUIRE(replicator.Create(region, sizeof(region), hashes, 16, senderWorkspace, sizeof(senderWorkspace)) == SharedMemoryReplicator::REPLICATOR_FAILED_BAD_SIZE);
+		REQUIRE(replicator.Create(region, sizeof(region), hashes, 17, senderWorkspace, sizeof(senderWorkspace)) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+		REQUIRE(receiver.Create(standby, sizeof(standby), receiverWorkspace, sizeof(receiverWorkspace)) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+
+		REQUIRE(replicator.Send(connection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+		REQUIRE(blocks == 17);
+		REQUIRE(receiver.Receive(accepted, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+		REQUIRE(blocks == 17);
+		REQUIRE(receiver.GetSequence() == 1);
+		REQUIRE(memcmp(region, standby, sizeof(region)) == 0);
+
+		WHEN ("Some blocks change") {
+			region[4096 * 3 + 5] = 0xAA;
+			region[sizeof(region) - 1] = 0xBB;
+
+			REQUIRE(replicator.Send(connection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+			REQUIRE(blocks == 2);
+			REQUIRE(replicator.Send(connection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+			REQUIRE(blocks == 0);
+
+			THEN ("Only the changed blocks are applied") {
+				REQUIRE(receiver.Receive(accepted, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+				REQUIRE(blocks == 2);
+				REQUIRE(receiver.Receive(accepted, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+				REQUIRE(blocks == 0);
+				REQUIRE(receiver.GetSequence() == 3);
+				REQUIRE(memcmp(region, standby, sizeof(region)) == 0);
+			}
+		}
+
+		WHEN ("The receiver misses an update") {
+			SharedMemoryReplicator::Receiver other;
+
+			region[0] = 0xCC;
+			REQUIRE(replicator.Send(connection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+			REQUIRE(other.Create(standby, sizeof(standby) - 1, receiverWorkspace, sizeof(receiverWorkspace)) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+			REQUIRE(other.Receive(accepted, &blocks) == SharedMemoryReplicator::REPLICATOR_FAILED_MISMATCH);
+
+			THEN ("The receiver detects the gap until a full update is sent") {
+				AutoCloseIPSocket newConnection(IPV4, TCP);
+				REQUIRE(newConnection.Connect(listener.GetAddress()) == IPSocket::CONNECT_SUCCESS);
+
+				AutoCloseIPSocket newAccepted(listener.Accept());
+				REQUIRE(newAccepted.IsValid());
+
+				region[1] = 0xDD;
+				REQUIRE(replicator.Send(newConnection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+				REQUIRE(blocks == 1);
+				REQUIRE(receiver.Receive(newAccepted, &blocks) == SharedMemoryReplicator::REPLICATOR_FAILED_OUT_OF_ORDER);
+
+				// The rest of the rejected update is still unread, so start again on a new connection
+				AutoCloseIPSocket lastConnection(IPV4, TCP);
+				REQUIRE(lastConnection.Connect(listener.GetAddress()) == IPSocket::CONNECT_SUCCESS);
+
+				AutoCloseIPSocket lastAccepted(listener.Accept());
+				REQUIRE(lastAccepted.IsValid());
+
+				replicator.Invalidate();
+				REQUIRE(replicator.Send(lastConnection, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+				REQUIRE(blocks == 17);
+				REQUIRE(receiver.Receive(lastAccepted, &blocks) == SharedMemoryReplicator::REPLICATOR_SUCCESS);
+				REQUIRE(blocks == 17);
+				REQUIRE(receiver.GetSequence() == 4);
+				REQUIRE(memcmp(region, standby, sizeof(region)) == 0);
+			}
+		}
+	}
+}
+#endif
+
+#if !defined(_WIN32)
+// Drops the datagrams waiting on a socket, returning the number dropped
+static size_t DropDatagrams(IPSocket socket, size_t count = size_t(-1)) {
+	uint8_t buffer[9000];
+	size_t dropped = 0;
 
-		WHEN ("The shared memory is opened and the data modified") {
-			SharedMemorySection section1(testFile, SharedMemorySection::GetOffsetSize() + 4096);
-			SharedMemory testFile2;
+	while (dropped < count && !socket.Receive(buffer, sizeof(buffer)).Failed())
+		dropped++;
 
-			REQUIRE(!section1.ReadOnly());
-			REQUIRE(testFile2.OpenNamed("Test 1") == SharedMemory::LOAD_SUCCESS);
+	return dropped;
+}
 
-			THEN ("The memory in the created shared memory section matches the memory in the opened shared memory section") {
-				SharedMemorySection section2(testFile2, 4096, SharedMemorySection::GetOffsetSize());
-				SharedMemorySection section21(testFile2, 4096);
+SCENARIO ("Shared Memory Multicast Test", "[SharedMemory], [SharedMemoryMulticast]") {
+	GIVEN ("A region published to a subscriber") {
+		static uint8_t region[40 * 1024 + 100];
+		static uint8_t replica[sizeof(region)];
+		static uint8_t history[32 * (1024 + 32)];
+		uint64_t hashes[41];
+		size_t blocks = 0;
+		size_t requests = 0;
+
+		AutoCloseIPSocket publisherSocket(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+		AutoCloseIPSocket subscriberSocket(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+
+		REQUIRE(publisherSocket.SetNonblocking());
+		REQUIRE(subscriberSocket.SetNonblocking());
+		REQUIRE(subscriberSocket.SetReceiveBufferSize(1 << 20));
+
+		for (size_t i = 0; i < sizeof(region); i++)
+			region[i] = static_cast<uint8_t>(i / 32);
+
+		SharedMemoryMulticast::Publisher publisher;
+		SharedMemoryMulticast::Subscriber subscriber;
+
+		REQUIRE(SharedMemoryMulticast::GetHistorySize(32) == sizeof(history));
+		REQUIRE(publisher.Create(region, sizeof(region), hashes, 41, history, sizeof(history) - 1, publisherSocket, subscriberSocket.GetAddress()) == SharedMemoryMulticast::MULTICAST_FAILED_BAD_SIZE);
+		REQUIRE(publisher.Create(region, sizeof(region), hashes, 41, history, sizeof(history), publisherSocket, subscriberSocket.GetAddress()) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+		REQUIRE(subscriber.Create(replica, sizeof(replica), subscriberSocket) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+
+		// The subscriber joins after the first update
+		REQUIRE(publisher.Publish(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+		REQUIRE(blocks == 41);
+		REQUIRE(publisher.GetSequence() == 41);
+		REQUIRE(DropDatagrams(subscriberSocket) == 42);
+		REQUIRE(subscriber.Receive() == SharedMemoryMulticast::MULTICAST_EMPTY);
+
+		region[5] = 1;
+		REQUIRE(publisher.Publish(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+		REQUIRE(blocks == 1);
+		REQUIRE(subscriber.Receive(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+		REQUIRE(blocks == 0);
+		REQUIRE(!subscriber.IsSynchronized());
+
+		// Serve the snapshot in bursts
+		for (int i = 0; i < 10 && !subscriber.IsSynchronized(); i++) {
+			REQUIRE(publisher.Serve(&requests) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+			REQUIRE(requests == 1);
+			REQUIRE(subscriber.Receive() == SharedMemoryMulticast::MULTICAST_SUCCESS);
+		}
 
-				REQUIRE(section2.ReadOnly());
-				REQUIRE(section21.ReadOnly());
+		REQUIRE(subscriber.IsSynchronized());
+		REQUIRE(subscriber.GetSequence() == 42);
+		REQUIRE(subscriber.GetSnapshots() == 1);
+		REQUIRE(memcmp(region, replica, sizeof(region)) == 0);
+
+		WHEN ("Datagrams are lost") {
+			region[2000] = 0xF2;
+			region[sizeof(region) - 1] = 0xF3;
+			REQUIRE(publisher.Publish(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+			REQUIRE(blocks == 2);
+			REQUIRE(DropDatagrams(subscriberSocket, 1) == 1);
+			REQUIRE(subscriber.Receive(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+			REQUIRE(blocks == 0);
+			REQUIRE(subscriber.GetNAKs() == 1);
+
+			THEN ("They are retransmitted") {
+				REQUIRE(publisher.Serve(&requests) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(requests == 1);
+				REQUIRE(subscriber.Receive(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(blocks == 2);
+				REQUIRE(subscriber.IsSynchronized());
+				REQUIRE(subscriber.GetSequence() == 44);
+				REQUIRE(memcmp(region, replica, sizeof(region)) == 0);
+			}
 
-				REQUIRE(section21.Size() == 4096);
-				REQUIRE(section21.Valid());
+			THEN ("A lost retransmit is requested again") {
+				REQUIRE(publisher.Serve(&requests) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(DropDatagrams(subscriberSocket) == 2);
+				REQUIRE(subscriber.Retry() == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(publisher.Serve(&requests) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(subscriber.Receive(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				REQUIRE(blocks == 2);
+				REQUIRE(memcmp(region, replica, sizeof(region)) == 0);
+			}
+		}
 
-				strcpy((char *)section1.Data(), "Test String 1");
-				strcpy((char *)section1.Data() + SharedMemorySection::GetOffsetSize(), "Test String 1");
+		WHEN ("More datagrams are lost than the history holds") {
+			for (size_t i = 0; i < sizeof(region); i += 1024)
+				region[i] = 0xF4;
 
-				REQUIRE(std::string((const char *)section2.Data()) == "Test String 1");
+			REQUIRE(publisher.Publish(&blocks) == SharedMemoryMulticast::MULTICAST_SUCCESS);
+			REQUIRE(blocks == 41);
+			REQUIRE(DropDatagrams(subscriberSocket, 20) == 20);
+			REQUIRE(subscriber.Receive() == SharedMemoryMulticast::MULTICAST_SUCCESS);
 
-				strcpy((char *)section1.Data() + SharedMemorySection::GetOffsetSize(), "Test String 2");
+			THEN ("The subscriber falls back to a snapshot") {
+				for (int i = 0; i < 10 && !subscriber.IsSynchronized(); i++) {
+					REQUIRE(publisher.Serve() == SharedMemoryMulticast::MULTICAST_SUCCESS);
+					REQUIRE(subscriber.Receive() == SharedMemoryMulticast::MULTICAST_SUCCESS);
+				}
 
-				REQUIRE(std::string((const char *)section21.Data()) == "Test String 1");
-				REQUIRE(std::string((const char *)section2.Data()) == "Test String 2");
+				REQUIRE(subscriber.IsSynchronized());
+				REQUIRE(subscriber.GetSnapshots() == 2);
+				REQUIRE(subscriber.GetSequence() == 83);
+				REQUIRE(memcmp(region, replica, sizeof(region)) == 0);
 			}
 		}
-
-		testFile.Close();
-		REQUIRE(SharedMemory::DeleteNamed("Test 1"));
 	}
+}
+#endif
 
-	GIVEN ("Bad attempts to create or open shared memory") {
-		WHEN ("The create or open calls are made") {
-			SharedMemory testFile;
+SCENARIO ("Shared Metrics Test", "[SharedMemory], [SharedMetrics]") {
+	GIVEN ("A metrics block in named shared memory") {
+		SharedMemory testFile;
+		const size_t size = SharedMetrics::GetRequiredSize(8, 4);
+
+		SharedMemory::DeleteNamed("Test Metrics");
+		REQUIRE(testFile.CreateNamed("Test Metrics", static_cast<SharedMemory::Size>(size), true) == SharedMemory::LOAD_SUCCESS);
+
+		SharedMemorySection section(testFile, size);
+		SharedMetrics metrics;
+
+		REQUIRE(SharedMetrics::GetRecommendedStripes() > 0);
+		REQUIRE(metrics.Create(section, 8, 4) == SharedMetrics::METRICS_SUCCESS);
+		REQUIRE(metrics.GetStripes() == 4);
+
+		WHEN ("Metrics are registered and updated") {
+			uint32_t requests = 0, depth = 0, duplicate = 0;
+
+			REQUIRE(metrics.Register("requests", SharedMetrics::METRIC_COUNTER, requests) == SharedMetrics::METRICS_SUCCESS);
+			REQUIRE(metrics.Register("depth", SharedMetrics::METRIC_GAUGE, depth) == SharedMetrics::METRICS_SUCCESS);
+			REQUIRE(metrics.Register("requests", SharedMetrics::METRIC_COUNTER, duplicate) == SharedMetrics::METRICS_ALREADY_EXISTS);
+			REQUIRE(metrics.Register("requests", SharedMetrics::METRIC_GAUGE, duplicate) == SharedMetrics::METRICS_FAILED_BAD_TYPE);
+			REQUIRE(duplicate == requests);
+
+			for (int i = 0; i < 1000; i++)
+				metrics.Add(requests);
+
+			metrics.Add(requests, 24);
+			metrics.Add(depth, 5);
+			metrics.Subtract(depth, 8);
+
+			THEN ("A read-only observer sees the summed values") {
+				SharedMemory testFile2;
+				REQUIRE(testFile2.OpenNamed("Test Metrics") == SharedMemory::LOAD_SUCCESS);
+
+				SharedMemorySection section2(testFile2, size);
+				SharedMetrics observer;
+				uint32_t index = 0;
+
+				REQUIRE(observer.Open(section2) == SharedMetrics::METRICS_SUCCESS);
+				REQUIRE(observer.Count() == 2);
+				REQUIRE(observer.Find("requests", index) == SharedMetrics::METRICS_SUCCESS);
+				REQUIRE(observer.GetType(index) == SharedMetrics::METRIC_COUNTER);
+				REQUIRE(observer.GetCounter(index) == 1024);
+				REQUIRE(observer.Find("depth", index) == SharedMetrics::METRICS_SUCCESS);
+				REQUIRE(std::string(observer.GetName(index)) == "depth");
+				REQUIRE(observer.GetGauge(index) == -3);
+				REQUIRE(observer.Find("missing", index) == SharedMetrics::METRICS_FAILED_NOT_FOUND);
+				REQUIRE(observer.Register("other", SharedMetrics::METRIC_COUNTER, index) == SharedMetrics::METRICS_FAILED_READ_ONLY);
+
+				observer.Add(requests, 10);
+				REQUIRE(metrics.GetCounter(requests) == 1024);
+			}
+		}
 
-			THEN ("The requests fail") {
-				REQUIRE(testFile.CreateFileBacked(NULL, SharedMemorySection::GetOffsetSize() + 4096, true) != SharedMemory::LOAD_SUCCESS);
-				REQUIRE(testFile.CreateFileBacked(NULL, -1, true) != SharedMemory::LOAD_SUCCESS);
-				REQUIRE(testFile.OpenFileBacked(NULL) != SharedMemory::LOAD_SUCCESS);
+		WHEN ("The block is filled") {
+			uint32_t index = 0;
+			const char *names[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
 
-				REQUIRE(testFile.CreateNamed(NULL, SharedMemorySection::GetOffsetSize() + 4096) != SharedMemory::LOAD_SUCCESS);
-				REQUIRE(testFile.CreateNamed(NULL, -1) != SharedMemory::LOAD_SUCCESS);
-				REQUIRE(testFile.OpenNamed(NULL) != SharedMemory::LOAD_SUCCESS);
+			for (size_t i = 0; i < 8; i++)
+				REQUIRE(metrics.Register(names[i], SharedMetrics::METRIC_COUNTER, index) == SharedMetrics::METRICS_SUCCESS);
+
+			THEN ("No more metrics can be registered") {
+				REQUIRE(metrics.Register("i", SharedMetrics::METRIC_COUNTER, index) == SharedMetrics::METRICS_FAILED_FULL);
 			}
 		}
 	}
@@ -482,6 +2146,295 @@ SCENARIO ("IP Socket Test", "[IPSocket]") {
 		}
 	}
 
+#if !defined(SMBB_NO_LOCAL_SOCKETS)
+	GIVEN ("A set of local addresses") {
+		char path[128];
+		IPAddress::String uri;
+
+		REQUIRE(SharedMemory::GetRecommendedDirectory(path, sizeof(path) - 32));
+		strcat(path, "/smbb-test.sock");
+		(void)unlink(path);
+
+		IPAddress serverAddress = IPAddress::Local(path);
+		IPAddress clientAddress = IPAddress::Local("smbb-test-client", true);
+
+		REQUIRE(serverAddress.IsValid());
+		REQUIRE(serverAddress.GetFamily() == LOCAL);
+		REQUIRE(!serverAddress.IsAny());
+		REQUIRE(!serverAddress.IsAbstract());
+		REQUIRE(std::string(serverAddress.ToURI(uri)) == path);
+		REQUIRE(serverAddress == IPAddress::Local(path));
+		REQUIRE(serverAddress != clientAddress);
+		REQUIRE(serverAddress.Hash() == IPAddress::Local(path).Hash());
+		REQUIRE(!IPAddress::Local(NULL).IsValid());
+		REQUIRE(!IPAddress::Local(std::string(200, 'a').c_str()).IsValid());
+
+		WHEN ("Testing a local stream connection") {
+			AutoCloseIPSocket server(serverAddress, TCP, IPSocket::OPEN_BIND_AND_LISTEN);
+			AutoCloseIPSocket client(serverAddress, TCP, IPSocket::OPEN_AND_CONNECT);
+			IPAddress acceptedAddress;
+			AutoCloseIPSocket accepted(server.Accept(&acceptedAddress));
+
+			THEN ("Data is sent and received in both directions") {
+				char buffer[16] = { };
+
+				REQUIRE(server.IsValid());
+				REQUIRE(client.IsValid());
+				REQUIRE(accepted.IsValid());
+				REQUIRE(server.GetAddress() == serverAddress);
+				REQUIRE(client.GetPeerAddress() == serverAddress);
+				REQUIRE(acceptedAddress.GetFamily() == LOCAL);
+				REQUIRE(acceptedAddress.IsAny());
+
+				REQUIRE(client.Send("Local", 6).GetResult() == 6);
+				REQUIRE(accepted.Receive(buffer, sizeof(buffer)).GetResult() == 6);
+				REQUIRE(std::string(buffer) == "Local");
+
+				REQUIRE(accepted.Send("Reply", 6).GetResult() == 6);
+				REQUIRE(client.Receive(buffer, sizeof(buffer)).GetResult() == 6);
+				REQUIRE(std::string(buffer) == "Reply");
+			}
+		}
+
+#if defined(__linux__)
+		WHEN ("Testing local datagrams from an abstract address") {
+			AutoCloseIPSocket server(serverAddress, UDP, IPSocket::OPEN_AND_BIND);
+			AutoCloseIPSocket client(clientAddress, UDP, IPSocket::OPEN_AND_BIND);
+
+			THEN ("The datagrams are received with the address of the sender") {
+				char buffer[16] = { };
+				IPAddress from = IPAddress::Local("stale address that is longer than the sender");
+
+				REQUIRE(server.IsValid());
+				REQUIRE(client.IsValid());
+				REQUIRE(client.GetAddress() == clientAddress);
+				REQUIRE(client.GetAddress().IsAbstract());
+				REQUIRE(std::string(clientAddress.ToURI(uri)) == "@smbb-test-client");
+
+				REQUIRE(client.Send("One", 4, serverAddress).GetResult() == 4);
+				REQUIRE(server.Receive(buffer, sizeof(buffer), from).GetResult() == 4);
+				REQUIRE(std::string(buffer) == "One");
+				REQUIRE(from == clientAddress);
+
+#if !defined(SMBB_NO_SOCKET_MSG)
+				char data[4][16] = { };
+				IPAddress addresses[4];
+				IPSocket::Buffer buffers[4] = { IPSocket::Buffer(data[0], 16), IPSocket::Buffer(data[1], 16), IPSocket::Buffer(data[2], 16), IPSocket::Buffer(data[3], 16) };
+				IPSocket::MultiMessagePart parts[4] = { IPSocket::MultiMessagePart(&buffers[0], 1, &addresses[0]), IPSocket::MultiMessagePart(&buffers[1], 1, &addresses[1]),
+					IPSocket::MultiMessagePart(&buffers[2], 1, &addresses[2]), IPSocket::MultiMessagePart(&buffers[3], 1, &addresses[3]) };
+
+				REQUIRE(client.Send("Two", 4, serverAddress).GetResult() == 4);
+				REQUIRE(client.Send("Three", 6, serverAddress).GetResult() == 6);
+				REQUIRE(server.ReceiveMultiple(parts, 2).GetResult() == 2);
+				REQUIRE(std::string(data[0]) == "Two");
+				REQUIRE(std::string(data[1]) == "Three");
+				REQUIRE(addresses[0] == clientAddress);
+				REQUIRE(addresses[1] == clientAddress);
+#endif
+			}
+		}
+#endif
+
+		REQUIRE(unlink(path) == 0);
+	}
+#endif
+
+#if !defined(SMBB_NO_SOCKET_MSG)
+	GIVEN ("A UDP socket sending segmented data") {
+		AutoCloseIPSocket receiver(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+		AutoCloseIPSocket sender(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+		const IPAddress to = receiver.GetAddress();
+		static char data[80000];
+		char buffer[65536];
+
+		for (size_t i = 0; i < sizeof(data); i++)
+			data[i] = static_cast<char>(i % 251);
+
+		REQUIRE(receiver.SetReceiveBufferSize(1 << 20));
+
+		WHEN ("The data is a multiple of the segment size") {
+			REQUIRE(sender.SendSegmented(data, 10000, 1000, &to).GetResult() == 10000);
+
+			THEN ("Each segment is received as a separate datagram") {
+				for (int i = 0; i < 10; i++) {
+					REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 1000);
+					REQUIRE(memcmp(buffer, data + i * 1000, 1000) == 0);
+				}
+			}
+		}
+
+		WHEN ("The data spans multiple batches and ends with a partial segment") {
+			const size_t count = IPSocket::MAX_SEND_SEGMENTS * 2 + 1;
+
+			REQUIRE(sender.SendSegmented(data, static_cast<IPSocket::DataLength>(count * 100 + 50), 100, &to).GetResult() == static_cast<IPSocket::ResultLength>(count * 100 + 50));
+
+			THEN ("Every segment is received in order") {
+				for (size_t i = 0; i < count; i++) {
+					REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 100);
+					REQUIRE(memcmp(buffer, data + i * 100, 100) == 0);
+				}
+
+				REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 50);
+				REQUIRE(memcmp(buffer, data + count * 100, 50) == 0);
+			}
+		}
+
+		WHEN ("The segments are too large to be offloaded") {
+			REQUIRE(sender.SendSegmented(data, 80000, 40000, &to).GetResult() == 80000);
+			REQUIRE(sender.SendSegmented(data, 80000, 0, &to).Failed());
+
+			THEN ("The segments are sent as separate datagrams") {
+				REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 40000);
+				REQUIRE(memcmp(buffer, data, 40000) == 0);
+				REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 40000);
+				REQUIRE(memcmp(buffer, data + 40000, 40000) == 0);
+			}
+		}
+
+#if !defined(_WIN32)
+		WHEN ("The receiver allows coalescing") {
+			static char received[65536];
+			IPSocket::Buffer receiveBuffer(received, sizeof(received));
+			IPSocket::Control control;
+			IPSocket::MultiMessagePart part(&receiveBuffer, 1);
+			size_t total = 0;
+			int coalesced = 0;
+
+			if (IPSocket::HasNativeSendSegmented())
+				REQUIRE(receiver.SetReceiveSegmentOffload());
+
+			part.SetControl(&control);
+			REQUIRE(sender.SendSegmented(data, 10000, 1000, &to).GetResult() == 10000);
+
+			THEN ("The coalesced datagrams can be split back into the original datagrams") {
+				while (total < 10000) {
+					REQUIRE(receiver.ReceiveMultiple(&part, 1).GetResult() == 1);
+					REQUIRE(part.GetResult() > 0);
+					REQUIRE((part.GetSegmentSize() == 0 || part.GetSegmentSize() == 1000));
+
+					IPSocket::Segments segments(received, static_cast<size_t>(part.GetResult()), part.GetSegmentSize());
+					IPSocket::Buffer segment;
+
+					coalesced += part.GetSegmentSize() != 0 ? 1 : 0;
+
+					while (segments.Next(segment)) {
+						REQUIRE(segment.GetLength() == 1000);
+						REQUIRE(memcmp(segment.GetData(), data + total, 1000) == 0);
+						total += segment.GetLength();
+					}
+				}
+
+				REQUIRE(total == 10000);
+				REQUIRE((coalesced > 0 || !receiver.GetReceiveSegmentOffload()));
+			}
+		}
+#endif
+
+		WHEN ("The segment size is set on the socket") {
+			if (IPSocket::HasNativeSendSegmented()) {
+				REQUIRE(sender.SetSendSegmentSize(500));
+				REQUIRE(sender.GetSendSegmentSize() == 500);
+				REQUIRE(sender.Send(data, 1200, to).GetResult() == 1200);
+			}
+
+			THEN ("Every send is split into datagrams") {
+				if (IPSocket::HasNativeSendSegmented()) {
+					REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 500);
+					REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 500);
+					REQUIRE(receiver.Receive(buffer, sizeof(buffer)).GetResult() == 200);
+					REQUIRE(memcmp(buffer, data + 1000, 200) == 0);
+				}
+			}
+		}
+	}
+#endif
+
+#if defined(__linux__) && !defined(SMBB_NO_SOCKET_MSG)
+	GIVEN ("A pair of UDP sockets with timestamping enabled") {
+		AutoCloseIPSocket receiver(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+		AutoCloseIPSocket sender(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+		const IPAddress to = receiver.GetAddress();
+		char data[2][16] = { };
+		IPSocket::Buffer buffers[2] = { IPSocket::Buffer(data[0], sizeof(data[0])), IPSocket::Buffer(data[1], sizeof(data[1])) };
+		IPSocket::Control controls[2];
+		IPSocket::MultiMessagePart parts[2] = { IPSocket::MultiMessagePart(&buffers[0], 1), IPSocket::MultiMessagePart(&buffers[1], 1) };
+		timespec now;
+
+		REQUIRE(clock_gettime(CLOCK_REALTIME, &now) == 0);
+		parts[0].SetControl(&controls[0]);
+		parts[1].SetControl(&controls[1]);
+
+		const uint64_t start = static_cast<uint64_t>(now.tv_sec) * 1000000000U + static_cast<uint64_t>(now.tv_nsec);
+
+		WHEN ("Datagrams are received with software timestamps") {
+			REQUIRE(receiver.SetTimestamping(IPSocket::TIMESTAMP_RECEIVE_SOFTWARE));
+			REQUIRE(receiver.GetTimestamping() == IPSocket::TIMESTAMP_RECEIVE_SOFTWARE);
+			REQUIRE(sender.Send("One", 4, to).GetResult() == 4);
+			REQUIRE(sender.Send("Two", 4, to).GetResult() == 4);
+
+			THEN ("Each datagram has the time it entered the kernel") {
+				REQUIRE(receiver.ReceiveMultiple(parts, 2).GetResult() == 2);
+				REQUIRE(std::string(data[1]) == "Two");
+				REQUIRE(parts[0].GetTimestamps().IsValid());
+				REQUIRE(parts[0].GetTimestamps().GetSoftware() >= start);
+				REQUIRE(parts[0].GetTimestamps().GetSoftware() < start + 10000000000U);
+				REQUIRE(parts[1].GetTimestamps().GetSoftware() >= parts[0].GetTimestamps().GetSoftware());
+				REQUIRE(parts[0].GetTimestamps().GetHardware() == 0);
+				REQUIRE(parts[0].GetTimestamps().GetSendStage() == IPSocket::Timestamps::SEND_STAGE_NONE);
+			}
+		}
+
+		WHEN ("A datagram is received with a nanosecond timestamp") {
+			IPSocket::Message message(&buffers[0], 1);
+
+			message.SetControl(&controls[0]);
+			REQUIRE(receiver.SetReceiveTimestamp());
+			REQUIRE(receiver.GetReceiveTimestamp());
+			REQUIRE(sender.Send("One", 4, to).GetResult() == 4);
+
+			THEN ("The datagram has the time it entered the kernel") {
+				REQUIRE(receiver.Receive(message).GetResult() == 4);
+				REQUIRE(message.GetTimestamps().GetSoftware() >= start);
+				REQUIRE(message.GetTimestamps().GetSoftware() < start + 10000000000U);
+			}
+		}
+
+		WHEN ("Datagrams are sent with software timestamps") {
+			IPSocket::Timestamps timestamps[2];
+
+			REQUIRE(!sender.ReceiveSendTimestamps(timestamps[0]));
+			REQUIRE(sender.SetTimestamping(IPSocket::TIMESTAMP_SEND_SOFTWARE | IPSocket::TIMESTAMP_SEND_SCHEDULED));
+			REQUIRE(sender.Send("One", 4, to).GetResult() == 4);
+			REQUIRE(sender.Send("Two", 4, to).GetResult() == 4);
+
+			THEN ("The send timestamps are read from the error queue") {
+				int count = 0;
+
+				for (int i = 0; i < 1000 && count < 4; i++) {
+					IPSocket::Timestamps current;
+
+					if (sender.ReceiveSendTimestamps(current)) {
+						REQUIRE(current.GetSendId() < 2);
+						REQUIRE(current.GetSoftware() >= start);
+						REQUIRE((current.GetSendStage() == IPSocket::Timestamps::SEND_STAGE_SENT || current.GetSendStage() == IPSocket::Timestamps::SEND_STAGE_SCHEDULED));
+
+						if (current.GetSendStage() == IPSocket::Timestamps::SEND_STAGE_SENT)
+							timestamps[current.GetSendId()] = current;
+
+						count++;
+					}
+					else
+						(void)usleep(1000);
+				}
+
+				REQUIRE(count == 4);
+				REQUIRE(timestamps[0].IsValid());
+				REQUIRE(timestamps[1].GetSoftware() >= timestamps[0].GetSoftware());
+			}
+		}
+	}
+#endif
+
 	IPSocket::Finish();
 }
 
@@ -755,3 +2708,411 @@ SCENARIO ("Poll Test", "[IPSocket]") {
 	IPSocket::Finish();
 }
 #endif
+
+#if !defined(SMBB_NO_EPOLL)
+SCENARIO ("Poller Test", "[IPSocket], [IPSocketPoller]") {
+	REQUIRE(IPSocket::Initialize());
+	REQUIRE(std::is_standard_layout<IPSocketPoller::Event>::value);
+
+	GIVEN ("A poller and a listening socket") {
+		IPSocketPoller poller;
+		IPSocketPoller::Event events[8];
+		AutoCloseIPSocket listener(IPAddress::Loopback(IPV4), TCP, IPSocket::OPEN_BIND_AND_LISTEN);
+		int listenerData = 0, connectionData = 0;
+
+		REQUIRE(!poller.IsValid());
+		REQUIRE(poller.Create());
+		REQUIRE(poller.IsValid());
+		REQUIRE(poller.Add(listener, IPSocketPoller::EVENT_CAN_ACCEPT, &listenerData));
+		REQUIRE(!poller.Add(listener, IPSocketPoller::EVENT_CAN_ACCEPT, &listenerData));
+		REQUIRE(poller.Wait(events, 8, 0) == 0);
+
+		WHEN ("Many idle sockets are monitored and a client connects") {
+			AutoCloseIPSocket idle[16];
+
+			for (size_t i = 0; i < 16; i++) {
+				REQUIRE(idle[i].Open(IPV4, UDP));
+				REQUIRE(poller.Add(idle[i], IPSocketPoller::EVENT_CAN_READ, &idle[i]));
+			}
+
+			AutoCloseIPSocket client(listener.GetAddress(), TCP, IPSocket::OPEN_AND_CONNECT);
+
+			THEN ("Only the ready sockets are returned, with their data") {
+				REQUIRE(poller.Wait(events, 8, 1000) == 1);
+				REQUIRE(events[0].GetData() == &listenerData);
+				REQUIRE(events[0].HasResult(IPSocketPoller::EVENT_CAN_ACCEPT));
+
+				AutoCloseIPSocket accepted(listener.Accept());
+
+				REQUIRE(accepted.IsValid());
+				REQUIRE(accepted.SetNonblocking());
+				REQUIRE(poller.Remove(listener));
+				REQUIRE(!poller.Remove(listener));
+				REQUIRE(poller.Add(accepted, IPSocketPoller::EVENT_CAN_READ, &connectionData, IPSocketPoller::TRIGGER_EDGE));
+				REQUIRE(poller.Wait(events, 8, 0) == 0);
+
+				// An edge-triggered socket is only returned once for each change in readiness
+				REQUIRE(client.Send("Ready", 6).GetResult() == 6);
+				REQUIRE(poller.Wait(events, 8, 1000) == 1);
+				REQUIRE(events[0].GetData() == &connectionData);
+				REQUIRE(events[0].GetResult() == IPSocketPoller::EVENT_CAN_READ);
+				REQUIRE(poller.Wait(events, 8, 0) == 0);
+
+				// A one-shot socket must be re-armed
+				REQUIRE(poller.Modify(accepted, IPSocketPoller::EVENT_CAN_READ, &connectionData, IPSocketPoller::TRIGGER_ONE_SHOT));
+				REQUIRE(poller.Wait(events, 8, 0) == 1);
+				REQUIRE(poller.Wait(events, 8, 0) == 0);
+				REQUIRE(poller.Modify(accepted, IPSocketPoller::EVENT_CAN_READ | IPSocketPoller::EVENT_DISCONNECTING, &connectionData));
+				REQUIRE(poller.Wait(events, 8, 0) == 1);
+
+				// A level-triggered socket is returned until it is drained
+				REQUIRE(poller.Wait(events, 8, 0) == 1);
+
+				char buffer[16];
+
+				REQUIRE(accepted.Receive(buffer, sizeof(buffer)).GetResult() == 6);
+				REQUIRE(poller.Wait(events, 8, 0) == 0);
+
+				client.CloseTCPSend();
+				REQUIRE(poller.Wait(events, 8, 1000) == 1);
+				REQUIRE(events[0].HasResult(IPSocketPoller::EVENT_DISCONNECTING));
+			}
+		}
+	}
+
+	IPSocket::Finish();
+}
+#endif
+
+#if !defined(SMBB_NO_SOCKET_ENGINE)
+// Accepts, sends, and receives using a socket engine with the specified mode (falling back to poll() if io_uring is not available)
+static void TestSocketEngine(IPSocketEngine::Mode mode) {
+	void *workspace[2048];
+	IPSocketEngine engine;
+	IPSocketEngine::Completion completions[8];
+
+	REQUIRE(IPSocketEngine::GetWorkspaceSize(64) <= sizeof(workspace));
+	REQUIRE(engine.Create(3, workspace, sizeof(workspace), mode) == IPSocketEngine::ENGINE_FAILED_BAD_SIZE);
+
+	// The workspace is only needed for poll()
+	if (mode == IPSocketEngine::MODE_POLL)
+		REQUIRE(engine.Create(64, workspace, sizeof(workspace), mode) == IPSocketEngine::ENGINE_SUCCESS);
+	else if (engine.Create(64, NULL, 0, mode) != IPSocketEngine::ENGINE_SUCCESS)
+		REQUIRE(engine.Create(64, workspace, sizeof(workspace)) == IPSocketEngine::ENGINE_SUCCESS);
+
+	REQUIRE(engine.IsValid());
+	REQUIRE((mode != IPSocketEngine::MODE_POLL || !engine.IsUsingRing()));
+	std::cout << "Socket engine mode " << mode << ": using ring " << engine.IsUsingRing() << ", kernel polling " << engine.IsKernelPolling() << std::endl;
+
+	// Accept a connection
+	AutoCloseIPSocket listener(IPAddress::Loopback(IPV4), TCP, IPSocket::OPEN_BIND_AND_LISTEN);
+	AutoCloseIPSocket client(listener.GetAddress(), TCP, IPSocket::OPEN_AND_CONNECT);
+
+	REQUIRE(engine.QueueAccept(listener, 1) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.Reap(completions, 8, 1) == 1);
+	REQUIRE(completions[0].GetData() == 1);
+	REQUIRE(!completions[0].GetResult().Failed());
+
+	AutoCloseIPSocket server(completions[0].GetSocket());
+	REQUIRE(server.IsValid());
+
+	// Send and receive in a batch (receives queued on the same stream socket may be filled in either order)
+	char received[2][16] = { };
+
+	REQUIRE(engine.QueueReceive(server, received[0], 4, 10) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.QueueReceive(server, received[1], 4, 11) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.QueueSend(client, "ABCD", 4, 20) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.QueueSend(client, "EFGH", 4, 21) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.Submit() >= 0);
+
+	for (int total = 0; total < 4; ) {
+		const int count = engine.Reap(completions, 8, 1);
+
+		REQUIRE(count > 0);
+
+		for (int i = 0; i < count; i++)
+			REQUIRE(completions[i].GetResult().GetResult() == 4);
+
+		total += count;
+	}
+
+	REQUIRE(std::string(received[0], 4) + std::string(received[1], 4) == (received[0][0] == 'A' ? "ABCDEFGH" : "EFGHABCD"));
+	REQUIRE(engine.Reap(completions, 8) == 0);
+
+	// Use registered buffers and sockets
+	char buffer[64] = "Fixed data";
+	IPSocket::Buffer buffers[1] = { IPSocket::Buffer(buffer, sizeof(buffer)) };
+	const IPSocket::Handle sockets[2] = { client.GetNativeHandle(), server.GetNativeHandle() };
+
+	REQUIRE(engine.QueueSendFixed(IPSocketEngine::Target::Registered(0), 0, 0, 10, 30) == IPSocketEngine::ENGINE_FAILED_BAD_TARGET);
+	REQUIRE(engine.RegisterBuffers(buffers, 1) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.RegisterSockets(sockets, 2) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.QueueSendFixed(client, 0, 0, 65, 30) == IPSocketEngine::ENGINE_FAILED_BAD_BUFFER);
+	REQUIRE(engine.QueueSendFixed(client, 1, 0, 10, 30) == IPSocketEngine::ENGINE_FAILED_BAD_BUFFER);
+
+	REQUIRE(engine.QueueSendFixed(IPSocketEngine::Target::Registered(0), 0, 0, 10, 30) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.Reap(completions, 8, 1) == 1);
+	REQUIRE(completions[0].GetData() == 30);
+	REQUIRE(completions[0].GetResult().GetResult() == 10);
+
+	REQUIRE(engine.QueueReceiveFixed(IPSocketEngine::Target::Registered(1), 0, 32, 10, 31) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.Reap(completions, 8, 1) == 1);
+	REQUIRE(completions[0].GetData() == 31);
+	REQUIRE(completions[0].GetResult().GetResult() == 10);
+	REQUIRE(std::string(buffer + 32, 10) == "Fixed data");
+
+	engine.UnregisterSockets();
+	engine.UnregisterBuffers();
+	REQUIRE(engine.QueueSendFixed(client, 0, 0, 10, 30) == IPSocketEngine::ENGINE_FAILED_BAD_BUFFER);
+
+	// A receive completes with the end of the stream
+	REQUIRE(engine.QueueReceive(server, received[0], 4, 12) == IPSocketEngine::ENGINE_SUCCESS);
+	client.CloseTCPSend();
+	REQUIRE(engine.Reap(completions, 8, 1) == 1);
+	REQUIRE(completions[0].GetData() == 12);
+	REQUIRE(completions[0].GetResult().GetResult() == 0);
+
+#if !defined(SMBB_NO_SOCKET_MSG)
+	// Send and receive datagrams as messages
+	AutoCloseIPSocket receiver(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+	AutoCloseIPSocket sender(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+	IPAddress to = receiver.GetAddress(), from;
+	char data[16] = "Datagram";
+	char datagram[16] = { };
+	IPSocket::Buffer sendBuffer(data, 9), receiveBuffer(datagram, sizeof(datagram));
+	IPSocket::Message sendMessage(&sendBuffer, 1, &to), receiveMessage(&receiveBuffer, 1, &from);
+
+	REQUIRE(engine.QueueReceive(receiver, receiveMessage, 40) == IPSocketEngine::ENGINE_SUCCESS);
+	REQUIRE(engine.QueueSend(sender, sendMessage, 41) == IPSocketEngine::ENGINE_SUCCESS);
+
+	for (int total = 0; total < 2; ) {
+		const int count = engine.Reap(completions, 8, 1);
+
+		REQUIRE(count > 0);
+
+		for (int i = 0; i < count; i++)
+			REQUIRE(completions[i].GetResult().GetResult() == 9);
+
+		total += count;
+	}
+
+	REQUIRE(std::string(datagram) == "Datagram");
+	REQUIRE(from == sender.GetAddress());
+#endif
+}
+
+SCENARIO ("Socket Engine Test", "[IPSocket], [IPSocketEngine]") {
+	REQUIRE(IPSocket::Initialize());
+
+	GIVEN ("An engine using poll()") {
+		WHEN ("Connections are accepted and data is sent and received in batches") {
+			THEN ("Every operation completes with its user data") {
+				TestSocketEngine(IPSocketEngine::MODE_POLL);
+			}
+		}
+	}
+
+	GIVEN ("An engine using io_uring (if available)") {
+		WHEN ("Connections are accepted and data is sent and received in batches") {
+			THEN ("Every operation completes with its user data") {
+				TestSocketEngine(IPSocketEngine::MODE_RING);
+			}
+		}
+	}
+
+	GIVEN ("An engine using io_uring with kernel polling (if available)") {
+		WHEN ("Connections are accepted and data is sent and received in batches") {
+			THEN ("Every operation completes with its user data") {
+				TestSocketEngine(IPSocketEngine::MODE_RING_KERNEL_POLLING);
+			}
+		}
+	}
+
+	IPSocket::Finish();
+}
+#endif
+
+#if defined(__linux__)
+struct SocketGroupCounts {
+	Atomic<uint32_t> total;
+	Atomic<uint32_t> perSocket[4];
+};
+
+// Counts datagrams received by a socket in the group until the socket is shut down
+static void ReceiveGroupDatagrams(IPSocket &socket, uint32_t index, void *context) {
+	SocketGroupCounts &counts = *static_cast<SocketGroupCounts *>(context);
+	char data[16];
+
+	for (IPSocket::MessageResult result = socket.Receive(data, sizeof(data)); !result.Failed() && result.GetResult() > 0; result = socket.Receive(data, sizeof(data))) {
+		(void)counts.perSocket[index].FetchAdd(1);
+		(void)counts.total.FetchAdd(1);
+	}
+}
+
+// Counts connections accepted by a socket in the group until the socket is shut down
+static void AcceptGroupConnections(IPSocket &socket, uint32_t index, void *context) {
+	SocketGroupCounts &counts = *static_cast<SocketGroupCounts *>(context);
+	IPAddress from;
+
+	for (IPSocket accepted; (accepted = socket.Accept(&from)).IsValid(); ) {
+		(void)counts.perSocket[index].FetchAdd(1);
+		(void)counts.total.FetchAdd(1);
+		(void)accepted.Close();
+	}
+}
+
+SCENARIO ("Socket Group Test", "[IPSocket], [IPSocketGroup]") {
+	REQUIRE(IPSocket::Initialize());
+
+	GIVEN ("A group of UDP sockets sharing a port") {
+		IPSocketGroup group;
+		SocketGroupCounts counts = { };
+
+		REQUIRE(group.Open(IPAddress::Loopback(IPV4), UDP, 0) == IPSocketGroup::GROUP_FAILED_BAD_SIZE);
+		REQUIRE(group.Open(IPAddress::Loopback(IPV4), UDP, IPSocketGroup::MAX_SOCKETS + 1) == IPSocketGroup::GROUP_FAILED_BAD_SIZE);
+		REQUIRE(group.Open(IPAddress::Loopback(IPV4), UDP, 4) == IPSocketGroup::GROUP_SUCCESS);
+		REQUIRE(group.Open(IPAddress::Loopback(IPV4), UDP, 4) == IPSocketGroup::GROUP_FAILED_IN_USE);
+		REQUIRE(group.GetCount() == 4);
+		REQUIRE(group.GetAddress().GetPort() != 0);
+
+		for (uint32_t i = 0; i < group.GetCount(); i++)
+			REQUIRE(group.GetSocket(i).GetAddress() == group.GetAddress());
+
+		WHEN ("Datagrams are sent from many flows") {
+			REQUIRE(group.Start(ReceiveGroupDatagrams, &counts) == IPSocketGroup::GROUP_SUCCESS);
+			REQUIRE(group.Start(ReceiveGroupDatagrams, &counts) == IPSocketGroup::GROUP_FAILED_IN_USE);
+
+			for (int i = 0; i < 64; i++) {
+				AutoCloseIPSocket sender(IPAddress::Loopback(IPV4), UDP, IPSocket::OPEN_AND_BIND);
+
+				REQUIRE(sender.Send("Flow", 4, group.GetAddress()).GetResult() == 4);
+			}
+
+			for (int i = 0; i < 1000 && counts.total.Load() < 64; i++)
+				(void)usleep(1000);
+
+			group.Close();
+
+			THEN ("Every datagram is received, and the flows are spread across the sockets") {
+				uint32_t used = 0;
+
+				REQUIRE(counts.total.Load() == 64);
+				REQUIRE(!group.IsValid());
+
+				for (uint32_t i = 0; i < 4; i++)
+					used += counts.perSocket[i].Load() != 0 ? 1 : 0;
+
+				REQUIRE(used > 1);
+			}
+		}
+	}
+
+	GIVEN ("A group of TCP listeners steered by CPU") {
+		IPSocketGroup group;
+		SocketGroupCounts counts = { };
+
+		REQUIRE(group.Open(IPAddress::Loopback(IPV4), TCP, 2, IPSocketGroup::STEER_BY_CPU) == IPSocketGroup::GROUP_SUCCESS);
+		REQUIRE(group.GetSteering() == IPSocketGroup::STEER_BY_CPU);
+		REQUIRE(IPSocketGroup::GetProcessorCount() >= 1);
+
+		WHEN ("Connections are made") {
+			REQUIRE(group.Start(AcceptGroupConnections, &counts) == IPSocketGroup::GROUP_SUCCESS);
+
+			for (int i = 0; i < 16; i++) {
+				AutoCloseIPSocket client(group.GetAddress(), TCP, IPSocket::OPEN_AND_CONNECT);
+
+				REQUIRE(client.IsValid());
+			}
+
+			for (int i = 0; i < 1000 && counts.total.Load() < 16; i++)
+				(void)usleep(1000);
+
+			group.Close();
+
+			THEN ("Every connection is accepted by a worker") {
+				REQUIRE(counts.total.Load() == 16);
+				REQUIRE(counts.perSocket[0].Load() + counts.perSocket[1].Load() == 16);
+			}
+		}
+	}
+
+	IPSocket::Finish();
+}
+#endif
+
+#if !defined(SMBB_NO_ZERO_COPY)
+SCENARIO ("Zero Copy Test", "[IPSocket], [IPSocketZeroCopy]") {
+	REQUIRE(IPSocket::Initialize());
+
+	GIVEN ("A connected TCP socket sending without copying") {
+		AutoCloseIPSocket listener(IPAddress::Loopback(IPV4), TCP, IPSocket::OPEN_BIND_AND_LISTEN);
+		AutoCloseIPSocket client(listener.GetAddress(), TCP, IPSocket::OPEN_AND_CONNECT);
+		AutoCloseIPSocket server(listener.Accept());
+		IPSocketZeroCopy zeroCopy;
+		IPSocketZeroCopy::Pending pending[2];
+		IPSocketZeroCopy::Pending released;
+		static char data[2][32768];
+		static char received[65536];
+
+		memset(data[0], 'A', sizeof(data[0]));
+		memset(data[1], 'B', sizeof(data[1]));
+
+		REQUIRE(zeroCopy.Open(client, pending, 0) == IPSocketZeroCopy::ZERO_COPY_FAILED_BAD_SIZE);
+		REQUIRE(!zeroCopy.IsValid());
+		REQUIRE(zeroCopy.Send(data[0], sizeof(data[0])).Failed());
+		REQUIRE(zeroCopy.Open(client, pending, 2) == IPSocketZeroCopy::ZERO_COPY_SUCCESS);
+		REQUIRE(client.GetZeroCopy());
+		REQUIRE(zeroCopy.Release(released) == IPSocketZeroCopy::ZERO_COPY_EMPTY);
+
+		WHEN ("Buffers are sent") {
+			REQUIRE(zeroCopy.Send(data[0], sizeof(data[0]), 1).GetResult() == static_cast<IPSocket::ResultLength>(sizeof(data[0])));
+
+			IPSocket::Buffer buffer(data[1], sizeof(data[1]));
+			IPSocket::Message message(&buffer, 1);
+
+			REQUIRE(zeroCopy.Send(message, 2).GetResult() == static_cast<IPSocket::ResultLength>(sizeof(data[1])));
+			REQUIRE(zeroCopy.IsFull());
+			REQUIRE(zeroCopy.Send(data[0], sizeof(data[0]), 3).HasTemporarySendError());
+
+			THEN ("The data is received and each buffer is released in order once the kernel has finished with it") {
+				size_t total = 0;
+
+				while (total < sizeof(received)) {
+					IPSocket::MessageResult result = server.Receive(received + total, sizeof(received) - total);
+
+					REQUIRE(result.GetResult() > 0);
+					total += static_cast<size_t>(result.GetResult());
+				}
+
+				REQUIRE(memcmp(received, data[0], sizeof(data[0])) == 0);
+				REQUIRE(memcmp(received + sizeof(data[0]), data[1], sizeof(data[1])) == 0);
+
+				uint32_t completed = 0;
+
+				for (int i = 0; i < 1000 && completed < 2; i++) {
+					completed += zeroCopy.ProcessCompletions();
+
+					if (completed < 2)
+						(void)usleep(1000);
+				}
+
+				REQUIRE(completed == 2);
+				REQUIRE(zeroCopy.Release(released) == IPSocketZeroCopy::ZERO_COPY_SUCCESS);
+				REQUIRE(released.GetUserData() == 1);
+				REQUIRE(released.GetData() == data[0]);
+				REQUIRE(released.GetLength() == sizeof(data[0]));
+				REQUIRE(zeroCopy.Release(released) == IPSocketZeroCopy::ZERO_COPY_SUCCESS);
+				REQUIRE(released.GetUserData() == 2);
+				REQUIRE(released.GetData() == data[1]);
+				REQUIRE(zeroCopy.Release(released) == IPSocketZeroCopy::ZERO_COPY_EMPTY);
+				REQUIRE(zeroCopy.GetOutstanding() == 0);
+
+				// Loopback always copies the data
+				REQUIRE(zeroCopy.GetCopiedCount() == (released.WasCopied() ? 2 : 0));
+			}
+		}
+	}
+
+	IPSocket::Finish();
+}
+#endif